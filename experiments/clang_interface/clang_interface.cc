@@ -3,6 +3,7 @@
 
 #include <clang/ASTMatchers/ASTMatchFinder.h>
 #include <clang/ASTMatchers/ASTMatchers.h>
+#include <clang/Basic/Version.h>
 #include <clang/CodeGen/ModuleBuilder.h>
 #include <clang/Frontend/CompilerInstance.h>
 #include <clang/Frontend/CompilerInvocation.h>
@@ -19,11 +20,20 @@
 #include <clang/Sema/TemplateDeduction.h>
 #include <clang/Serialization/ASTWriter.h>
 #include <clang/Tooling/Tooling.h>
+#include <llvm/ADT/StringExtras.h>
 #include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/LegacyPassManager.h>
 #include <llvm/IR/Module.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/SHA1.h>
 #include <llvm/Support/SmallVectorMemoryBuffer.h>
 #include <llvm/Support/VirtualFileSystem.h>
+#include <llvm/Transforms/IPO/PassManagerBuilder.h>
+#include <algorithm>
+#include <atomic>
 #include <stdio.h>
+#include <thread>
 
 using namespace clang;
 namespace
@@ -32,10 +42,16 @@ namespace
   {
     timespec start;
     std::string name;
-    static const clockid_t clock = CLOCK_PROF;
+    clockid_t clock;
 
   public:
-    TimeReport(std::string n) : name(n)
+    /**
+     * Report the time spent until this is destroyed.  CPU time is measured by
+     * default; pass `CLOCK_MONOTONIC` to measure wall-clock time instead, for
+     * work that is spread across threads.
+     */
+    TimeReport(std::string n, clockid_t clock = CLOCK_PROF)
+    : name(n), clock(clock)
     {
       std::atomic_signal_fence(std::memory_order::memory_order_seq_cst);
       clock_gettime(clock, &start);
@@ -116,6 +132,219 @@ namespace
       return std::make_unique<MultiplexConsumer>(std::move(Consumers));
     }
   };
+
+  /**
+   * Dependency collector that also records system headers.  The headers that
+   * we build interfaces for are usually system headers, so the default
+   * collector would miss most of what a PCH depends on.
+   */
+  struct AllDependencyCollector : DependencyCollector
+  {
+    bool needSystemDependencies() override
+    {
+      return true;
+    }
+  };
+
+  /**
+   * On-disk cache of serialized PCHs, so that parsing a header is only paid
+   * for once across runs.
+   *
+   * Entries are content-addressed: the key is a hash of the clang version,
+   * the command line used to build the PCH (and so the include paths and
+   * flags) and the contents of the header.  Each entry is a `<key>.pch` file
+   * holding the PCH and a `<key>.deps` file listing every file that was read
+   * to build it, with its size and modification time.  An entry is only
+   * reused if none of those files has changed since, because the key does not
+   * cover the headers that the header includes.
+   *
+   * The cache lives in `$VERONA_PCH_CACHE` if it is set, or in the user's
+   * cache directory otherwise.  If neither is usable, nothing is cached.
+   */
+  class PCHCache
+  {
+    llvm::SmallString<128> directory;
+
+    std::string entryPath(StringRef key, StringRef extension)
+    {
+      llvm::SmallString<128> path = directory;
+      llvm::sys::path::append(path, key + extension);
+      return path.str().str();
+    }
+
+    /**
+     * Write `contents` to `path`, through a temporary file so that concurrent
+     * readers never see a partial entry.
+     */
+    bool writeAtomically(const std::string& path, StringRef contents)
+    {
+      int fd;
+      llvm::SmallString<128> tmpPath;
+      if (llvm::sys::fs::createUniqueFile(path + "-%%%%%%.tmp", fd, tmpPath))
+      {
+        return false;
+      }
+      {
+        llvm::raw_fd_ostream out(fd, /*shouldClose*/ true);
+        out << contents;
+        if (out.has_error())
+        {
+          out.clear_error();
+          llvm::sys::fs::remove(tmpPath);
+          return false;
+        }
+      }
+      if (llvm::sys::fs::rename(tmpPath, path))
+      {
+        llvm::sys::fs::remove(tmpPath);
+        return false;
+      }
+      return true;
+    }
+
+    static int64_t modificationTime(const llvm::sys::fs::file_status& status)
+    {
+      return status.getLastModificationTime().time_since_epoch().count();
+    }
+
+    /**
+     * Check that every file listed in a `.deps` file still has the recorded
+     * size and modification time.
+     */
+    static bool dependenciesUnchanged(StringRef deps)
+    {
+      llvm::SmallVector<StringRef, 64> lines;
+      deps.split(lines, '\n', -1, /*KeepEmpty*/ false);
+      for (StringRef line : lines)
+      {
+        auto [mtimeString, rest] = line.split(' ');
+        auto [sizeString, path] = rest.split(' ');
+        int64_t mtime;
+        uint64_t size;
+        if (
+          mtimeString.getAsInteger(10, mtime) ||
+          sizeString.getAsInteger(10, size) || path.empty())
+        {
+          return false;
+        }
+        llvm::sys::fs::file_status status;
+        if (llvm::sys::fs::status(path, status))
+        {
+          return false;
+        }
+        if ((status.getSize() != size) || (modificationTime(status) != mtime))
+        {
+          fprintf(stderr, "PCH cache: %s has changed\n", path.str().c_str());
+          return false;
+        }
+      }
+      return true;
+    }
+
+  public:
+    PCHCache()
+    {
+      if (const char* env = getenv("VERONA_PCH_CACHE"))
+      {
+        directory = env;
+      }
+      else if (!llvm::sys::path::user_cache_directory(
+                 directory, "verona", "pch"))
+      {
+        directory.clear();
+      }
+      if (!directory.empty() && llvm::sys::fs::create_directories(directory))
+      {
+        fprintf(
+          stderr,
+          "PCH cache: cannot create %s, caching disabled\n",
+          directory.c_str());
+        directory.clear();
+      }
+    }
+
+    /**
+     * Compute the key for the PCH of `headerFile` built with `args`.
+     */
+    std::string key(StringRef headerFile, ArrayRef<const char*> args)
+    {
+      llvm::SHA1 hash;
+      hash.update(getClangFullVersion());
+      for (const char* arg : args)
+      {
+        // Include the terminator, so that arguments can't run together.
+        hash.update(StringRef(arg, strlen(arg) + 1));
+      }
+      if (auto header = llvm::MemoryBuffer::getFile(headerFile))
+      {
+        hash.update((*header)->getBuffer());
+      }
+      return llvm::toHex(hash.final(), /*LowerCase*/ true);
+    }
+
+    /**
+     * Return the cached PCH for `key`, or null if there is no valid entry.
+     */
+    std::unique_ptr<llvm::MemoryBuffer> load(StringRef key)
+    {
+      if (directory.empty())
+      {
+        return nullptr;
+      }
+      // The `.deps` file is written last, so its presence means that the
+      // entry is complete.
+      auto deps = llvm::MemoryBuffer::getFile(entryPath(key, ".deps"));
+      if (!deps || !dependenciesUnchanged((*deps)->getBuffer()))
+      {
+        return nullptr;
+      }
+      auto pch = llvm::MemoryBuffer::getFile(
+        entryPath(key, ".pch"),
+        /*FileSize*/ -1,
+        /*RequiresNullTerminator*/ false);
+      if (!pch)
+      {
+        return nullptr;
+      }
+      fprintf(stderr, "PCH cache: hit for %s\n", key.str().c_str());
+      return std::move(*pch);
+    }
+
+    /**
+     * Add the PCH for `key`, built from `dependencies`, to the cache.
+     */
+    void store(
+      StringRef key,
+      const llvm::MemoryBuffer& pch,
+      ArrayRef<std::string> dependencies)
+    {
+      if (directory.empty())
+      {
+        return;
+      }
+      std::string deps;
+      llvm::raw_string_ostream depsStream(deps);
+      for (const std::string& path : dependencies)
+      {
+        llvm::sys::fs::file_status status;
+        if (llvm::sys::fs::status(path, status))
+        {
+          fprintf(stderr, "PCH cache: cannot stat %s\n", path.c_str());
+          return;
+        }
+        depsStream << modificationTime(status) << ' ' << status.getSize()
+                   << ' ' << path << '\n';
+      }
+      if (
+        !writeAtomically(entryPath(key, ".pch"), pch.getBuffer()) ||
+        !writeAtomically(entryPath(key, ".deps"), depsStream.str()))
+      {
+        fprintf(stderr, "PCH cache: failed to store %s\n", key.str().c_str());
+        return;
+      }
+      fprintf(stderr, "PCH cache: stored %s\n", key.str().c_str());
+    }
+  };
 }
 
 namespace verona
@@ -249,20 +478,39 @@ namespace verona
       return State;
     }
 
-    std::unique_ptr<llvm::MemoryBuffer>
-    generatePCH(std::string headerFile, ArrayRef<const char*> args)
+    /**
+     * Build a PCH for `headerFile`.  The files that it was built from are
+     * returned in `dependencies`.  `succeeded` is set to false if the action
+     * failed or reported any errors, in which case the PCH must not be cached.
+     */
+    std::unique_ptr<llvm::MemoryBuffer> generatePCH(
+      std::string headerFile,
+      ArrayRef<const char*> args,
+      std::vector<std::string>& dependencies,
+      bool& succeeded)
     {
       auto pchCompilerState =
         createClangInstance(args, llvm::vfs::getRealFileSystem());
+      auto collector = std::make_shared<AllDependencyCollector>();
+      pchCompilerState->Clang->addDependencyCollector(collector);
       llvm::SmallVector<char, 0> pchOutBuffer;
       auto action = std::make_unique<GenerateMemoryPCHAction>(pchOutBuffer);
-      pchCompilerState->Clang->ExecuteAction(*action);
+      succeeded = pchCompilerState->Clang->ExecuteAction(*action) &&
+        !pchCompilerState->Clang->getDiagnostics().hasErrorOccurred();
+      dependencies = collector->getDependencies().vec();
       fprintf(stderr, "PCH is %zu bytes\n", pchOutBuffer.size());
       return std::unique_ptr<llvm::MemoryBuffer>(
         new llvm::SmallVectorMemoryBuffer(std::move(pchOutBuffer)));
     }
 
+    PCHCache pchCache;
+
   public:
+    /**
+     * Whether the PCH was loaded from the on-disk cache rather than built.
+     */
+    bool pchFromCache = false;
+
     CXXInterface(std::string headerFile, SourceLanguage sourceLang = CXX)
     : sourceFile(headerFile), factory(this)
     {
@@ -276,9 +524,29 @@ namespace verona
                                headerFile.c_str()};
 
       fprintf(stderr, "Computing precompiled preamble\n");
+      std::string pchKey = pchCache.key(headerFile, pchArgs);
       {
-        auto t = TimeReport("Building PCH");
-        pchBuffer = generatePCH(headerFile, pchArgs);
+        auto t = TimeReport("Loading cached PCH");
+        pchBuffer = pchCache.load(pchKey);
+      }
+      pchFromCache = pchBuffer != nullptr;
+      if (!pchFromCache)
+      {
+        std::vector<std::string> dependencies;
+        bool succeeded;
+        {
+          auto t = TimeReport("Building PCH");
+          pchBuffer =
+            generatePCH(headerFile, pchArgs, dependencies, succeeded);
+        }
+        if (succeeded)
+        {
+          pchCache.store(pchKey, *pchBuffer, dependencies);
+        }
+        else
+        {
+          fprintf(stderr, "Building the PCH failed, not caching it\n");
+        }
       }
 
       fprintf(stderr, "Parsing fake CU\n");
@@ -566,8 +834,225 @@ namespace verona
 
       auto& S = queryCompilerState->Clang->getSema();
 
-      ClassTemplateDecl* ClassTemplate = 
-				classTemplate.getAs<ClassTemplateDecl>();
+      ClassTemplateDecl* ClassTemplate =
+        classTemplate.getAs<ClassTemplateDecl>();
+      ClassTemplateSpecializationDecl* Decl =
+        getSpecialization(ClassTemplate, args);
+      ClassTemplateSpecializationDecl* Def =
+        cast_or_null<ClassTemplateSpecializationDecl>(Decl->getDefinition());
+      if (!Def)
+      {
+        S.InstantiateClassTemplateSpecialization(
+          instantiationLocation(), Decl, TSK_ExplicitInstantiationDefinition);
+        Def = cast<ClassTemplateSpecializationDecl>(Decl->getDefinition());
+      }
+      return CXXType{Def};
+    }
+
+    /**
+     * A class template and the arguments to instantiate it with.  Trailing
+     * arguments that have defaults may be omitted.
+     */
+    struct TemplateInstantiation
+    {
+      CXXType classTemplate;
+      std::vector<TemplateArgument> args;
+    };
+
+    /**
+     * Instantiate a batch of class templates.
+     *
+     * Unlike `instantiateClassTemplate`, this only instantiates the class
+     * definitions: members are declared, but their bodies are left until they
+     * are referenced with `useMember`.  Every specialization in the batch is
+     * declared before any definition is instantiated, so definitions that
+     * refer to other specializations in the batch find them.
+     *
+     * The result has one entry per request, which is invalid if the
+     * arguments do not match the template.
+     */
+    std::vector<CXXType>
+    instantiateClassTemplates(llvm::ArrayRef<TemplateInstantiation> requests)
+    {
+      auto& S = queryCompilerState->Clang->getSema();
+      SourceLocation loc = instantiationLocation();
+
+      std::vector<ClassTemplateSpecializationDecl*> decls;
+      for (auto& request : requests)
+      {
+        auto* ClassTemplate = dyn_cast_or_null<ClassTemplateDecl>(
+          const_cast<NamedDecl*>(request.classTemplate.decl));
+        llvm::SmallVector<TemplateArgument, 4> converted;
+        if (
+          !ClassTemplate ||
+          !completeTemplateArguments(ClassTemplate, request.args, converted))
+        {
+          decls.push_back(nullptr);
+          continue;
+        }
+        decls.push_back(getSpecialization(ClassTemplate, converted));
+      }
+
+      std::vector<CXXType> result;
+      for (auto* Decl : decls)
+      {
+        if (Decl && !Decl->getDefinition())
+        {
+          S.InstantiateClassTemplateSpecialization(
+            loc, Decl, TSK_ImplicitInstantiation);
+        }
+        auto* Def = Decl ?
+          cast_or_null<ClassTemplateSpecializationDecl>(Decl->getDefinition()) :
+          nullptr;
+        result.push_back(Def ? CXXType{Def} : CXXType{});
+      }
+      return result;
+    }
+
+    /**
+     * Reference the member functions called `name` of a class template
+     * specialization, instantiating their bodies (and anything they use) if
+     * that has not been done yet.  Referenced members are emitted by
+     * `emitSpecializations`.  Returns the number of member functions found.
+     */
+    size_t useMember(CXXType& specialization, StringRef name)
+    {
+      auto* Def = specialization.getAs<ClassTemplateSpecializationDecl>();
+      if (!Def)
+      {
+        return 0;
+      }
+      auto& S = queryCompilerState->Clang->getSema();
+      size_t found = 0;
+      for (auto* D : Def->lookup(&ast->Idents.get(name)))
+      {
+        auto* Method = dyn_cast<CXXMethodDecl>(D);
+        if (!Method)
+        {
+          continue;
+        }
+        if (Method->isImplicitlyInstantiable() && !Method->isDefined())
+        {
+          S.InstantiateFunctionDefinition(
+            instantiationLocation(), Method, /*Recursive*/ true);
+        }
+        if (!Method->hasAttr<UsedAttr>())
+        {
+          // Inline functions are only emitted when something refers to them,
+          // which nothing in the AST does.
+          Method->addAttr(UsedAttr::CreateImplicit(*ast));
+          usedMembers[Def].push_back(Method);
+        }
+        found++;
+      }
+      return found;
+    }
+
+    /**
+     * An LLVM module along with the context that owns it.
+     */
+    struct EmittedModule
+    {
+      std::unique_ptr<llvm::LLVMContext> context;
+      std::unique_ptr<llvm::Module> module;
+    };
+
+    /**
+     * Generate code for the members of each specialization that have been
+     * referenced with `useMember`, in one module per specialization, and
+     * optimise the modules on `threads` worker threads.
+     *
+     * The clang AST is not thread-safe, so generating LLVM IR from it is done
+     * on this thread.  Each module has its own `LLVMContext`, which makes the
+     * modules independent of each other once they have been generated.
+     */
+    std::vector<EmittedModule> emitSpecializations(
+      llvm::ArrayRef<CXXType> specializations, unsigned threads)
+    {
+      auto& CI = queryCompilerState->Clang;
+      std::vector<EmittedModule> modules;
+      {
+        auto t = TimeReport("Generating LLVM IR for specializations");
+        for (auto& specialization : specializations)
+        {
+          auto it = usedMembers.find(specialization.decl);
+          if (it == usedMembers.end())
+          {
+            continue;
+          }
+          EmittedModule emitted;
+          emitted.context = std::make_unique<llvm::LLVMContext>();
+          std::unique_ptr<CodeGenerator> CodeGen{CreateLLVMCodeGen(
+            CI->getDiagnostics(),
+            cu_name,
+            CI->getHeaderSearchOpts(),
+            CI->getPreprocessorOpts(),
+            CI->getCodeGenOpts(),
+            *emitted.context)};
+          CodeGen->Initialize(*ast);
+          for (auto* Method : it->second)
+          {
+            CodeGen->HandleTopLevelDecl(DeclGroupRef{Method});
+          }
+          CodeGen->HandleTranslationUnit(*ast);
+          emitted.module.reset(CodeGen->ReleaseModule());
+          modules.push_back(std::move(emitted));
+        }
+      }
+
+      {
+        auto t = TimeReport(
+          "Optimising " + std::to_string(modules.size()) + " modules on " +
+            std::to_string(threads) + " threads",
+          CLOCK_MONOTONIC);
+        std::atomic<size_t> next{0};
+        auto worker = [&]() {
+          for (size_t i = next++; i < modules.size(); i = next++)
+          {
+            optimise(*modules[i].module);
+          }
+        };
+        std::vector<std::thread> workers;
+        for (unsigned i = 1; i < threads; i++)
+        {
+          workers.emplace_back(worker);
+        }
+        worker();
+        for (auto& w : workers)
+        {
+          w.join();
+        }
+      }
+      return modules;
+    }
+
+  private:
+    /**
+     * Members referenced with `useMember`, indexed by the specialization they
+     * belong to.
+     */
+    llvm::DenseMap<const NamedDecl*, std::vector<FunctionDecl*>> usedMembers;
+
+    /**
+     * The location that instantiations are attributed to: the end of the
+     * stub compilation unit.
+     */
+    SourceLocation instantiationLocation()
+    {
+      auto& SM = queryCompilerState->Clang->getSourceManager();
+      SourceLocation loc = SM.getLocForEndOfFile(SM.getMainFileID());
+      assert(loc.isValid());
+      return loc;
+    }
+
+    /**
+     * Find the specialization of `ClassTemplate` for `args`, declaring it if
+     * this is the first time it is referenced.  `args` must be complete.
+     */
+    ClassTemplateSpecializationDecl* getSpecialization(
+      ClassTemplateDecl* ClassTemplate, llvm::ArrayRef<TemplateArgument> args)
+    {
+      auto& S = queryCompilerState->Clang->getSema();
       void* InsertPos = nullptr;
       ClassTemplateSpecializationDecl* Decl =
         ClassTemplate->findSpecialization(args, InsertPos);
@@ -594,22 +1079,53 @@ namespace verona
         S.InstantiateAttrsForDecl(
           TemplateArgLists, ClassTemplate->getTemplatedDecl(), Decl);
       }
-      ClassTemplateSpecializationDecl* Def =
-        cast_or_null<ClassTemplateSpecializationDecl>(Decl->getDefinition());
-      if (!Def)
+      return Decl;
+    }
+
+    /**
+     * Check `args` against the parameters of `ClassTemplate`, filling in
+     * default arguments for any that are missing.  Returns false if the
+     * arguments do not match.
+     */
+    bool completeTemplateArguments(
+      ClassTemplateDecl* ClassTemplate,
+      llvm::ArrayRef<TemplateArgument> args,
+      llvm::SmallVectorImpl<TemplateArgument>& converted)
+    {
+      auto& S = queryCompilerState->Clang->getSema();
+      SourceLocation loc = instantiationLocation();
+      TemplateArgumentListInfo argList(loc, loc);
+      for (auto& arg : args)
       {
-        auto& SM = queryCompilerState->Clang->getSourceManager();
-        auto mainFile = SM.getMainFileID();
-        SourceLocation InstantiationLoc = SM.getLocForEndOfFile(mainFile);
-        assert(InstantiationLoc.isValid());
-        S.InstantiateClassTemplateSpecialization(
-          InstantiationLoc, Decl, TSK_ExplicitInstantiationDefinition);
-        Def = cast<ClassTemplateSpecializationDecl>(Decl->getDefinition());
+        // Integer arguments are created as expressions, which carry their
+        // own type, so no type is needed for non-type parameters.
+        argList.addArgument(
+          S.getTrivialTemplateArgumentLoc(arg, QualType{}, loc));
       }
-	  return CXXType{Def};
+      return !S.CheckTemplateArgumentList(
+        ClassTemplate, loc, argList, /*PartialTemplateArgs*/ false, converted);
+    }
+
+    /**
+     * Run the standard `-O2` pipeline on a module.
+     */
+    static void optimise(llvm::Module& M)
+    {
+      llvm::PassManagerBuilder builder;
+      builder.OptLevel = 2;
+      llvm::legacy::FunctionPassManager FPM(&M);
+      llvm::legacy::PassManager MPM;
+      builder.populateFunctionPassManager(FPM);
+      builder.populateModulePassManager(MPM);
+      FPM.doInitialization();
+      for (auto& F : M)
+      {
+        FPM.run(F);
+      }
+      FPM.doFinalization();
+      MPM.run(M);
     }
 
-  private:
     QualType typeForBuiltin(CXXType::BuiltinTypeKinds ty)
     {
       switch (ty)
@@ -649,6 +1165,138 @@ namespace verona
 
 using namespace verona;
 
+/**
+ * Synthetic workload for batched instantiation: a few members of every
+ * combination of common `std::` containers and builtin element types, which
+ * is a couple of hundred specializations.
+ */
+void instantiateContainers()
+{
+  using CXXType = CXXInterface::CXXType;
+  using Builtin = CXXType::BuiltinTypeKinds;
+
+  // The interface is built for a single header, so write one that includes
+  // all of the containers.  It is only rewritten if it changes, so that the
+  // PCH cache stays valid.
+  std::string contents;
+  const char* headers[] = {"deque",
+                           "forward_list",
+                           "list",
+                           "map",
+                           "set",
+                           "unordered_map",
+                           "unordered_set",
+                           "vector"};
+  for (auto* header : headers)
+  {
+    contents += std::string("#include <") + header + ">\n";
+  }
+  llvm::SmallString<128> headerPath;
+  llvm::sys::path::system_temp_directory(/*ErasedOnReboot*/ true, headerPath);
+  llvm::sys::path::append(headerPath, "verona_std_containers.h");
+  auto existing = llvm::MemoryBuffer::getFile(headerPath);
+  if (!existing || (*existing)->getBuffer() != contents)
+  {
+    std::error_code error;
+    llvm::raw_fd_ostream out(headerPath, error);
+    if (error)
+    {
+      fprintf(stderr, "Cannot write %s\n", headerPath.c_str());
+      return;
+    }
+    out << contents;
+  }
+
+  CXXInterface containers(headerPath.str().str());
+
+  Builtin elementTypes[] = {Builtin::Char,
+                            Builtin::SChar,
+                            Builtin::UChar,
+                            Builtin::Short,
+                            Builtin::UShort,
+                            Builtin::Int,
+                            Builtin::UInt,
+                            Builtin::Long,
+                            Builtin::ULong,
+                            Builtin::LongLong,
+                            Builtin::ULongLong,
+                            Builtin::Float,
+                            Builtin::Double};
+  Builtin keyTypes[] = {Builtin::Char, Builtin::Int, Builtin::Long};
+  const char* sequences[] = {"std::deque",
+                             "std::forward_list",
+                             "std::list",
+                             "std::multiset",
+                             "std::set",
+                             "std::unordered_multiset",
+                             "std::unordered_set",
+                             "std::vector"};
+  const char* maps[] = {"std::map", "std::unordered_map"};
+
+  std::vector<CXXInterface::TemplateInstantiation> requests;
+  {
+    auto t = TimeReport("Looking up containers");
+    for (auto* name : sequences)
+    {
+      CXXType container = containers.getType(name);
+      for (auto element : elementTypes)
+      {
+        auto elementType = containers.getBuiltinType(element);
+        requests.push_back(
+          {container, {containers.createTemplateArgumentForType(elementType)}});
+      }
+    }
+    for (auto* name : maps)
+    {
+      CXXType container = containers.getType(name);
+      for (auto key : keyTypes)
+      {
+        auto keyType = containers.getBuiltinType(key);
+        for (auto element : elementTypes)
+        {
+          auto elementType = containers.getBuiltinType(element);
+          requests.push_back(
+            {container,
+             {containers.createTemplateArgumentForType(keyType),
+              containers.createTemplateArgumentForType(elementType)}});
+        }
+      }
+    }
+  }
+
+  std::vector<CXXType> specializations;
+  {
+    auto t = TimeReport(
+      "Instantiating " + std::to_string(requests.size()) + " containers");
+    specializations = containers.instantiateClassTemplates(requests);
+  }
+
+  size_t members = 0;
+  {
+    auto t = TimeReport("Instantiating used members");
+    for (auto& specialization : specializations)
+    {
+      for (auto* member : {"empty", "size", "clear"})
+      {
+        members += containers.useMember(specialization, member);
+      }
+    }
+  }
+  fprintf(stderr, "Instantiated %zu members\n", members);
+
+  // Only optimisation runs in parallel.  `emitSpecializations` reports the
+  // serial IR generation and the parallel optimisation separately; this is the
+  // total of the two.
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned n : {1u, threads})
+  {
+    auto t = TimeReport(
+      "Code generation, optimising on " + std::to_string(n) + " threads",
+      CLOCK_MONOTONIC);
+    containers.emitSpecializations(specializations, n);
+  }
+}
+
 int main(void)
 {
   using CXXType = CXXInterface::CXXType;
@@ -695,7 +1343,19 @@ int main(void)
 	TemplateName irbName{dyn_cast<TemplateDecl>(const_cast<NamedDecl*>(irb.decl))};
 	interface.ast->getTemplateSpecializationType(irbName, args).dump();
 
-  CXXInterface stdarray("/usr/include/c++/v1/array");
+  // The PCH is built on the first run (cold cache) and loaded from the cache
+  // on later runs (warm cache).  Run the test again to compare the two.
+  std::unique_ptr<CXXInterface> stdarrayInterface;
+  {
+    auto t = TimeReport("Loading std::array interface");
+    stdarrayInterface =
+      std::make_unique<CXXInterface>("/usr/include/c++/v1/array");
+  }
+  CXXInterface& stdarray = *stdarrayInterface;
+  fprintf(
+    stderr,
+    "std::array interface loaded with a %s PCH cache\n",
+    stdarray.pchFromCache ? "warm" : "cold");
   auto t = TimeReport("Instantiating std::array");
   auto arr = stdarray.getType("std::array");
   fprintf(
@@ -771,4 +1431,5 @@ int main(void)
     ->getCanonicalTemplateSpecializationType(arrName, {TypeArg, TypeArg})
     .dump();
 
+  instantiateContainers();
 }
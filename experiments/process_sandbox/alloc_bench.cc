@@ -0,0 +1,67 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include "bench_sandbox.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+using namespace sandbox;
+
+/**
+ * Measure allocation throughput inside a sandbox, and the number of pagemap
+ * update requests that the child sends to the parent to sustain it.  With more
+ * than one worker thread, the calls in each batch run concurrently in the
+ * child, so their pagemap updates can be combined into shared writes and
+ * ranges.
+ *
+ * Usage: alloc_bench [calls per round count] [worker threads]
+ */
+int main(int argc, char** argv)
+{
+  using clock = std::chrono::steady_clock;
+  size_t calls =
+    std::max<size_t>(argc > 1 ? strtoull(argv[1], nullptr, 0) : 8, 1);
+  size_t workers =
+    std::max<size_t>(argc > 2 ? strtoull(argv[2], nullptr, 0) : 1, 1);
+  // We call only `alloc_churn`, which allocates and frees objects from 16
+  // bytes to 32 MiB.  It keeps up to 256 objects live, some of them large, so
+  // needs more than the default heap size, for each concurrent call.
+  BenchSandbox sandbox(4 * workers, workers);
+  // Warm up, so that the first measurement doesn't include growing the heap.
+  sandbox.alloc_churn(1);
+  std::vector<SandboxedFuture<int>> futures;
+  futures.reserve(workers);
+  printf("Rounds per call, allocations/s, pagemap updates per 1000 allocs\n");
+  for (int rounds = 1; rounds <= 64; rounds *= 4)
+  {
+    uint64_t updates_before = sandbox.lib.pagemap_updates_processed();
+    size_t allocations = 0;
+    auto start = clock::now();
+    for (size_t i = 0; i < calls; i++)
+    {
+      for (size_t j = 0; j < workers; j++)
+      {
+        futures.push_back(sandbox.alloc_churn.async(rounds));
+      }
+      for (auto& future : futures)
+      {
+        allocations += future.get();
+      }
+      futures.clear();
+    }
+    double seconds =
+      std::chrono::duration<double>(clock::now() - start).count();
+    uint64_t updates =
+      sandbox.lib.pagemap_updates_processed() - updates_before;
+    printf(
+      "%15d, %13.0f, %.2f\n",
+      rounds,
+      allocations / seconds,
+      (updates * 1000.0) / std::max<size_t>(allocations, 1));
+  }
+  return 0;
+}
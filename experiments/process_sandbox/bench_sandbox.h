@@ -0,0 +1,51 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "sandbox.hh"
+#include "shared.h"
+
+#include <memory>
+
+/**
+ * A sandboxed instance of the example library, with a member for each of the
+ * functions that it exports.  This is shared by the benchmarks and tests.
+ *
+ * The library is either created with the sandbox, or owned elsewhere, so that
+ * the functions can be used with sandboxes that come from a pool.
+ */
+struct BenchSandbox
+{
+private:
+  /**
+   * The library, if this sandbox created it.
+   */
+  std::unique_ptr<sandbox::SandboxedLibrary> owned;
+
+public:
+  /**
+   * The library that defines the functions exposed by this sandbox.
+   */
+  sandbox::SandboxedLibrary& lib;
+#define EXPORTED_FUNCTION(public_name, private_name) \
+  decltype(sandbox::make_sandboxed_function<decltype(private_name)>(lib)) \
+    public_name = sandbox::make_sandboxed_function<decltype(private_name)>(lib);
+#include "functions.inc"
+#undef EXPORTED_FUNCTION
+
+  /**
+   * Create a new sandbox with the given heap size, in GiBs, and number of
+   * worker threads in the child.
+   */
+  BenchSandbox(size_t heap_size_in_GiBs = 1, size_t worker_threads = 1)
+  : owned(std::make_unique<sandbox::SandboxedLibrary>(
+      "example_lib.so", heap_size_in_GiBs, worker_threads)),
+    lib(*owned)
+  {}
+
+  /**
+   * Bind the functions to a library that is owned elsewhere.
+   */
+  BenchSandbox(sandbox::SandboxedLibrary& l) : lib(l) {}
+};
@@ -0,0 +1,123 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include "bench_sandbox.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+using namespace sandbox;
+
+namespace
+{
+  /**
+   * Fill a buffer with data that depends on the iteration, standing in for a
+   * producer that generates a fresh payload for each call.
+   */
+  void produce(unsigned char* buffer, size_t size, size_t iteration)
+  {
+    std::fill(buffer, buffer + size, static_cast<unsigned char>(iteration));
+  }
+
+  /**
+   * Print the throughput of `iterations` calls that each pass `size` bytes
+   * and took `seconds` in total.
+   */
+  void report(const char* name, size_t size, size_t iterations, double seconds)
+  {
+    double mib = static_cast<double>(size * iterations) / (1024 * 1024);
+    printf(
+      "%8zu, %-16s, %10.3f, %10.1f\n",
+      size >> 20,
+      name,
+      (seconds * 1000) / iterations,
+      mib / seconds);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  using clock = std::chrono::steady_clock;
+  size_t iterations =
+    std::max<size_t>(argc > 1 ? strtoull(argv[1], nullptr, 0) : 20, 1);
+  // We call only `checksum`, which reads every byte of the buffer that it is
+  // passed.
+  BenchSandbox sandbox;
+  printf("Payload (MiB), mode, ms/call, MiB/s\n");
+  for (size_t size = 1 << 20; size <= (64 << 20); size *= 4)
+  {
+    // Copying: the payload is produced in the parent's heap and copied into
+    // a temporary allocation in the sandbox for each call.
+    std::vector<unsigned char> local(size);
+    unsigned long copied_sum = 0;
+    auto start = clock::now();
+    for (size_t i = 0; i < iterations; i++)
+    {
+      produce(local.data(), size, i);
+      unsigned char* copy = sandbox.lib.alloc<unsigned char>(size);
+      memcpy(copy, local.data(), size);
+      copied_sum += sandbox.checksum(copy, size);
+      sandbox.lib.free(copy);
+    }
+    report(
+      "copy",
+      size,
+      iterations,
+      std::chrono::duration<double>(clock::now() - start).count());
+
+    // Zero copy: the payload is produced directly in a shared buffer, which
+    // the child reads in place.
+    SharedBuffer<unsigned char> shared =
+      sandbox.lib.alloc_buffer<unsigned char>(size);
+    unsigned long shared_sum = 0;
+    start = clock::now();
+    for (size_t i = 0; i < iterations; i++)
+    {
+      produce(shared.data(), size, i);
+      shared_sum += sandbox.checksum(shared, size);
+    }
+    report(
+      "shared",
+      size,
+      iterations,
+      std::chrono::duration<double>(clock::now() - start).count());
+    if (shared_sum != copied_sum)
+    {
+      fprintf(
+        stderr, "Checksum mismatch: %lu != %lu\n", shared_sum, copied_sum);
+      return EXIT_FAILURE;
+    }
+
+    // Zero copy with borrowed spans: each quarter of the buffer is passed to a
+    // separate asynchronous call.  Producing the next payload blocks in
+    // `data()` until all of the calls using the buffer have completed.
+    static const size_t parts = 4;
+    size_t part = size / parts;
+    std::vector<SandboxedFuture<unsigned long>> futures;
+    futures.reserve(parts);
+    start = clock::now();
+    for (size_t i = 0; i < iterations; i++)
+    {
+      produce(shared.data(), size, i);
+      for (size_t j = 0; j < parts; j++)
+      {
+        futures.push_back(
+          sandbox.checksum.async(shared.span(j * part, part), part));
+      }
+      for (auto& f : futures)
+      {
+        f.get();
+      }
+      futures.clear();
+    }
+    report(
+      "shared, 4 spans",
+      size,
+      iterations,
+      std::chrono::duration<double>(clock::now() - start).count());
+  }
+  return 0;
+}
@@ -0,0 +1,75 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include "bench_sandbox.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace sandbox;
+
+/**
+ * Test that a chunk freed in the child and then reused by the parent keeps
+ * the pagemap entry that the parent set for it.  The child and the parent's
+ * allocator for the sandbox share a memory provider, so a large allocation
+ * that the child frees can be handed straight back to the parent.  If the
+ * child's pagemap update that clears the entry for the chunk were applied
+ * after the parent had reused it, the child's allocator would no longer
+ * recognise the parent's allocation.
+ *
+ * Usage: chunk_reuse [iterations]
+ */
+int main(int argc, char** argv)
+{
+  size_t iterations =
+    std::max<size_t>(argc > 1 ? strtoull(argv[1], nullptr, 0) : 16, 1);
+  // Large allocations have chunks to themselves and are returned to the
+  // shared memory provider when they are freed.
+  static const size_t size = 32 * 1024 * 1024;
+  size_t reused = 0;
+  size_t failures = 0;
+  try
+  {
+    BenchSandbox sandbox;
+    for (size_t i = 0; i < iterations; i++)
+    {
+      uintptr_t freed = sandbox.alloc_and_free(size);
+      char* mine = sandbox.lib.alloc<char>(size);
+      if (reinterpret_cast<uintptr_t>(mine) == freed)
+      {
+        reused++;
+      }
+      // Make the child take another chunk, which needs a pagemap update that
+      // it waits for, so that any update still pending from the first call
+      // has been applied before we check the parent's allocation.
+      sandbox.alloc_and_free(2 * size);
+      if (sandbox.usable_size(mine) < size)
+      {
+        fprintf(stderr, "Pagemap entry for %p was overwritten\n", mine);
+        failures++;
+      }
+      sandbox.lib.free(mine);
+    }
+  }
+  catch (std::runtime_error& e)
+  {
+    fprintf(stderr, "Sandbox exception: %s\n", e.what());
+    failures++;
+  }
+  printf(
+    "%zu iterations, parent reused the child's chunk %zu times\n",
+    iterations,
+    reused);
+  if (reused == 0)
+  {
+    printf("The parent never reused a chunk freed by the child\n");
+    failures++;
+  }
+  if (failures != 0)
+  {
+    printf("%zu failures\n", failures);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -4,7 +4,15 @@
 #include "sandbox.hh"
 #include "shared.h"
 
+#ifdef __linux__
+#  include <malloc.h>
+#else
+#  include <malloc_np.h>
+#endif
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 int sum(int a, int b)
 {
@@ -12,6 +20,123 @@ int sum(int a, int b)
   return a + b;
 }
 
+int add(int a, int b)
+{
+  return a + b;
+}
+
+/**
+ * Allocate and free memory in a pattern that forces the allocator to request
+ * new slabs, superslabs, and large allocations, each of which requires a
+ * pagemap update from the parent.  Returns the number of allocations that
+ * succeeded.
+ */
+int alloc_churn(int rounds)
+{
+  static const size_t live_count = 256;
+  void* live[live_count] = {nullptr};
+  int succeeded = 0;
+  for (int round = 0; round < rounds; round++)
+  {
+    for (size_t i = 0; i < live_count; i++)
+    {
+      free(live[i]);
+      // Sizes from 16 bytes up to 32 MiB, so that we hit small, medium and
+      // large allocation paths.
+      size_t size = 16ULL << ((i + static_cast<size_t>(round)) % 22);
+      live[i] = malloc(size);
+      if (live[i] != nullptr)
+      {
+        // Touch only the first byte, so that the pages stay uncommitted.
+        *static_cast<char*>(live[i]) = static_cast<char>(i);
+        succeeded++;
+      }
+    }
+  }
+  for (auto p : live)
+  {
+    free(p);
+  }
+  return succeeded;
+}
+
+/**
+ * Allocate, fill, and free memory.  Unlike `alloc_churn`, this writes to every
+ * byte of each allocation, so that the memory is committed and we can see
+ * whether it is returned to the OS when it is freed.  Returns the number of
+ * bytes written.
+ */
+long fill_churn(int rounds)
+{
+  static const size_t live_count = 64;
+  void* live[live_count] = {nullptr};
+  long written = 0;
+  for (int round = 0; round < rounds; round++)
+  {
+    for (size_t i = 0; i < live_count; i++)
+    {
+      free(live[i]);
+      // Sizes from 4 KiB up to 16 MiB.
+      size_t size = 4096ULL << ((i + static_cast<size_t>(round)) % 13);
+      live[i] = malloc(size);
+      if (live[i] != nullptr)
+      {
+        memset(live[i], static_cast<int>(i), size);
+        written += static_cast<long>(size);
+      }
+    }
+  }
+  for (auto p : live)
+  {
+    free(p);
+  }
+  return written;
+}
+
+/**
+ * Compute a simple checksum of a buffer.  This reads every byte, so that the
+ * cost of passing the buffer into the sandbox can be compared with the cost of
+ * touching its contents.
+ */
+unsigned long checksum(const unsigned char* buffer, unsigned long length)
+{
+  unsigned long a = 1;
+  unsigned long b = 0;
+  for (unsigned long i = 0; i < length; i++)
+  {
+    a = (a + buffer[i]) % 65521;
+    b = (b + a) % 65521;
+  }
+  return (b << 16) | a;
+}
+
+/**
+ * Allocate `size` bytes, write to the first byte, and free the allocation
+ * again.  Returns the address of the allocation, so that the parent can tell
+ * whether it later reuses the same chunk.
+ */
+uintptr_t alloc_and_free(size_t size)
+{
+  char* p = static_cast<char*>(malloc(size));
+  if (p == nullptr)
+  {
+    return 0;
+  }
+  *p = 1;
+  free(p);
+  return reinterpret_cast<uintptr_t>(p);
+}
+
+/**
+ * Returns the size of an allocation as seen by the allocator in the sandbox.
+ * This is read from the pagemap entry for the chunk containing `p`, so it can
+ * be used to check the pagemap for memory that the parent allocated.
+ */
+size_t usable_size(void* p)
+{
+  return malloc_usable_size(p);
+}
+
 int crash()
 {
   abort();
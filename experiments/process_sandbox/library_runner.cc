@@ -5,6 +5,7 @@
 #include <dlfcn.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -12,6 +13,7 @@
 #  include <sys/capsicum.h>
 #endif
 #include <aal/aal.h>
+#include <algorithm>
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -153,6 +155,58 @@ namespace
    */
   int pagemap_socket = -1;
 
+  /**
+   * The shared memory region.  Pagemap updates wait for the parent to
+   * acknowledge them via a counter in this region.
+   */
+  SharedMemoryRegion* shared_region;
+
+  /**
+   * The largest number of pagemap updates that are sent to the parent in a
+   * single write.  This keeps each write below `PIPE_BUF`, so that it is
+   * atomic.
+   */
+  constexpr size_t max_batched_updates = 64;
+  static_assert(max_batched_updates * sizeof(PagemapUpdate) <= PIPE_BUF);
+
+  /**
+   * Lock protecting the queue of pagemap updates, `batches_sent`, and
+   * `pagemap_updates_sent`.  Each worker thread has its own allocator, so
+   * several threads may request pagemap updates at once.
+   */
+  std::mutex pagemap_lock;
+
+  /**
+   * Lock held while writing to the pagemap socket.  The sequence numbers of
+   * updates must match the order in which they are written to the socket, so
+   * only one thread takes a batch from the queue and sends it at a time.
+   * Threads that arrive while a batch is being sent add their updates to the
+   * queue and one of them sends the next batch on behalf of all of them.
+   */
+  std::mutex pagemap_send_lock;
+
+  /**
+   * Updates that have been requested but not yet sent to the parent.
+   */
+  PagemapUpdate queued_updates[max_batched_updates];
+
+  /**
+   * The number of valid entries in `queued_updates`.
+   */
+  size_t queued_update_count = 0;
+
+  /**
+   * The number of batches that have been taken from the queue and sent.  A
+   * thread that finds this has changed since it queued an update knows that
+   * its update has already been sent.
+   */
+  uint64_t batches_sent = 0;
+
+  /**
+   * The number of pagemap update requests that have been sent to the parent.
+   */
+  uint64_t pagemap_updates_sent = 0;
+
   /**
    * A pointer to the object that manages the vtable exported by this library.
    */
@@ -178,6 +232,55 @@ namespace
   }
 }
 
+namespace
+{
+  /**
+   * Add `update` to the queue of updates to send to the parent.  A `Set`
+   * update for the chunk on either side of a run of chunks that the most
+   * recently queued update sets to the same value is merged into it, so that
+   * threads allocating adjacent chunks from the shared memory provider at the
+   * same time produce a single `SetRange` update.  Only the last update is
+   * considered, so that updates are never reordered.
+   *
+   * Returns false if the queue is full.  Must be called with `pagemap_lock`
+   * held.
+   */
+  bool queue_pagemap_update(PagemapUpdate update)
+  {
+    if ((queued_update_count > 0) && (update.kind() == PagemapUpdate::Set))
+    {
+      PagemapUpdate& last = queued_updates[queued_update_count - 1];
+      bool mergeable =
+        ((last.kind() == PagemapUpdate::Set) ||
+         (last.kind() == PagemapUpdate::SetRange)) &&
+        (last.value() == update.value()) &&
+        (last.entries() < PagemapUpdate::max_range_entries);
+      if (mergeable)
+      {
+        size_t entries = last.entries();
+        uintptr_t start = last.address();
+        uintptr_t end = start + (entries * SUPERSLAB_SIZE);
+        uintptr_t address = update.address();
+        if ((address == end) || (address + SUPERSLAB_SIZE == start))
+        {
+          last = PagemapUpdate::make(
+            std::min(start, address),
+            update.value(),
+            PagemapUpdate::SetRange,
+            entries + 1);
+          return true;
+        }
+      }
+    }
+    if (queued_update_count == max_batched_updates)
+    {
+      return false;
+    }
+    queued_updates[queued_update_count++] = update;
+    return true;
+  }
+}
+
 namespace sandbox
 {
   void ProxyPageMap::set(uintptr_t p, uint8_t x, uint8_t big = 0)
@@ -187,17 +290,61 @@ namespace sandbox
       (p < reinterpret_cast<uintptr_t>(shared_memory_end)))
     {
       assert(pagemap_socket > 0);
-      auto msg = static_cast<uint64_t>(p);
-      // Make sure that the low 16 bytes are clear
-      assert((msg & 0xffff) == 0);
-      msg &= ~0xffff;
-      msg |= x;
-      msg |= big << 8;
-      write(pagemap_socket, static_cast<void*>(&msg), sizeof(msg));
-      while (GlobalPagemap::pagemap().get(p) != x)
+      auto update =
+        PagemapUpdate::make(p, x, static_cast<PagemapUpdate::Kind>(big));
+      uint64_t batch;
+      for (;;)
       {
-        // write(fileno(stderr), "Child spinning\n", 15);
-        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::lock_guard g(pagemap_lock);
+        if (queue_pagemap_update(update))
+        {
+          batch = batches_sent;
+          break;
+        }
+        // The queue is full.  The threads that filled it are waiting to send
+        // it, so wait for one of them to do so.
+        Aal::pause();
+      }
+      uint64_t wait_for;
+      {
+        std::lock_guard s(pagemap_send_lock);
+        PagemapUpdate batch_updates[max_batched_updates];
+        size_t count = 0;
+        {
+          std::lock_guard g(pagemap_lock);
+          // If another thread has sent a batch since we queued our update,
+          // then our update was in it.
+          if (batches_sent == batch)
+          {
+            count = queued_update_count;
+            std::copy_n(queued_updates, count, batch_updates);
+            queued_update_count = 0;
+            batches_sent++;
+            pagemap_updates_sent += count;
+          }
+          wait_for = pagemap_updates_sent;
+        }
+        if (count > 0)
+        {
+          write(
+            pagemap_socket,
+            static_cast<void*>(batch_updates),
+            count * sizeof(PagemapUpdate));
+        }
+      }
+      // Wait for the parent to process this request.  The parent handles
+      // requests in order and increments the counter after each one, so once
+      // it has applied every request sent so far it has applied ours.
+      //
+      // Updates that clear an entry must be waited for as well.  Once it has
+      // been cleared, the chunk goes back to the memory provider that we share
+      // with the parent's allocator for this sandbox, which may reuse it
+      // straight away and set its own entry.  A clear that was applied after
+      // that would overwrite the parent's entry.
+      while (shared_region->pagemap_updates_applied.load(
+               std::memory_order_acquire) < wait_for)
+      {
+        Aal::pause();
       }
     }
     else
@@ -298,41 +445,105 @@ namespace sandbox
      */
     struct SharedMemoryRegion* shared_mem;
 
+    /**
+     * The sequence number of the next call to be claimed by a worker thread.
+     */
+    std::atomic<uint32_t> next_call;
+
+    /**
+     * The number of worker threads that have not yet stopped.  The last one to
+     * stop after the parent asks us to exit terminates the process.
+     */
+    std::atomic<size_t> running_workers;
+
   public:
     /**
      * Constructor.  Takes the socket over which this process should receive
      * additional file descriptors and the shared memory region.
      */
     ExportedLibraryPrivate(handle_t sock, SharedMemoryRegion* region)
-    : socket_fd(sock), shared_mem(region)
+    : socket_fd(sock),
+      shared_mem(region),
+      next_call(0),
+      running_workers(0)
     {}
 
     /**
      * The run loop.  Takes the public interface of this library (effectively,
-     * the library's vtable) as an argument.
+     * the library's vtable) as an argument.  This is run by every worker
+     * thread.
+     *
+     * Calls arrive in a ring in the shared region.  Workers claim calls in
+     * order and keep claiming until the ring is empty, so a parent that pushes
+     * calls faster than we complete them never makes us sleep.
+     *
+     * Returns when the parent asks us to exit, unless this is the last worker
+     * thread running, in which case it exits the process.  Workers only check
+     * for this between calls, so the process never exits while another worker
+     * is part way through a call.
      */
     void runloop(ExportedLibrary* library)
     {
       while (1)
       {
-        shared_mem->wait(true);
+        uint32_t call = next_call.load();
+        uint32_t enqueued =
+          shared_mem->calls_enqueued.value.load(std::memory_order_acquire);
         if (shared_mem->should_exit)
         {
-          exit(0);
+          if (running_workers.fetch_sub(1) == 1)
+          {
+            exit(0);
+          }
+          return;
+        }
+        if (call == enqueued)
+        {
+          shared_mem->calls_enqueued.wait([&](uint32_t value) {
+            return (value != next_call.load()) || shared_mem->should_exit;
+          });
+          continue;
         }
-        assert(shared_mem->is_child_executing);
+        if (!next_call.compare_exchange_weak(call, call + 1))
+        {
+          continue;
+        }
+        CallDescriptor& slot =
+          shared_mem->calls[call % SharedMemoryRegion::call_ring_size];
         try
         {
-          (*library->functions[shared_mem->function_index])(
-            shared_mem->msg_buffer);
+          (*library->functions.at(slot.function_index))(slot.msg_buffer);
         }
         catch (...)
         {
           // FIXME: Report error in some useful way.
           printf("Exception!\n");
         }
-        shared_mem->signal(false);
+        slot.completed_call.store(call + 1, std::memory_order_release);
+        shared_mem->calls_completed.increment();
+      }
+    }
+
+    /**
+     * Run `workers` worker threads, including the calling thread.  This does
+     * not return.  Each new thread gets its own allocator over the shared
+     * region before it runs any library code.
+     */
+    [[noreturn]] void run_workers(ExportedLibrary* library, size_t workers)
+    {
+      running_workers = workers;
+      for (size_t i = 1; i < workers; i++)
+      {
+        std::thread t([this, library]() {
+          ThreadAlloc::get_reference() = current_alloc_pool()->acquire();
+          runloop(library);
+        });
+        t.detach();
       }
+      runloop(library);
+      // Another worker is still finishing a call and will exit the process
+      // when it is done.  Returning from `main` would exit immediately.
+      pthread_exit(nullptr);
     }
   };
 }
@@ -342,13 +553,14 @@ char* ExportedLibrary::type_encoding(int idx)
   return functions.at(idx)->type_encoding();
 }
 
-int main(int, char** argv)
+int main(int argc, char** argv)
 {
 #ifdef USE_CAPSICUM
   cap_enter();
 #endif
   void* addr = (void*)strtoull(argv[1], nullptr, 0);
   size_t length = strtoull(argv[2], nullptr, 0);
+  size_t workers = (argc > 3) ? strtoull(argv[3], nullptr, 0) : 1;
   // fprintf(stderr, "Child starting\n");
   // printf(
   //"Child trying to map fd %d at addr %p (0x%zx)\n", SharedMemRegion, addr,
@@ -370,6 +582,7 @@ int main(int, char** argv)
   close(SharedMemRegion);
 
   auto shared = reinterpret_cast<SharedMemoryRegion*>(ptr);
+  shared_region = shared;
   // Splice the pagemap page inherited from the parent into the pagemap.
   void* pagemap_chunk =
     GlobalPagemap::pagemap().page_for_address(reinterpret_cast<uintptr_t>(ptr));
@@ -396,6 +609,16 @@ int main(int, char** argv)
     snmalloc::make_alloc_pool<GlobalVirtual, Alloc>(*global_virtual);
   ThreadAlloc::get_reference() = current_alloc_pool()->acquire();
 
+  // Everything up to this point is trusted.  Wait until the parent allows us
+  // to load the library: sandboxes in a pool are parked here until they are
+  // handed out.
+  shared->library_start.wait(
+    [&](uint32_t value) { return (value != 0) || shared->should_exit; });
+  if (shared->should_exit)
+  {
+    exit(0);
+  }
+
   void* handle = fdlopen(MainLibrary, RTLD_GLOBAL);
   if (handle == nullptr)
   {
@@ -416,7 +639,5 @@ int main(int, char** argv)
   library->export_function(exported_types);
   sandbox_init(library);
 
-  libPrivate->runloop(library);
-
-  return 0;
+  libPrivate->run_workers(library, (workers == 0) ? 1 : workers);
 }
@@ -11,8 +11,10 @@
 #ifdef __unix__
 #  include <dlfcn.h>
 #  include <err.h>
+#  include <errno.h>
 #  include <fcntl.h>
 #  include <libgen.h>
+#  include <limits.h>
 #  include <pthread.h>
 #  include <stdio.h>
 #  include <sys/mman.h>
@@ -31,17 +33,25 @@
 #  if defined(USE_KQUEUE) || defined(USE_KQUEUE_PROCDESC)
 #    include <sys/event.h>
 #  endif
+#  include <poll.h>
+#  if defined(__linux__) && !defined(USE_KQUEUE)
+#    include <sys/epoll.h>
+#  endif
 #  ifndef USE_KQUEUE
-#    include <poll.h>
 #    ifndef INFTIM
 #      define INFTIM -1
 #    endif
 #  endif
 #  ifdef __linux__
 #    include <bsd/unistd.h>
+#    include <linux/futex.h>
+#    include <sys/syscall.h>
 #    define MAP_ALIGNED(x) 0
 #    define MAP_NOCORE 0
 #  endif
+#  ifdef __FreeBSD__
+#    include <sys/umtx.h>
+#  endif
 #endif
 #include "sandbox.hh"
 
@@ -119,6 +129,13 @@ namespace sandbox
      * run.  We then fill in the value of the other fields.
      */
     bool isInitialised;
+    /**
+     * Flag indicating that the OS has refused to discard pages of the shared
+     * heap's backing store, so discarded pages are not guaranteed to be
+     * zero when they are next used.  Like `isInitialised`, this relies on
+     * being zero-initialised.
+     */
+    bool remove_unsupported;
     /**
      * Inherit the default page size from the system PAL.
      */
@@ -173,13 +190,55 @@ namespace sandbox
       return reinterpret_cast<void*>(rounded_start);
     }
     /**
-     * Zero some memory.  Ideally, we'd ask the kernel to replace these pages
-     * with fresh zeroed ones, but unfortunately we can't do that with shared
-     * memory pages.
+     * Try to discard the pages in the range from the shared memory object that
+     * backs the heap.  On success, the memory is returned to the OS and both
+     * the parent and the child see zeroed pages on their next access.
+     *
+     * `MADV_FREE` and `MADV_DONTNEED` do not do this for shared mappings:
+     * they either fail or drop only this process's mapping of the pages.
+     * `MADV_REMOVE` punches a hole in the shared memory object itself.
+     */
+    bool discard(void* p, size_t size) noexcept
+    {
+#ifdef MADV_REMOVE
+      if (!remove_unsupported)
+      {
+        if (madvise(p, size, MADV_REMOVE) == 0)
+        {
+          return true;
+        }
+        remove_unsupported = true;
+      }
+#else
+      (void)p;
+      (void)size;
+#endif
+      return false;
+    }
+    /**
+     * Returns true if pages released with `notify_not_using` are guaranteed
+     * to be zero when they are next used.
+     */
+    bool discard_zeroes() const noexcept
+    {
+#ifdef MADV_REMOVE
+      return !remove_unsupported;
+#else
+      return false;
+#endif
+    }
+    /**
+     * Zero some memory.  For large page-aligned ranges, we ask the kernel to
+     * discard the pages, which is cheaper than writing to them and does not
+     * commit them.  Otherwise, or if that fails, we zero them explicitly.
      */
     template<bool page_aligned = false>
     void zero(void* p, size_t size) noexcept
     {
+      if (page_aligned && (size >= 16 * page_size) && discard(p, size))
+      {
+        return;
+      }
       bzero(p, size);
     }
 
@@ -198,17 +257,22 @@ namespace sandbox
      */
     void notify_not_using(void* p, size_t size) noexcept
     {
-      madvise(p, size, MADV_FREE);
+      if (!discard(p, size))
+      {
+        madvise(p, size, MADV_FREE);
+      }
     }
 
     /**
      * Notify the kernel that we are using these pages.  This is a no-op on
-     * FreeBSD - the next store provides the notification.
+     * FreeBSD - the next store provides the notification.  If the pages were
+     * discarded from the backing store when they were last released then
+     * they are already zero and so we do not need to touch them.
      */
     template<snmalloc::ZeroMem zero_mem>
     void notify_using(void* p, size_t size) noexcept
     {
-      if (zero_mem == snmalloc::YesZero)
+      if ((zero_mem == snmalloc::YesZero) && !discard_zeroes())
         zero(p, size);
     }
   };
@@ -234,6 +298,97 @@ namespace
    */
   using SharedMemoryProvider = snmalloc::MemoryProviderStateMixin<
     snmalloc::PALPlainMixin<sandbox::MemoryProviderBumpPointerState>>;
+  /**
+   * A request from a child to update the pagemap.  Each request is a single
+   * 64-bit word, so that writing one to a pipe is atomic.  The low byte holds
+   * the value and the next byte holds the kind of update.  The third byte
+   * holds one less than the number of entries that a `SetRange` update
+   * covers.  The remaining bits are the address, which is always chunk
+   * aligned.
+   */
+  struct PagemapUpdate
+  {
+    /**
+     * The kinds of update that a child can request.
+     */
+    enum Kind : uint8_t
+    {
+      /**
+       * Set a single pagemap entry, typically for a slab.
+       */
+      Set = 0,
+      /**
+       * Set the entries for a large allocation.  The value is the base-2
+       * logarithm of the size.
+       */
+      SetLarge = 1,
+      /**
+       * Clear the entries for a large allocation.  The value is the base-2
+       * logarithm of the size.
+       */
+      ClearLarge = 2,
+      /**
+       * Set a run of consecutive pagemap entries to the same value.  A child
+       * sends this in place of several `Set` updates for adjacent chunks.
+       */
+      SetRange = 3,
+    };
+    /**
+     * The largest number of entries that a single `SetRange` update can
+     * cover.
+     */
+    static constexpr size_t max_range_entries = 256;
+    /**
+     * The encoded message.
+     */
+    uint64_t msg;
+    /**
+     * Construct an update of `entries` pagemap entries starting at `address`.
+     */
+    static PagemapUpdate
+    make(uintptr_t address, uint8_t value, Kind kind, size_t entries = 1)
+    {
+      assert((address & 0xffffff) == 0);
+      assert((entries > 0) && (entries <= max_range_entries));
+      uint64_t msg = static_cast<uint64_t>(address);
+      msg |= value;
+      msg |= static_cast<uint64_t>(kind) << 8;
+      msg |= static_cast<uint64_t>(entries - 1) << 16;
+      return {msg};
+    }
+    /**
+     * The address of the first pagemap entry to update.
+     */
+    uintptr_t address() const
+    {
+      return static_cast<uintptr_t>(msg & ~uint64_t(0xffffff));
+    }
+    /**
+     * The number of entries that a `SetRange` update covers.
+     */
+    size_t entries() const
+    {
+      return ((msg >> 16) & 0xff) + 1;
+    }
+    /**
+     * The value to store in the pagemap.
+     */
+    uint8_t value() const
+    {
+      return msg & 0xff;
+    }
+    /**
+     * The kind of update.
+     */
+    Kind kind() const
+    {
+      return static_cast<Kind>((msg >> 8) & 0xff);
+    }
+  };
+  static_assert(sizeof(PagemapUpdate) == sizeof(uint64_t));
+  static_assert(
+    snmalloc::SUPERSLAB_BITS >= 24,
+    "Chunk addresses must leave the low three bytes for the update");
   /**
    * Singleton class that handles pagemap updates from children.  This listens
    * on a socket for updates, validates that they correspond to the memory that
@@ -286,6 +441,78 @@ namespace
       eof = (event.flags & EV_EOF) == EV_EOF;
       return true;
     }
+#elif defined(__linux__)
+    /**
+     * The epoll descriptor used to wait for pagemap updates from the child.
+     * Like kqueue, epoll can safely be updated from other threads while we
+     * are waiting on it, so no other synchronisation or wakeup mechanism is
+     * needed when a new sandbox is registered.
+     */
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    /**
+     * The maximum number of events to collect with a single `epoll_wait`.
+     */
+    static constexpr int max_events = 64;
+    /**
+     * Events returned by the last `epoll_wait` call.  Entries from
+     * `next_event` to `ready_events` have not yet been returned by `poll`.
+     */
+    struct epoll_event events[max_events];
+    /**
+     * The number of valid entries in `events`.
+     */
+    int ready_events = 0;
+    /**
+     * The index of the next entry in `events` to return from `poll`.
+     */
+    int next_event = 0;
+    /**
+     * Add a new socket that we'll wait for.  This can be called from any
+     * thread without synchronisation.
+     *
+     * The registration is edge triggered: we are notified only when new data
+     * arrives, so the run loop must drain the socket each time.
+     */
+    void register_fd(int socket_fd)
+    {
+      struct epoll_event event;
+      memset(&event, 0, sizeof(event));
+      event.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+      event.data.fd = socket_fd;
+      if (epoll_ctl(epfd, EPOLL_CTL_ADD, socket_fd, &event) == -1)
+      {
+        err(1, "Setting up epoll");
+      }
+    }
+    /**
+     * Wait for an update from a child process.  This blocks and returns true
+     * if there is a message, false if an error occurred.  On success, `fd`
+     * will be set to the file descriptor associated with the event and `eof`
+     * will be set to true if the socket has been closed at the remote end,
+     * false otherwise.
+     *
+     * This is called only by the thread spawned by this class.
+     */
+    bool poll(int& fd, bool& eof)
+    {
+      while (next_event == ready_events)
+      {
+        next_event = 0;
+        ready_events = epoll_wait(epfd, events, max_events, -1);
+        if (ready_events == -1)
+        {
+          ready_events = 0;
+          if (errno != EINTR)
+          {
+            return false;
+          }
+        }
+      }
+      auto& event = events[next_event++];
+      fd = event.data.fd;
+      eof = (event.events & (EPOLLHUP | EPOLLRDHUP | EPOLLERR)) != 0;
+      return true;
+    }
 #elif defined(__unix)
     /**
      * Mutex that protects the metadata about registered file descriptors.
@@ -432,9 +659,16 @@ namespace
 #  error Event polling not implemented for this target.
 #endif
     /**
-     * Mutex that protects the `ranges` map.
+     * Mutex that protects the `ranges` map.  This is held while applying
+     * updates, so once a sandbox has been removed with `remove_range`, no
+     * further updates from it will be applied.
      */
     std::mutex m;
+    /**
+     * The maximum number of update requests that we read from a child with a
+     * single system call.
+     */
+    static constexpr size_t update_batch_size = 64;
     /**
      * Metadata about a sandbox for which we are updating the page map.
      */
@@ -449,6 +683,12 @@ namespace
        * process.
        */
       uint8_t* shared_page = nullptr;
+      /**
+       * The counter, in the sandbox's shared memory region, that we increment
+       * after processing each update request so that the requesting thread
+       * knows that it can proceed.
+       */
+      std::atomic<uint64_t>* updates_applied = nullptr;
     };
     /**
      * A map from file descriptor over which we've received an update request
@@ -464,59 +704,93 @@ namespace
       bool eof;
       while (poll(fd, eof))
       {
+        // Process any pending updates first: the socket may have been closed
+        // after the last few updates were sent.
+        process_updates(fd);
         // If a child's socket closed, unmap its shared page and delete the
         // metadata that we have associated with it.
         if (eof)
         {
           std::lock_guard g(m);
           auto r = ranges.find(fd);
-          munmap(r->second.shared_page, snmalloc::OS_PAGE_SIZE);
-          ranges.erase(r);
+          if (r != ranges.end())
+          {
+            munmap(r->second.shared_page, snmalloc::OS_PAGE_SIZE);
+            ranges.erase(r);
+          }
           close(fd);
-          continue;
-        }
-        uint64_t update;
-        if (read(fd, static_cast<void*>(&update), sizeof(uint64_t)) != 8)
-        {
-          err(1, "Read from pagemap update socket %d failed", fd);
         }
-        size_t position = update & ~0xffff;
-        char value = update & 0xff;
-        uint8_t isBig = (update & 0xff00) >> 8;
-        validate_and_insert(fd, position, isBig, value);
-        std::atomic_thread_fence(std::memory_order_seq_cst);
       }
       err(1, "Waiting for pagetable updates failed");
     }
     /**
-     * Validate a request from the sandbox to update a pagemap and insert it if
-     * allowed.  The `sender` parameter is the file descriptor over which the
-     * message was sent. The `position` parameter is the address of the memory
-     * for which the corresponding pagemap entry is to be updated.  For the
-     * update to succeed, this must be within the range owned by the sandbox
-     * identified by the sending socket.  The last two parameters indicate
-     * whether this is a large allocation (one that spans multiple pagemap
-     * entries) and the value.  If `isBig` is 0, then this is a simple update
-     * of a single pagemap entry (typically a slab), specified in the `value`
-     * parameter.  Otherwise, `value` is the base-2 logarithm of the size,
-     * which is either being set or cleared (`isBig` values of 1 and 2,
-     * respectively).
-     */
-    void validate_and_insert(
-      int sender, size_t position, uint8_t isBig, uint8_t value)
-    {
-      decltype(ranges)::iterator r;
-      Sandbox s;
+     * Read and apply all of the pending updates from the socket `fd`.  The
+     * sockets are non-blocking, so this reads batches of updates until the
+     * socket is empty, applying each batch and acknowledging all of the
+     * updates in it with a single write.
+     */
+    void process_updates(int fd)
+    {
+      uint64_t updates[update_batch_size];
+      ssize_t bytes;
+      while ((bytes = read(fd, static_cast<void*>(updates), sizeof(updates))) >
+             0)
       {
-        std::lock_guard g(m);
-        r = ranges.find(sender);
-        if (r == ranges.end())
+        // Updates are written in batches that are no larger than `PIPE_BUF`,
+        // so each write is atomic and we never see part of an update.
+        if ((bytes % sizeof(uint64_t)) != 0)
+        {
+          err(1, "Partial update read from pagemap update socket %d", fd);
+        }
+        size_t count = static_cast<size_t>(bytes) / sizeof(uint64_t);
+        {
+          std::lock_guard g(m);
+          auto r = ranges.find(fd);
+          if (r != ranges.end())
+          {
+            for (size_t i = 0; i < count; i++)
+            {
+              validate_and_insert(r->second, fd, {updates[i]});
+            }
+            // Acknowledge the requests, even if we rejected them, so that the
+            // child threads that sent them don't wait forever.  The release
+            // ordering makes the pagemap updates visible before the
+            // acknowledgement.
+            r->second.updates_applied->fetch_add(
+              count, std::memory_order_release);
+          }
+        }
+        // A short read means that the socket is now empty.  If more data
+        // arrives later, we will be notified again.
+        if (static_cast<size_t>(bytes) < sizeof(updates))
         {
           return;
         }
-        s = r->second;
       }
+      if ((bytes == -1) && (errno != EAGAIN) && (errno != EWOULDBLOCK))
+      {
+        err(1, "Read from pagemap update socket %d failed", fd);
+      }
+    }
+    /**
+     * Validate a request from the sandbox to update a pagemap and insert it if
+     * allowed.  The `s` parameter is the metadata for the sandbox that sent
+     * the request and `sender` is the file descriptor over which the message
+     * was sent.  The address in the update is the start of the memory for
+     * which the corresponding pagemap entries are to be updated.  For the
+     * update to succeed, every entry that it touches must be within the range
+     * owned by the sandbox identified by the sending socket.  A `Set` update
+     * changes a single pagemap entry (typically a slab) and a `SetRange`
+     * update changes a run of them, checking the whole run once.  For
+     * `SetLarge` and `ClearLarge` updates, the value is the base-2 logarithm
+     * of the size of a large allocation, which is either being set or
+     * cleared.
+     */
+    void validate_and_insert(const Sandbox& s, int sender, PagemapUpdate update)
+    {
       auto range = s.range;
+      size_t position = update.address();
+      uint8_t value = update.value();
       if ((position < range.first) || (position >= range.second))
       {
         return;
@@ -533,7 +807,7 @@ namespace
         // FIXME: Check this for off-by-one errors!
         return (alloc_size + position <= range.second);
       };
-      switch (isBig)
+      switch (update.kind())
       {
         default:
           fprintf(
@@ -541,21 +815,36 @@ namespace
             "Invalid pagemap update received from sandbox %d\n",
             sender);
           break;
-        case 0:
+        case PagemapUpdate::Set:
           // FIXME: Check that this is a valid small update size
           cpm.set(p, value);
           break;
-        case 1:
+        case PagemapUpdate::SetRange:
+        {
+          entries = update.entries();
+          size_t available =
+            (range.second - position) / snmalloc::SUPERSLAB_SIZE;
+          bool valid_value = (value == snmalloc::CMNotOurs) ||
+            (value == snmalloc::CMSuperslab) ||
+            (value == snmalloc::CMMediumslab);
+          if ((safe = (entries <= available) && valid_value))
+          {
+            cpm.set_range(p, value, entries);
+          }
+          break;
+        }
+        case PagemapUpdate::SetLarge:
           if ((safe = check_large_update()))
           {
             pm.set_large_size(reinterpret_cast<void*>(p), 1ULL << value);
           }
           break;
-        case 2:
+        case PagemapUpdate::ClearLarge:
           if ((safe = check_large_update()))
           {
             pm.clear_large_size(reinterpret_cast<void*>(p), 1ULL << value);
           }
+          break;
       }
       if (safe)
       {
@@ -588,9 +877,15 @@ namespace
      * parameters indicate the address range assigned to this sandbox.
      * `socket_fd` provides the file descriptor for the socket over which the
      * sandbox will send update requests.  `pagemap_fd` is the shared pagemap
-     * page.
+     * page.  `updates_applied` is the counter in the sandbox's shared memory
+     * that is incremented after each request is processed.
      */
-    uint8_t* add_range(size_t start, size_t end, int socket_fd, int pagemap_fd)
+    uint8_t* add_range(
+      size_t start,
+      size_t end,
+      int socket_fd,
+      int pagemap_fd,
+      std::atomic<uint64_t>* updates_applied)
     {
       uint8_t* shared_pagemap = static_cast<uint8_t*>(mmap(
         nullptr,
@@ -605,11 +900,39 @@ namespace
       }
       {
         std::lock_guard g(m);
-        ranges[socket_fd] = {{start, end}, shared_pagemap};
+        ranges[socket_fd] = {{start, end}, shared_pagemap, updates_applied};
       }
+      // The run loop drains each socket until it would block.
+      fcntl(socket_fd, F_SETFL, fcntl(socket_fd, F_GETFL) | O_NONBLOCK);
       register_fd(socket_fd);
       return shared_pagemap;
     }
+    /**
+     * Stop applying updates from the sandbox whose address range starts at
+     * `start`.  When this returns, no further updates from that sandbox will
+     * be applied, even if they have already been sent.  The socket itself is
+     * closed by the run loop when the remote end is closed.
+     *
+     * The sandbox is identified by its address range rather than by its
+     * socket: by the time this is called, the run loop may already have seen
+     * the end of the stream and closed the socket, and the same descriptor
+     * number may have been given to another sandbox.  Address ranges are
+     * never shared by two live sandboxes.  If no range starts at `start`, the
+     * run loop has already removed it and this does nothing.
+     */
+    void remove_range(size_t start)
+    {
+      std::lock_guard g(m);
+      for (auto r = ranges.begin(); r != ranges.end(); ++r)
+      {
+        if (r->second.range.first == start)
+        {
+          munmap(r->second.shared_page, snmalloc::OS_PAGE_SIZE);
+          ranges.erase(r);
+          return;
+        }
+      }
+    }
   };
   /**
    * Return a singleton instance of the pagemap owner.
@@ -730,6 +1053,188 @@ namespace sandbox
     }
   };
 
+#ifdef __unix__
+  namespace
+  {
+    static_assert(
+      sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+      "Futex words must be plain 32-bit integers");
+
+    /**
+     * Sleep on the futex word at `addr` as long as it contains `expected`.
+     * The `timeout` is relative and may be null to sleep indefinitely.
+     * Returns false if the timeout expired, true if we were woken (or if the
+     * word did not contain `expected` when we tried to sleep).
+     *
+     * The word lives in memory shared with another process, so this must not
+     * use the process-private variants of the futex operations.
+     */
+    bool futex_wait(
+      std::atomic<uint32_t>* addr,
+      uint32_t expected,
+      const struct timespec* timeout)
+    {
+#  ifdef __linux__
+      long ret = syscall(
+        SYS_futex,
+        reinterpret_cast<uint32_t*>(addr),
+        FUTEX_WAIT,
+        expected,
+        timeout,
+        nullptr,
+        0);
+#  elif defined(__FreeBSD__)
+      int ret = _umtx_op(
+        addr,
+        UMTX_OP_WAIT_UINT,
+        expected,
+        timeout == nullptr ?
+          nullptr :
+          reinterpret_cast<void*>(sizeof(struct timespec)),
+        const_cast<struct timespec*>(timeout));
+#  else
+#    error Futex wait not implemented for this target.
+#  endif
+      return !((ret == -1) && (errno == ETIMEDOUT));
+    }
+
+    /**
+     * Wake all threads sleeping on the futex word at `addr`.
+     */
+    void futex_wake(std::atomic<uint32_t>* addr)
+    {
+#  ifdef __linux__
+      syscall(
+        SYS_futex,
+        reinterpret_cast<uint32_t*>(addr),
+        FUTEX_WAKE,
+        INT_MAX,
+        nullptr,
+        nullptr,
+        0);
+#  elif defined(__FreeBSD__)
+      _umtx_op(addr, UMTX_OP_WAKE, INT_MAX, nullptr, nullptr);
+#  else
+#    error Futex wake not implemented for this target.
+#  endif
+    }
+  }
+#else
+#  error Missing implementation of futex operations
+#endif
+
+  /**
+   * A 32-bit counter in shared memory that one process advances and the other
+   * waits on.  Waiters spin for a bounded number of iterations and then sleep
+   * on the counter with a futex (or the platform equivalent).
+   */
+  struct Doorbell
+  {
+    /**
+     * The value of the counter.  This is the futex word.
+     */
+    std::atomic<uint32_t> value = 0;
+    /**
+     * The number of threads that are sleeping (or about to sleep) on `value`.
+     * `store` skips the wake system call when this is zero, so an update that
+     * arrives while the other side is still spinning does not enter the
+     * kernel at all.
+     */
+    std::atomic<uint32_t> sleepers = 0;
+    /**
+     * The number of times that `wait` polls the counter before going to sleep.
+     * Short sandboxed calls complete within this window and so avoid both a
+     * sleep and a wake system call.
+     */
+    static constexpr int spin_iterations = 1 << 14;
+    /**
+     * Wait until `pred` returns true for the value of the counter.  The
+     * `timeout` is relative and applies only to the sleeping phase; it may be
+     * null to wait indefinitely.  Returns true if the condition was met or
+     * false if the timeout expired first.
+     *
+     * Callers that need to be woken for a reason other than a change in the
+     * counter (for example, an exit request) must still modify the counter,
+     * or the wake may be lost.
+     */
+    template<typename Pred>
+    bool wait(Pred pred, const struct timespec* timeout = nullptr)
+    {
+      for (int i = 0; i < spin_iterations; i++)
+      {
+        if (pred(value.load(std::memory_order_acquire)))
+        {
+          return true;
+        }
+        snmalloc::Aal::pause();
+      }
+      // Register as a sleeper *before* the final check of the counter.  The
+      // updater stores the new value and then checks `sleepers`, so (with both
+      // sequentially consistent) at least one of us sees the other's write.
+      sleepers++;
+      uint32_t current;
+      bool timed_out = false;
+      while (!pred(current = value.load()) && !timed_out)
+      {
+        timed_out = !futex_wait(&value, current, timeout);
+      }
+      sleepers--;
+      return pred(value.load());
+    }
+    /**
+     * Update the counter and wake any waiters.
+     */
+    void store(uint32_t new_value)
+    {
+      value = new_value;
+      wake_sleepers();
+    }
+    /**
+     * Increment the counter and wake any waiters.  Unlike `store`, this is
+     * safe to call from multiple threads concurrently.
+     */
+    void increment()
+    {
+      value++;
+      wake_sleepers();
+    }
+
+  private:
+    /**
+     * Wake any threads that are sleeping on the counter.
+     */
+    void wake_sleepers()
+    {
+      if (sleepers.load() != 0)
+      {
+        futex_wake(&value);
+      }
+    }
+  };
+
+  /**
+   * A request to invoke a function in the sandbox.  These are stored in a
+   * ring in the shared memory region.
+   */
+  struct CallDescriptor
+  {
+    /**
+     * The index of the function to call in the library's vtable.
+     */
+    int function_index;
+    /**
+     * A pointer to the tuple (in the shared memory range) that contains the
+     * argument frame provided by the sandbox caller.
+     */
+    void* msg_buffer;
+    /**
+     * One more than the sequence number of the last call in this slot to have
+     * completed.  Calls may complete out of order when the child has more
+     * than one worker thread, so each slot records its own completion.
+     */
+    std::atomic<uint32_t> completed_call;
+  };
+
   /**
    * Class representing a view of a shared memory region.  This provides both
    * the parent and child views of the region.
@@ -751,55 +1256,54 @@ namespace sandbox
      */
     std::atomic<bool> should_exit = false;
     /**
-     * The index of the function currently being called.  This interface is not
-     * currently reentrant.
-     */
-    int function_index;
-    /**
-     * A pointer to the tuple (in the shared memory range) that contains the
-     * argument frame provided by the sandbox caller.
+     * Set to a non-zero value when the parent allows the child to load the
+     * library.  The child sets up its heap and then waits on this, so a
+     * sandbox can be created in advance and handed out later.
      */
-    void* msg_buffer = nullptr;
+    Doorbell library_start;
     /**
      * The message queue for the parent's allocator.  This is stored in the
      * shared region because the child must be able to free memory allocated by
      * the parent.
      */
     snmalloc::RemoteAllocator allocator_state;
-#ifdef __unix__
-    /**
-     * Mutex used to protect `cv`.
-     */
-    pthread_mutex_t mutex;
     /**
-     * The condition variable that the child sleeps on when waiting for
-     * messages from the parent.
+     * The number of entries in the call ring.  This must be a power of two so
+     * that the free-running counters below can be used directly as indexes.
      */
-    pthread_cond_t cv;
+    static constexpr uint32_t call_ring_size = 1024;
+    static_assert(snmalloc::bits::is_pow2(call_ring_size));
     /**
-     * Flag indicating whether the child is executing.  Set on startup and
+     * The ring of calls.  The parent writes entries and advances
+     * `calls_enqueued`.  Worker threads in the child claim entries in order,
+     * execute them, mark the slot as complete, and increment
+     * `calls_completed`.
      */
-    std::atomic<bool> is_child_executing = false;
-#endif
+    CallDescriptor calls[call_ring_size];
     /**
-     * Waits until the `is_child_executing` flag is in the `expected` state.
-     * This is used to wait for the child to start and to stop.
+     * The number of calls that the parent has placed in the ring.  The child
+     * sleeps on this when the ring is empty.
      */
-    void wait(bool expected);
+    alignas(64) Doorbell calls_enqueued;
     /**
-     * Wait until the `is_child_executing` flag is in the `expected` state.
-     * Returns true if the condition was met or false if the timeout was
-     * exceeded before the child entered the desired state.
+     * The number of calls that the child has completed.  The parent sleeps on
+     * this when waiting for a result or for space in the ring, and checks the
+     * relevant slot's `completed_call` each time that it changes.
      */
-    bool wait(bool expected, struct timespec timeout);
+    alignas(64) Doorbell calls_completed;
     /**
-     * Update the `is_child_executing` flag and wake up any waiters.  Note that
-     * the `wait` functions will only unblock if `is_child_executing` is
-     * modified using this function.
+     * The number of pagemap update requests from the child that the parent
+     * has processed.  Several child threads may have requests in flight at
+     * once and so each waits for this to pass the sequence number of its own
+     * request, rather than for the pagemap entry to reach a particular value
+     * (which another thread may since have changed).
+     *
+     * This is written by the parent but is in memory that the child can
+     * modify.  A child that corrupts it can only confuse itself.
      */
-    void signal(bool new_state);
+    alignas(64) std::atomic<uint64_t> pagemap_updates_applied = 0;
     /**
-     * Constructor.  Initialises the mutex and condition variables.
+     * Constructor.
      */
     SharedMemoryRegion();
     /**
@@ -811,62 +1315,20 @@ namespace sandbox
     void destroy(size_t size);
   };
 
-#ifdef __unix__
-  void SharedMemoryRegion::wait(bool expected)
+  SharedMemoryRegion::SharedMemoryRegion()
   {
-    pthread_mutex_lock(&mutex);
-    while (expected != is_child_executing)
+    // Mark each slot as if the call `call_ring_size` before its first call
+    // has completed, so that the first pass around the ring doesn't wait.
+    for (uint32_t i = 0; i < call_ring_size; i++)
     {
-      pthread_cond_wait(&cv, &mutex);
+      calls[i].completed_call = i - call_ring_size + 1;
     }
-    pthread_mutex_unlock(&mutex);
-  }
-
-  bool SharedMemoryRegion::wait(bool expected, struct timespec timeout)
-  {
-    struct timespec now;
-    clock_gettime(CLOCK_MONOTONIC, &now);
-    long nsec;
-    time_t carry = __builtin_add_overflow(now.tv_nsec, timeout.tv_nsec, &nsec);
-    timeout.tv_nsec = nsec;
-    timeout.tv_sec += now.tv_sec + carry;
-    pthread_mutex_lock(&mutex);
-    pthread_cond_timedwait(&cv, &mutex, &timeout);
-    bool ret = expected == is_child_executing;
-    pthread_mutex_unlock(&mutex);
-    return ret;
-  }
-
-  void SharedMemoryRegion::signal(bool new_state)
-  {
-    pthread_mutex_lock(&mutex);
-    is_child_executing = new_state;
-    pthread_cond_signal(&cv);
-    pthread_mutex_unlock(&mutex);
-  }
-
-  SharedMemoryRegion::SharedMemoryRegion()
-  {
-    pthread_mutexattr_t mattrs;
-    pthread_mutexattr_init(&mattrs);
-    pthread_mutexattr_setpshared(&mattrs, PTHREAD_PROCESS_SHARED);
-    pthread_mutex_init(&mutex, &mattrs);
-    pthread_condattr_t cvattrs;
-    pthread_condattr_init(&cvattrs);
-    pthread_condattr_setpshared(&cvattrs, PTHREAD_PROCESS_SHARED);
-    pthread_condattr_setclock(&cvattrs, CLOCK_MONOTONIC);
-    pthread_cond_init(&cv, &cvattrs);
   }
 
   void SharedMemoryRegion::destroy(size_t size)
   {
-    pthread_mutex_destroy(&mutex);
-    pthread_cond_destroy(&cv);
     munmap(static_cast<void*>(this), size);
   }
-#else
-#  error Missing implementation of SharedMemoryRegion
-#endif
 
 #ifdef __unix__
   SandboxedLibrary::~SandboxedLibrary()
@@ -891,9 +1353,16 @@ namespace sandbox
 #  endif
     shared_mem->destroy(shared_size);
     close(shm_fd);
+    close(pagemap_fd);
     close(socket_fd);
 #  ifdef USE_KQUEUE_PROCDESC
     close(kq);
+#  endif
+#  ifdef __linux__
+    if (child_pidfd >= 0)
+    {
+      close(child_pidfd);
+    }
 #  endif
   }
 
@@ -964,7 +1433,10 @@ namespace sandbox
     };
     // Move all of the file descriptors that we're going to use out of the
     // region that we're going to populate.
-    shm_fd = move_fd(shm_fd);
+    // Note: we copy the heap descriptor into a local rather than updating
+    // `shm_fd`.  If we were created with vfork, then we share the parent's
+    // memory and the parent still needs the original value.
+    int shm = move_fd(shm_fd);
     pagemap_mem = move_fd(pagemap_mem);
     fd_socket = move_fd(fd_socket);
     pagemap_pipe = move_fd(pagemap_pipe);
@@ -983,7 +1455,7 @@ namespace sandbox
       libdirfds.at(i) = move_fd(open(libdirs.at(i), O_DIRECTORY));
     }
     // The child process expects to find these in fixed locations.
-    shm_fd = dup2(shm_fd, SharedMemRegion);
+    shm = dup2(shm, SharedMemRegion);
     pagemap_mem = dup2(pagemap_mem, PageMapPage);
     fd_socket = dup2(fd_socket, FDSocket);
     assert(library);
@@ -1015,7 +1487,7 @@ namespace sandbox
     // The pagemap socket is used only to send pagemap updates to the parent
     limit_fd(pagemap_pipe, CAP_WRITE);
     // The shared heap can be mapped read-write, but can't be truncated.
-    limit_fd(shm_fd, CAP_MMAP_RW);
+    limit_fd(shm, CAP_MMAP_RW);
     limit_fd(pagemap_mem, CAP_MMAP_R);
     // The library must be parseable and mappable by rtld
     limit_fd(library, CAP_READ, CAP_FSTAT, CAP_SEEK, CAP_MMAP_RX);
@@ -1031,23 +1503,26 @@ namespace sandbox
     closefrom(last_fd);
     // Prepare the arguments to main.  These are going to be the binary name,
     // the address of the shared memory region, the length of the shared
-    // memory region, and a null terminator.  We have to pass the two
-    // addresses as strings because the kernel will assume that all arguments
-    // to main are null-terminated strings and will copy them into the
-    // process initialisation structure.
+    // memory region, the number of worker threads, and a null terminator.  We
+    // have to pass the two addresses as strings because the kernel will assume
+    // that all arguments to main are null-terminated strings and will copy
+    // them into the process initialisation structure.
     // Note that we create these strings on the stack, rather than calling
     // asprintf, because (if we used vfork) we're still in the same address
     // space as the parent, so if we allocate memory here then it will leak in
     // the parent.
-    char* args[4];
+    char* args[5];
     args[0] = (char*)"library_runner";
     char address[24];
     char length[24];
+    char workers[24];
     snprintf(address, sizeof(address), "%zd", (size_t)sharedmem_addr);
     args[1] = address;
     snprintf(length, sizeof(length), "%zd", shared_size);
     args[2] = length;
-    args[3] = 0;
+    snprintf(workers, sizeof(workers), "%zd", worker_threads);
+    args[3] = workers;
+    args[4] = 0;
     static_assert(
       OtherLibraries == 8, "First entry in LD_LIBRARY_PATH_FDS is incorrect");
     static_assert(
@@ -1060,15 +1535,18 @@ namespace sandbox
     _exit(EXIT_FAILURE);
   }
 
-  SandboxedLibrary::SandboxedLibrary(const char* library_name, size_t size)
-  : shared_size(1024ULL * 1024ULL * 1024ULL * size)
+  namespace
   {
+    /**
+     * Create an anonymous shared memory object.  The `debug_name` is used
+     * only on platforms that support naming anonymous memory objects.
+     */
+    int mk_shm(const char* debug_name)
+    {
 #  ifdef __FreeBSD__
-    auto mk_shm = [](const char*) {
+      (void)debug_name;
       return shm_open(SHM_ANON, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
-    };
 #  elif defined(__linux__)
-    auto mk_shm = [](const char* debug_name) {
       int ret = memfd_create(debug_name, 0);
       // WSL doesn't support memfd, so do something ugly with temp files.
       if (ret == -1)
@@ -1079,10 +1557,16 @@ namespace sandbox
         assert(ret != -1);
       }
       return ret;
-    };
 #  else
 #    error Anonymous shared memory not implemented for your platform
 #  endif
+    }
+  }
+
+  SandboxedLibrary::SandboxedLibrary(
+    const char* library_name, size_t size, size_t workers, bool parked)
+  : shared_size(1024ULL * 1024ULL * 1024ULL * size), worker_threads(workers)
+  {
     shm_fd = mk_shm("sandbox");
     // Set the size of the shared memory region.
     ftruncate(shm_fd, shared_size);
@@ -1104,32 +1588,10 @@ namespace sandbox
     // Create a single page for the shared pagemap page.  The parent process
     // will write to this directly, the child will send messages through a pipe
     // to ask the parent to update it, but will read it directly.
-    int pagemap_fd = mk_shm("pagemap");
+    pagemap_fd = mk_shm("pagemap");
     ftruncate(pagemap_fd, snmalloc::OS_PAGE_SIZE);
 
-    // Allocate the shared memory region and set its memory provider to use all
-    // of the space after the end of the header for subsequent allocations.
-    shared_mem = new (ptr) SharedMemoryRegion();
-    shared_mem->memory_provider.set_range(
-      reinterpret_cast<uintptr_t>(ptr) + sizeof(SharedMemoryRegion),
-      reinterpret_cast<uintptr_t>(ptr) + shared_size);
-
-    // Create a pair of sockets that we can use to
-    int pagemap_pipes[2];
-    // socketpair(AF_UNIX, SOCK_STREAM, 0, pagemap_pipes);
-    pipe(pagemap_pipes);
-    uint8_t* shared_pagemap_page = pagemap_owner().add_range(
-      reinterpret_cast<size_t>(ptr),
-      reinterpret_cast<size_t>(ptr) + shared_size,
-      pagemap_pipes[0],
-      pagemap_fd);
-    // Construct a UNIX domain socket.  This will eventually be used to send
-    // file descriptors from the parent to the child, but isn't yet.
-    int socks[2];
-    socketpair(AF_UNIX, SOCK_STREAM, 0, socks);
-    int pid;
     std::string path = ".";
-    std::string lib;
     // Use dladdr to find the path of the libsandbox shared library.  For now,
     // we assume that the library runner is in the same place and so is the
     // library that we're going to open.  Eventually we should look for
@@ -1145,17 +1607,49 @@ namespace sandbox
     }
     if (library_name[0] == '/')
     {
-      lib = library_name;
+      library_path = library_name;
     }
     else
     {
-      lib = path;
-      lib += '/';
-      lib += library_name;
+      library_path = path;
+      library_path += '/';
+      library_path += library_name;
     }
-    library_name = lib.c_str();
-    path += "/library_runner";
-    const char* librunnerpath = path.c_str();
+    runner_path = path + "/library_runner";
+
+    spawn_child(ptr);
+    if (!parked)
+    {
+      start();
+    }
+  }
+
+  void SandboxedLibrary::spawn_child(void* ptr)
+  {
+    // Allocate the shared memory region and set its memory provider to use all
+    // of the space after the end of the header for subsequent allocations.
+    shared_mem = new (ptr) SharedMemoryRegion();
+    shared_mem->memory_provider.set_range(
+      reinterpret_cast<uintptr_t>(ptr) + sizeof(SharedMemoryRegion),
+      reinterpret_cast<uintptr_t>(ptr) + shared_size);
+
+    // Create a pair of sockets that we can use to
+    int pagemap_pipes[2];
+    // socketpair(AF_UNIX, SOCK_STREAM, 0, pagemap_pipes);
+    pipe(pagemap_pipes);
+    uint8_t* shared_pagemap_page = pagemap_owner().add_range(
+      reinterpret_cast<size_t>(ptr),
+      reinterpret_cast<size_t>(ptr) + shared_size,
+      pagemap_pipes[0],
+      pagemap_fd,
+      &shared_mem->pagemap_updates_applied);
+    // Construct a UNIX domain socket.  This will eventually be used to send
+    // file descriptors from the parent to the child, but isn't yet.
+    int socks[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, socks);
+    int pid;
+    const char* library_name = library_path.c_str();
+    const char* librunnerpath = runner_path.c_str();
     // We shouldn't do anything that modifies the heap (or reads the heap in
     // a way that is not concurrency safe) between vfork and exec.
     child_proc = -1;
@@ -1188,11 +1682,16 @@ namespace sandbox
     {
       err(1, "Setting up kqueue");
     }
+#  endif
+#  if defined(__linux__) && defined(SYS_pidfd_open)
+    // Grab a process descriptor for the child so that we can cheaply check
+    // whether it has exited while waiting for a call to return.  This fails
+    // on kernels older than 5.3, in which case we fall back to `waitpid`.
+    child_pidfd = static_cast<int>(syscall(SYS_pidfd_open, child_proc, 0));
 #  endif
     // Close all of the file descriptors that only the child should have.
     close(socks[1]);
     close(pagemap_pipes[1]);
-    close(pagemap_fd);
     socket_fd = socks[0];
     // Allocate an allocator in the shared memory region.
     allocator = new SharedAlloc(
@@ -1201,17 +1700,95 @@ namespace sandbox
       SharedPagemapAdaptor(shared_pagemap_page),
       &shared_mem->allocator_state);
   }
-  void SandboxedLibrary::send(int idx, void* ptr)
+
+  void SandboxedLibrary::start()
+  {
+    shared_mem->library_start.store(1);
+  }
+
+  void SandboxedLibrary::reset()
+  {
+    // FIXME: A child that ignores the exit request will block us here.  We
+    // should escalate to killing it.
+    wait_for_child_exit();
+    // Updates sent by the old child may still be queued.  Make sure that they
+    // aren't applied after we've reset the pagemap.
+    pagemap_owner().remove_range(reinterpret_cast<size_t>(shared_mem));
+    close(socket_fd);
+#  ifdef USE_KQUEUE_PROCDESC
+    close(kq);
+    close(child_proc);
+#  endif
+#  ifdef __linux__
+    if (child_pidfd >= 0)
+    {
+      close(child_pidfd);
+      child_pidfd = -1;
+    }
+#  endif
+    // The allocator's state describes the heap that we're about to discard.
+    delete allocator;
+    allocator = nullptr;
+    // Remove the old heap's entries from our pagemap.  The child's copy is
+    // cleared when we truncate the pagemap page below.
+    snmalloc::ChunkmapPagemap& cpm =
+      snmalloc::ExternalGlobalPagemap::pagemap();
+    auto base = reinterpret_cast<uintptr_t>(shared_mem);
+    for (size_t offset = 0; offset < shared_size;
+         offset += snmalloc::SUPERSLAB_SIZE)
+    {
+      cpm.set(base + offset, snmalloc::CMNotOurs);
+    }
+    // Truncating the shared memory objects discards all of their pages and
+    // extending them again gives zero-filled pages.  Our mapping of the heap
+    // stays valid throughout, and nothing that the previous child wrote is
+    // visible to the next one.
+    ftruncate(shm_fd, 0);
+    ftruncate(shm_fd, shared_size);
+    ftruncate(pagemap_fd, 0);
+    ftruncate(pagemap_fd, snmalloc::OS_PAGE_SIZE);
+    child_exited = false;
+    calls_enqueued = 0;
+    last_vtable_entry = 1;
+    spawn_child(static_cast<void*>(shared_mem));
+  }
+
+  uint32_t SandboxedLibrary::enqueue(int idx, void* ptr)
   {
-    shared_mem->function_index = idx;
-    shared_mem->msg_buffer = ptr;
-    shared_mem->signal(true);
-    // Wait for a second, see if the child has exited, if it's still going, try
-    // again.
+    std::lock_guard g(enqueue_lock);
+    uint32_t call = calls_enqueued.load(std::memory_order_relaxed);
+    // The slot that we're about to use was last used by the call
+    // `call_ring_size` before this one, so wait for that to finish.
+    wait_for_call(call - SharedMemoryRegion::call_ring_size);
+    CallDescriptor& slot =
+      shared_mem->calls[call % SharedMemoryRegion::call_ring_size];
+    slot.function_index = idx;
+    slot.msg_buffer = ptr;
+    calls_enqueued.store(call + 1);
+    shared_mem->calls_enqueued.store(call + 1);
+    return call;
+  }
+  bool SandboxedLibrary::is_call_complete(uint32_t call)
+  {
+    // The sequence numbers are free running and so may wrap.  A call is
+    // complete if its slot records the completion of this call or of a later
+    // call that reused the slot.
+    uint32_t completed =
+      shared_mem->calls[call % SharedMemoryRegion::call_ring_size]
+        .completed_call.load(std::memory_order_acquire);
+    return static_cast<int32_t>(completed - (call + 1)) >= 0;
+  }
+  void SandboxedLibrary::wait_for_call(uint32_t call)
+  {
+    auto is_complete = [&](uint32_t) { return is_call_complete(call); };
+    // Spin briefly and then sleep on the doorbell.  We can't wait for a futex
+    // and a process descriptor in the same system call, so the sleep is
+    // bounded and we check whether the child has died each time it expires.
     // FIXME: We should probably allow the user to specify a maxmimum execution
     // time for all calls and kill the sandbox and raise an exception if it's
     // taking too long.
-    while (!shared_mem->wait(false, {0, 100000}))
+    struct timespec timeout = {0, 1000000};
+    while (!shared_mem->calls_completed.wait(is_complete, &timeout))
     {
       if (has_child_exited())
       {
@@ -1219,6 +1796,36 @@ namespace sandbox
       }
     }
   }
+  void SandboxedLibrary::send(int idx, void* ptr)
+  {
+    wait_for_call(enqueue(idx, ptr));
+  }
+  void SandboxedLibrary::wait_for_all_calls()
+  {
+    // Calls may complete out of order, so we must check each one.
+    for (uint32_t i = SharedMemoryRegion::call_ring_size; i > 0; i--)
+    {
+      wait_for_call(calls_enqueued - i);
+    }
+  }
+
+  uint64_t SandboxedLibrary::pagemap_updates_processed()
+  {
+    return shared_mem->pagemap_updates_applied.load(std::memory_order_relaxed);
+  }
+
+  size_t SandboxedLibrary::heap_resident_bytes()
+  {
+    // The shared memory object is created with its full size but pages are
+    // allocated lazily, so the number of allocated blocks is the amount of
+    // memory that the heap is using, regardless of which process touched it.
+    struct stat sb;
+    if (fstat(shm_fd, &sb) != 0)
+    {
+      return 0;
+    }
+    return static_cast<size_t>(sb.st_blocks) * 512;
+  }
 #  ifndef USE_KQUEUE_PROCDESC
   namespace
   {
@@ -1241,7 +1848,6 @@ namespace sandbox
 #  ifdef USE_KQUEUE_PROCDESC
     // If we're using kqueue and process descriptors then we
     struct kevent event;
-    shared_mem->signal(true);
     struct timespec timeout = {0, 0};
     int ret = kevent(kq, nullptr, 0, &event, 1, &timeout);
     if (ret == -1)
@@ -1255,6 +1861,19 @@ namespace sandbox
     }
     return (ret == 1);
 #  else
+#    ifdef __linux__
+    // If we have a process descriptor, it becomes readable when the child
+    // exits.  Checking it is cheaper than a `waitpid` call that usually finds
+    // nothing, so only reap the child once the descriptor says that it's gone.
+    if (child_pidfd >= 0)
+    {
+      struct pollfd pfd = {child_pidfd, POLLIN, 0};
+      if (::poll(&pfd, 1, 0) == 0)
+      {
+        return false;
+      }
+    }
+#    endif
     auto [ret, status] = waitpid(child_proc, WEXITED | WNOHANG);
     if (ret == -1)
     {
@@ -1275,8 +1894,12 @@ namespace sandbox
     {
       return child_status;
     }
+    // Ring the child's doorbell without enqueuing a call.  The child checks
+    // `should_exit` whenever the counter changes.
     shared_mem->should_exit = true;
-    shared_mem->signal(true);
+    shared_mem->calls_enqueued.store(calls_enqueued + 1);
+    // The child may still be parked, waiting to load the library.
+    shared_mem->library_start.store(1);
 #  ifdef USE_KQUEUE_PROCDESC
     struct kevent event;
     // FIXME: Timeout and increase the aggression with which we kill the child
@@ -1323,4 +1946,56 @@ namespace sandbox
   {
     allocator->dealloc(ptr);
   }
+
+  SandboxPool::SandboxPool(
+    const char* name, size_t count, size_t heap_size_in_GiBs, size_t workers)
+  : library_name(name), heap_size(heap_size_in_GiBs), worker_threads(workers)
+  {
+    fill(count);
+  }
+
+  void SandboxPool::fill(size_t count)
+  {
+    while (size() < count)
+    {
+      // Create the sandbox without holding the lock, this is the slow part.
+      auto lib = std::make_unique<SandboxedLibrary>(
+        library_name.c_str(), heap_size, worker_threads, true);
+      std::lock_guard g(lock);
+      parked.push_back(std::move(lib));
+    }
+  }
+
+  std::unique_ptr<SandboxedLibrary> SandboxPool::acquire()
+  {
+    std::unique_ptr<SandboxedLibrary> lib;
+    {
+      std::lock_guard g(lock);
+      if (!parked.empty())
+      {
+        lib = std::move(parked.back());
+        parked.pop_back();
+      }
+    }
+    if (!lib)
+    {
+      lib = std::make_unique<SandboxedLibrary>(
+        library_name.c_str(), heap_size, worker_threads, true);
+    }
+    lib->start();
+    return lib;
+  }
+
+  void SandboxPool::release(std::unique_ptr<SandboxedLibrary> lib)
+  {
+    lib->reset();
+    std::lock_guard g(lock);
+    parked.push_back(std::move(lib));
+  }
+
+  size_t SandboxPool::size()
+  {
+    std::lock_guard g(lock);
+    return parked.size();
+  }
 }
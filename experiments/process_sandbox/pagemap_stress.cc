@@ -0,0 +1,78 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include "bench_sandbox.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+using namespace sandbox;
+
+/**
+ * Stress test for the pagemap update thread.  Creates many sandboxes, each
+ * driven by its own thread, all of which allocate heavily at the same time and
+ * so send a constant stream of pagemap updates to the parent.
+ *
+ * Usage: pagemap_stress [sandboxes] [calls per sandbox] [rounds per call]
+ */
+int main(int argc, char** argv)
+{
+  auto arg = [&](int i, size_t dflt) {
+    return std::max<size_t>(
+      argc > i ? strtoull(argv[i], nullptr, 0) : dflt, 1);
+  };
+  size_t sandbox_count = arg(1, 64);
+  size_t calls = arg(2, 8);
+  int rounds = static_cast<int>(arg(3, 16));
+  std::atomic<size_t> failures = 0;
+  std::atomic<size_t> allocations = 0;
+  std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < sandbox_count; i++)
+  {
+    threads.emplace_back([&]() {
+      try
+      {
+        BenchSandbox sandbox;
+        for (size_t j = 0; j < calls; j++)
+        {
+          int result = sandbox.alloc_churn(rounds);
+          if (result <= 0)
+          {
+            failures++;
+          }
+          allocations += static_cast<size_t>(result);
+        }
+      }
+      catch (std::runtime_error& e)
+      {
+        fprintf(stderr, "Sandbox exception: %s\n", e.what());
+        failures++;
+      }
+    });
+  }
+  for (auto& t : threads)
+  {
+    t.join();
+  }
+  double seconds = std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+  printf(
+    "%zu sandboxes, %zu allocations in %.2f s (%.0f allocations/s)\n",
+    sandbox_count,
+    allocations.load(),
+    seconds,
+    allocations.load() / seconds);
+  if (failures != 0)
+  {
+    printf("%zu failures\n", failures.load());
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,115 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include "bench_sandbox.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+using namespace sandbox;
+
+namespace
+{
+  using clock = std::chrono::steady_clock;
+
+  /**
+   * Print the mean and median of a set of samples, in microseconds.
+   */
+  void report(const char* name, std::vector<double>& samples)
+  {
+    std::sort(samples.begin(), samples.end());
+    double total = 0;
+    for (double s : samples)
+    {
+      total += s;
+    }
+    printf(
+      "%-30s mean: %10.1f us   median: %10.1f us\n",
+      name,
+      total / samples.size(),
+      samples.at(samples.size() / 2));
+  }
+
+  /**
+   * Returns the time, in microseconds, since `start`.
+   */
+  double microseconds_since(clock::time_point start)
+  {
+    return std::chrono::duration<double, std::micro>(clock::now() - start)
+      .count();
+  }
+
+  /**
+   * Make the first call into a sandbox, so that each measurement includes
+   * loading the library and completing a round trip.
+   */
+  void first_call(SandboxedLibrary& lib)
+  {
+    BenchSandbox bench(lib);
+    if (bench.add(1, 2) != 3)
+    {
+      fprintf(stderr, "Incorrect result from sandbox\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  size_t iterations =
+    std::max<size_t>(argc > 1 ? strtoull(argv[1], nullptr, 0) : 20, 1);
+  const char* library = "example_lib.so";
+  std::vector<double> samples;
+
+  // Cold start: create the shared memory, spawn the child, load the library.
+  for (size_t i = 0; i < iterations; i++)
+  {
+    auto start = clock::now();
+    auto lib = std::make_unique<SandboxedLibrary>(library);
+    first_call(*lib);
+    samples.push_back(microseconds_since(start));
+  }
+  report("Cold start", samples);
+
+  // Pooled start: take a parked sandbox and load the library.
+  samples.clear();
+  SandboxPool pool(library, iterations);
+  std::vector<std::unique_ptr<SandboxedLibrary>> in_use;
+  for (size_t i = 0; i < iterations; i++)
+  {
+    auto start = clock::now();
+    auto lib = pool.acquire();
+    first_call(*lib);
+    samples.push_back(microseconds_since(start));
+    in_use.push_back(std::move(lib));
+  }
+  report("Pooled start", samples);
+
+  // Return the sandboxes to the pool.  This is off the critical path for a
+  // consumer of the pool, but we report it anyway.
+  samples.clear();
+  for (auto& lib : in_use)
+  {
+    auto start = clock::now();
+    pool.release(std::move(lib));
+    samples.push_back(microseconds_since(start));
+  }
+  in_use.clear();
+  report("Reset (release to pool)", samples);
+
+  // Recycled start: take a sandbox that has been used and reset.
+  samples.clear();
+  for (size_t i = 0; i < iterations; i++)
+  {
+    auto start = clock::now();
+    auto lib = pool.acquire();
+    first_call(*lib);
+    samples.push_back(microseconds_since(start));
+    in_use.push_back(std::move(lib));
+  }
+  report("Recycled start", samples);
+  return 0;
+}
@@ -0,0 +1,71 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include "bench_sandbox.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+
+using namespace sandbox;
+
+/**
+ * Report the amount of memory backing a sandbox's heap over time, while the
+ * sandbox repeatedly allocates and frees large amounts of memory and while it
+ * is idle between bursts.  Without decommit, the resident size only grows.
+ *
+ * Usage: reclaim_bench [bursts] [rounds per burst]
+ */
+int main(int argc, char** argv)
+{
+  using clock = std::chrono::steady_clock;
+  auto arg = [&](int i, size_t dflt) {
+    return std::max<size_t>(
+      argc > i ? strtoull(argv[i], nullptr, 0) : dflt, 1);
+  };
+  size_t bursts = arg(1, 8);
+  int rounds = static_cast<int>(arg(2, 4));
+  static const auto interval = std::chrono::milliseconds(10);
+  // We call only `fill_churn`, which allocates, writes to, and frees objects
+  // from 4 KiB to 16 MiB.
+  BenchSandbox sandbox;
+  auto begin = clock::now();
+  size_t peak = 0;
+  auto sample = [&](const char* phase) {
+    size_t resident = sandbox.lib.heap_resident_bytes();
+    peak = std::max(peak, resident);
+    printf(
+      "%8.0f, %-5s, %8.1f\n",
+      std::chrono::duration<double, std::milli>(clock::now() - begin).count(),
+      phase,
+      static_cast<double>(resident) / (1024 * 1024));
+  };
+  printf("Time (ms), phase, heap resident (MiB)\n");
+  for (size_t i = 0; i < bursts; i++)
+  {
+    auto result = sandbox.fill_churn.async(rounds);
+    while (!result.is_ready())
+    {
+      sample("busy");
+      std::this_thread::sleep_for(interval);
+    }
+    if (result.get() <= 0)
+    {
+      fprintf(stderr, "Sandbox failed to allocate any memory\n");
+      return EXIT_FAILURE;
+    }
+    for (int j = 0; j < 5; j++)
+    {
+      sample("idle");
+      std::this_thread::sleep_for(interval);
+    }
+  }
+  size_t final_resident = sandbox.lib.heap_resident_bytes();
+  printf(
+    "Peak: %.1f MiB, after last burst: %.1f MiB\n",
+    static_cast<double>(peak) / (1024 * 1024),
+    static_cast<double>(final_resident) / (1024 * 1024));
+  return 0;
+}
@@ -0,0 +1,90 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include "bench_sandbox.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+using namespace sandbox;
+
+int main(int argc, char** argv)
+{
+  using clock = std::chrono::steady_clock;
+  size_t iterations =
+    std::max<size_t>(argc > 1 ? strtoull(argv[1], nullptr, 0) : 100000, 1);
+  static const size_t warmup = 1000;
+  // We call only `add`, which is `sum` without the logging, so that the time
+  // measured is dominated by the cost of the call into the sandbox.
+  BenchSandbox sandbox;
+  for (size_t i = 0; i < warmup; i++)
+  {
+    sandbox.add(static_cast<int>(i), 1);
+  }
+  std::vector<uint64_t> samples;
+  samples.reserve(iterations);
+  auto begin = clock::now();
+  for (size_t i = 0; i < iterations; i++)
+  {
+    auto start = clock::now();
+    int result = sandbox.add(static_cast<int>(i), 1);
+    auto end = clock::now();
+    if (result != static_cast<int>(i) + 1)
+    {
+      fprintf(stderr, "Incorrect result from sandbox: %d\n", result);
+      return EXIT_FAILURE;
+    }
+    samples.push_back(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+        .count());
+  }
+  auto total = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 clock::now() - begin)
+                 .count();
+  std::sort(samples.begin(), samples.end());
+  auto percentile = [&](double p) {
+    return samples.at(
+      std::min(samples.size() - 1, static_cast<size_t>(samples.size() * p)));
+  };
+  printf("Round trips: %zu\n", iterations);
+  printf("Mean:   %8.0f ns\n", static_cast<double>(total) / iterations);
+  printf("Min:    %8lu ns\n", static_cast<unsigned long>(samples.front()));
+  printf("p50:    %8lu ns\n", static_cast<unsigned long>(percentile(0.5)));
+  printf("p99:    %8lu ns\n", static_cast<unsigned long>(percentile(0.99)));
+  printf("p99.9:  %8lu ns\n", static_cast<unsigned long>(percentile(0.999)));
+  printf("Max:    %8lu ns\n", static_cast<unsigned long>(samples.back()));
+
+  // Measure throughput of asynchronous calls, issuing a batch of calls and
+  // then waiting for all of their results.
+  printf("\nBatch size, calls/s\n");
+  std::vector<SandboxedFuture<int>> futures;
+  futures.reserve(1024);
+  for (size_t batch = 1; batch <= 1024; batch *= 2)
+  {
+    size_t batches = std::max<size_t>(iterations / batch, 1);
+    auto start = clock::now();
+    for (size_t i = 0; i < batches; i++)
+    {
+      for (size_t j = 0; j < batch; j++)
+      {
+        futures.push_back(sandbox.add.async(static_cast<int>(j), 1));
+      }
+      for (size_t j = 0; j < batch; j++)
+      {
+        if (futures[j].get() != static_cast<int>(j) + 1)
+        {
+          fprintf(stderr, "Incorrect result from sandbox\n");
+          return EXIT_FAILURE;
+        }
+      }
+      futures.clear();
+    }
+    double seconds =
+      std::chrono::duration<double>(clock::now() - start).count();
+    printf("%10zu, %.0f\n", batch, (batches * batch) / seconds);
+  }
+  return 0;
+}
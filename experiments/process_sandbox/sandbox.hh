@@ -2,8 +2,13 @@
 // SPDX-License-Identifier: MIT
 
 #include <assert.h>
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
 #include <string.h>
+#include <string>
 #include <tuple>
 #include <vector>
 #ifdef __unix__
@@ -46,6 +51,10 @@ namespace sandbox
   struct SharedMemoryRegion;
   struct SharedPagemapAdaptor;
   struct MemoryProviderBumpPointerState;
+  template<typename Ret>
+  class SandboxedFuture;
+  template<typename T>
+  class SharedBuffer;
   /**
    * Class encapsulating an instance of a shared library in a sandbox.
    * Instances of this class will create a sandbox and load a specified library
@@ -115,6 +124,12 @@ namespace sandbox
      * process's heap.
      */
     handle_t shm_fd;
+    /**
+     * The handle to the shared memory object that holds the child's view of
+     * the pagemap for the shared heap.  This is kept open so that the page
+     * can be cleared and mapped again if the sandbox is reset.
+     */
+    handle_t pagemap_fd;
     /**
      * The handle to the socket that is used to pass file descriptors to the
      * sandboxed process.
@@ -130,6 +145,14 @@ namespace sandbox
      * The queue used to watch for child exit.
      */
     int kq;
+#endif
+#ifdef __linux__
+    /**
+     * A process descriptor (pidfd) for the child, used to detect child exit
+     * while waiting for a call to complete.  This is -1 if the kernel does not
+     * support `pidfd_open`.
+     */
+    handle_t child_pidfd = -1;
 #endif
     /**
      * A pointer to the shared-memory region.  The start of this is structured,
@@ -160,6 +183,34 @@ namespace sandbox
      * The size of the shared-memory region.
      */
     size_t shared_size;
+    /**
+     * The number of worker threads that the child process runs to execute
+     * calls.
+     */
+    size_t worker_threads;
+    /**
+     * The full path of the library to load in the child.
+     */
+    std::string library_path;
+    /**
+     * The full path of the `library_runner` binary.
+     */
+    std::string runner_path;
+    /**
+     * The number of calls that have been placed in the call ring.  The copy of
+     * this counter in the shared region is used to wake the child, this copy
+     * is the trusted one used by the parent.  It is only advanced with
+     * `enqueue_lock` held, but may be read without it.
+     */
+    std::atomic<uint32_t> calls_enqueued = 0;
+    /**
+     * Lock held while claiming a slot in the call ring and publishing the call
+     * in it.  Several threads in the parent may call into the same sandbox.
+     * The child runs calls in the order in which their slots were claimed, so
+     * each call must be written to its slot before any later call is
+     * published.
+     */
+    std::mutex enqueue_lock;
     /**
      * Allocate some memory in the sandbox.  Returns `nullptr` if the
      * allocation failed.
@@ -200,6 +251,13 @@ namespace sandbox
       int pagemap_mem,
       int pagemap_pipe,
       int fd_socket);
+    /**
+     * Initialise the shared memory region at `base` and create a new child
+     * process that uses it.  The child sets up its heap and then waits for
+     * `start` to be called before loading the library.  This is used both
+     * when the sandbox is created and when it is reset.
+     */
+    void spawn_child(void* base);
 
   public:
     /**
@@ -220,8 +278,36 @@ namespace sandbox
     /**
      * Constructor.  Creates a new sandboxed instance of the library named by
      * `library_name`, with the heap size specified in GiBs.
+     *
+     * The child runs `worker_threads` threads, which take calls from a shared
+     * queue.  Using more than one is safe only if the library's exported
+     * functions are safe to call concurrently.  Calls issued with
+     * `SandboxedFunction::async` may then complete out of order.
+     */
+    SandboxedLibrary(
+      const char* library_name,
+      size_t heap_size_in_GiBs = 1,
+      size_t worker_threads = 1,
+      bool parked = false);
+    /**
+     * Allow a child that was created with `parked` set to true to load the
+     * library and start accepting calls.  Until this is called, the child has
+     * not run any code from the library and so the sandbox can be handed to
+     * any consumer of the library.  Calling this more than once has no effect.
+     */
+    void start();
+    /**
+     * Reset the sandbox.  This terminates the child, discards every page of
+     * the shared heap (so that nothing written by the previous child is
+     * visible to the next), and creates a new, parked, child that uses the
+     * same shared memory objects.  This is cheaper than creating a new
+     * sandbox because it reuses the address-space reservation, the shared
+     * memory objects, and the resolved library paths.
+     *
+     * All pointers into the sandbox and all `SandboxedFunction` objects that
+     * refer to it are invalid after this call.
      */
-    SandboxedLibrary(const char* library_name, size_t heap_size_in_GiBs = 1);
+    void reset();
     /**
      * Allocate space for an array of `count` instances of `T`.  Objects in the
      * array will be default constructed.
@@ -299,6 +385,41 @@ namespace sandbox
       memcpy(ptr, str, len);
       return ptr;
     }
+    /**
+     * Allocate a buffer of `count` instances of `T` in the sandbox.  The
+     * returned handle owns the buffer and frees it when it is destroyed.  The
+     * buffer is visible to the child at the same address, so passing it to a
+     * sandboxed function does not copy its contents.  Throws `std::bad_alloc`
+     * if the sandbox heap is exhausted.
+     */
+    template<typename T>
+    SharedBuffer<T> alloc_buffer(size_t count)
+    {
+      void* ptr = alloc_in_sandbox(sizeof(T), count);
+      if (ptr == nullptr)
+      {
+        throw std::bad_alloc();
+      }
+      return SharedBuffer<T>(*this, static_cast<T*>(ptr), count);
+    }
+    /**
+     * Block until every call that has been issued to this sandbox, including
+     * asynchronous ones, has completed.
+     */
+    void wait_for_all_calls();
+    /**
+     * Returns the number of pagemap update requests from the child that the
+     * parent has processed.  This is read from memory that the child can
+     * modify and so is useful only for diagnostics.
+     */
+    uint64_t pagemap_updates_processed();
+    /**
+     * Returns the number of bytes of the shared heap that are currently backed
+     * by memory.  Memory that has been freed and discarded by the allocators
+     * in either process is not counted.  Returns 0 if this cannot be
+     * determined.
+     */
+    size_t heap_resident_bytes();
 
   private:
     /**
@@ -307,9 +428,35 @@ namespace sandbox
     template<typename Ret, typename... Args>
     friend class SandboxedFunction;
     /**
-     * Sends a message to the child process, containing a vtable index and a
-     * pointer to the argument frame (a tuple of arguments and space for the
-     * return value).
+     * SandboxedFuture is allowed to wait for calls to complete.
+     */
+    template<typename Ret>
+    friend class SandboxedFuture;
+    /**
+     * Shared buffers are allowed to wait for the calls that use them.
+     */
+    friend class SharedBufferBase;
+    /**
+     * Places a call in the ring shared with the child process, containing a
+     * vtable index and a pointer to the argument frame (a tuple of arguments
+     * and space for the return value).  Returns the sequence number of the
+     * call, which can be passed to `wait_for_call`.  If the ring is full, this
+     * blocks until the child has completed enough calls to make space.
+     */
+    uint32_t enqueue(int idx, void* ptr);
+    /**
+     * Returns true if the call with the specified sequence number has
+     * completed.
+     */
+    bool is_call_complete(uint32_t call);
+    /**
+     * Block until the call with the specified sequence number has completed.
+     * Throws an exception if the child exits before it completes.
+     */
+    void wait_for_call(uint32_t call);
+    /**
+     * Sends a message to the child process and waits for the reply.  This is
+     * equivalent to `enqueue` followed by `wait_for_call`.
      */
     void send(int idx, void* ptr);
     /**
@@ -326,6 +473,381 @@ namespace sandbox
     bool has_child_exited();
   };
 
+  /**
+   * A pool of sandboxes for a single library, each with a child process that
+   * has been created and has set up its heap, but that has not yet loaded
+   * the library.  No untrusted code has run in a pooled sandbox, so it can be
+   * handed to any consumer.  Handing out a pooled sandbox avoids the cost of
+   * creating the shared memory objects, mapping them, and spawning the child.
+   *
+   * All methods on this class are thread safe.
+   */
+  class SandboxPool
+  {
+    /**
+     * The name of the library that sandboxes in this pool load.
+     */
+    std::string library_name;
+    /**
+     * The heap size, in GiBs, of each sandbox.
+     */
+    size_t heap_size;
+    /**
+     * The number of worker threads in each sandbox.
+     */
+    size_t worker_threads;
+    /**
+     * Lock protecting `parked`.
+     */
+    std::mutex lock;
+    /**
+     * Sandboxes that are ready to be handed out.
+     */
+    std::vector<std::unique_ptr<SandboxedLibrary>> parked;
+
+  public:
+    /**
+     * Constructor.  Creates `count` parked sandboxes for the library named by
+     * `library_name`.  The remaining arguments are passed to the
+     * `SandboxedLibrary` constructor.
+     */
+    SandboxPool(
+      const char* library_name,
+      size_t count,
+      size_t heap_size_in_GiBs = 1,
+      size_t worker_threads = 1);
+    /**
+     * Create parked sandboxes until the pool contains at least `count`.  This
+     * is the expensive part of sandbox creation, so callers should do it off
+     * their critical path.
+     */
+    void fill(size_t count);
+    /**
+     * Return a started sandbox.  This is taken from the pool if one is
+     * available, otherwise a new one is created.
+     */
+    std::unique_ptr<SandboxedLibrary> acquire();
+    /**
+     * Reset a sandbox that was returned by `acquire` and return it to the
+     * pool.  Any `SandboxedFunction` objects that refer to it must already
+     * have been destroyed.
+     */
+    void release(std::unique_ptr<SandboxedLibrary> lib);
+    /**
+     * Returns the number of sandboxes that are ready to be handed out.
+     */
+    size_t size();
+  };
+
+  /**
+   * State shared by all `SharedBuffer` instantiations: an allocation in a
+   * sandbox's heap and the most recent asynchronous call that was passed it.
+   *
+   * Ownership is enforced at the call boundary.  A buffer may be passed only
+   * to functions in the sandbox whose heap it was allocated in.  While an
+   * asynchronous call that was passed the buffer is in flight, the child owns
+   * the buffer: accessing it from the parent, or freeing it, blocks until the
+   * call has completed.
+   *
+   * Note that this protects the child from the parent, not the other way
+   * around.  The child can modify the buffer at any time and so the parent
+   * must treat its contents as untrusted.
+   */
+  class SharedBufferBase
+  {
+    /**
+     * Sandboxed functions record the calls that a buffer is passed to.
+     */
+    template<typename R, typename... A>
+    friend class SandboxedFunction;
+
+  protected:
+    /**
+     * The library whose heap contains this buffer.
+     */
+    SandboxedLibrary* lib;
+    /**
+     * The start of the buffer.
+     */
+    void* ptr;
+    /**
+     * The size of the buffer in bytes.
+     */
+    size_t bytes;
+    /**
+     * Flag indicating whether `pending_call` refers to a call that may not
+     * have completed.
+     */
+    mutable bool has_pending_call = false;
+    /**
+     * The sequence number of the most recent asynchronous call that was
+     * passed this buffer.
+     */
+    mutable uint32_t pending_call = 0;
+    /**
+     * Constructor, called only from `SharedBuffer`.
+     */
+    SharedBufferBase(SandboxedLibrary& l, void* p, size_t b)
+    : lib(&l), ptr(p), bytes(b)
+    {}
+    /**
+     * Destructor.  Waits for any call that is using the buffer and then frees
+     * it.
+     */
+    ~SharedBufferBase()
+    {
+      try
+      {
+        wait_for_pending_call();
+        lib->free(ptr);
+      }
+      catch (...)
+      {
+        // The child has gone away.  The buffer is leaked, but is reclaimed
+        // along with the rest of the sandbox's heap.
+      }
+    }
+    /**
+     * Block until the child is no longer using this buffer.  With more than
+     * one worker thread, calls can complete out of order and so completion of
+     * the most recent call does not imply completion of earlier ones; in that
+     * case, wait for every outstanding call.
+     */
+    void wait_for_pending_call() const
+    {
+      if (!has_pending_call)
+      {
+        return;
+      }
+      if (lib->worker_threads > 1)
+      {
+        lib->wait_for_all_calls();
+      }
+      else
+      {
+        lib->wait_for_call(pending_call);
+      }
+      has_pending_call = false;
+    }
+    /**
+     * Record that the call with sequence number `call` has been passed this
+     * buffer.
+     */
+    void set_pending_call(uint32_t call) const
+    {
+      has_pending_call = true;
+      pending_call = call;
+    }
+    /**
+     * Throw an exception unless this buffer can be passed to a function in
+     * `l`.
+     */
+    void check_passable_to(const SandboxedLibrary& l) const
+    {
+      if (&l != lib)
+      {
+        throw std::invalid_argument(
+          "Shared buffer passed to a function in a different sandbox");
+      }
+    }
+
+  public:
+    /**
+     * Buffers can be neither copied nor moved: exactly one of them is
+     * responsible for freeing the allocation, and spans borrowed from a
+     * buffer refer to it by address.
+     */
+    SharedBufferBase(const SharedBufferBase&) = delete;
+    SharedBufferBase& operator=(const SharedBufferBase&) = delete;
+  };
+
+  template<typename T>
+  class SandboxSpan;
+
+  /**
+   * An owning handle to an array of `T` in a sandbox's heap, created with
+   * `SandboxedLibrary::alloc_buffer`.  Sandboxed functions that take a `T*`
+   * (or `const T*`) can be passed a `SharedBuffer<T>` or a `SandboxSpan<T>`
+   * borrowed from one, and the child sees the data at the same address
+   * without any copying.  See `SharedBufferBase` for the ownership rules.
+   *
+   * As with the rest of the `SandboxedLibrary` interface, a buffer must be
+   * used only from the thread that issues calls to its sandbox.
+   */
+  template<typename T>
+  class SharedBuffer : public SharedBufferBase
+  {
+    static_assert(
+      std::is_trivially_copyable_v<T>,
+      "Shared buffers must contain trivially copyable types");
+    /**
+     * The library creates buffers.
+     */
+    friend class SandboxedLibrary;
+    /**
+     * Spans refer back to the buffer that owns them.
+     */
+    friend class SandboxSpan<T>;
+    /**
+     * Constructor, called only from `SandboxedLibrary::alloc_buffer`.
+     */
+    SharedBuffer(SandboxedLibrary& l, T* p, size_t count)
+    : SharedBufferBase(l, p, count * sizeof(T))
+    {}
+
+  public:
+    /**
+     * Returns a pointer to the start of the buffer, blocking until any
+     * in-flight call that was passed the buffer has completed.
+     */
+    T* data()
+    {
+      wait_for_pending_call();
+      return static_cast<T*>(ptr);
+    }
+    /**
+     * Returns the number of elements in the buffer.
+     */
+    size_t size() const
+    {
+      return bytes / sizeof(T);
+    }
+    /**
+     * Accesses an element of the buffer.  Blocks in the same way as `data`.
+     */
+    T& operator[](size_t i)
+    {
+      assert(i < size());
+      return data()[i];
+    }
+    /**
+     * Borrow `count` elements starting at `offset`.  The returned span is
+     * valid for as long as this buffer is.  Throws `std::out_of_range` if the
+     * span would extend past the end of the buffer.
+     */
+    SandboxSpan<T> span(size_t offset, size_t count)
+    {
+      if ((offset > size()) || (count > size() - offset))
+      {
+        throw std::out_of_range("Span extends past the end of shared buffer");
+      }
+      return SandboxSpan<T>(*this, static_cast<T*>(ptr) + offset, count);
+    }
+    /**
+     * Borrow the whole buffer.
+     */
+    SandboxSpan<T> span()
+    {
+      return span(0, size());
+    }
+    /**
+     * Returns the pointer that the child should see in place of this buffer,
+     * throwing an exception if it is not allowed to be passed to a function
+     * in `l`.
+     */
+    T* pointer_for(const SandboxedLibrary& l) const
+    {
+      check_passable_to(l);
+      return static_cast<T*>(ptr);
+    }
+    /**
+     * Returns the buffer that owns this allocation.
+     */
+    const SharedBufferBase& owner() const
+    {
+      return *this;
+    }
+  };
+
+  /**
+   * A non-owning view of part of a `SharedBuffer`.  Spans can be passed to
+   * sandboxed functions in place of `T*` arguments, in the same way as the
+   * buffer that they were borrowed from, so that a caller can hand different
+   * regions of one buffer to different calls.
+   */
+  template<typename T>
+  class SandboxSpan
+  {
+    /**
+     * Buffers create spans.
+     */
+    friend class SharedBuffer<T>;
+    /**
+     * The buffer that this is borrowed from.
+     */
+    const SharedBuffer<T>* buffer;
+    /**
+     * The start of the span.
+     */
+    T* start;
+    /**
+     * The number of elements in the span.
+     */
+    size_t count;
+    /**
+     * Constructor, called only from `SharedBuffer::span`.
+     */
+    SandboxSpan(const SharedBuffer<T>& b, T* s, size_t c)
+    : buffer(&b), start(s), count(c)
+    {}
+
+  public:
+    /**
+     * Returns a pointer to the start of the span, blocking until any
+     * in-flight call that was passed the owning buffer has completed.
+     */
+    T* data() const
+    {
+      buffer->wait_for_pending_call();
+      return start;
+    }
+    /**
+     * Returns the number of elements in the span.
+     */
+    size_t size() const
+    {
+      return count;
+    }
+    /**
+     * Returns the pointer that the child should see in place of this span,
+     * throwing an exception if it is not allowed to be passed to a function
+     * in `l`.
+     */
+    T* pointer_for(const SandboxedLibrary& l) const
+    {
+      buffer->check_passable_to(l);
+      return start;
+    }
+    /**
+     * Returns the buffer that owns this allocation.
+     */
+    const SharedBufferBase& owner() const
+    {
+      return *buffer;
+    }
+  };
+
+  namespace internal
+  {
+    /**
+     * Type trait that is true for handles to shared buffers, which are
+     * converted to pointers when passed to sandboxed functions.
+     */
+    template<typename T>
+    struct is_shared_buffer_handle : std::false_type
+    {};
+    template<typename T>
+    struct is_shared_buffer_handle<SharedBuffer<T>> : std::true_type
+    {};
+    template<typename T>
+    struct is_shared_buffer_handle<SandboxSpan<T>> : std::true_type
+    {};
+    template<typename T>
+    constexpr bool is_shared_buffer_handle_v =
+      is_shared_buffer_handle<std::remove_cv_t<std::remove_reference_t<T>>>::
+        value;
+  }
+
   /**
    * The argument frame for a sandboxed function.  This contains space for the
    * return value and the arguments.
@@ -346,6 +868,119 @@ namespace sandbox
     // turn references into pointers.
   };
 
+  /**
+   * The result of an asynchronous call into a sandbox.  This owns the argument
+   * frame of the call, which is freed once the result has been retrieved (or
+   * when the future is destroyed).
+   *
+   * Calls are started in the order that they were issued, but when the child
+   * runs more than one worker thread they may complete in any order, so a
+   * completed call says nothing about the calls issued before it.  Like the
+   * rest of the `SandboxedLibrary` interface, futures must be used only from
+   * the thread that issued the call.
+   */
+  template<typename Ret>
+  class SandboxedFuture
+  {
+    /**
+     * Sandboxed functions are the only things that can create futures.
+     */
+    template<typename R, typename... A>
+    friend class SandboxedFunction;
+    /**
+     * The type of the return value field in the argument frame.
+     */
+    using ret_field = std::conditional_t<std::is_void_v<Ret>, char, Ret>;
+    /**
+     * The library that this call was issued to.
+     */
+    SandboxedLibrary* lib;
+    /**
+     * The argument frame for the call, or null if the result has already been
+     * retrieved.
+     */
+    void* frame;
+    /**
+     * The location in the argument frame where the child will write the
+     * return value.
+     */
+    ret_field* ret;
+    /**
+     * The sequence number of the call in the library's call ring.
+     */
+    uint32_t call;
+    /**
+     * Constructor, called only from `SandboxedFunction::async`.
+     */
+    SandboxedFuture(SandboxedLibrary& l, void* f, ret_field* r, uint32_t c)
+    : lib(&l), frame(f), ret(r), call(c)
+    {}
+
+  public:
+    /**
+     * Futures are move-only: exactly one of them is responsible for freeing
+     * the argument frame.
+     */
+    SandboxedFuture(SandboxedFuture&& other)
+    : lib(other.lib), frame(other.frame), ret(other.ret), call(other.call)
+    {
+      other.frame = nullptr;
+    }
+    SandboxedFuture(const SandboxedFuture&) = delete;
+    SandboxedFuture& operator=(const SandboxedFuture&) = delete;
+    /**
+     * Destructor.  If the result has not been retrieved, waits for the call to
+     * complete so that the child is not still using the argument frame when
+     * it is freed.
+     */
+    ~SandboxedFuture()
+    {
+      if (frame == nullptr)
+      {
+        return;
+      }
+      try
+      {
+        lib->wait_for_call(call);
+        lib->free(frame);
+      }
+      catch (...)
+      {
+        // The child has gone away.  The frame is leaked, but is reclaimed
+        // along with the rest of the sandbox's heap.
+      }
+    }
+    /**
+     * Returns true if the call has completed and `get` will not block.
+     */
+    bool is_ready()
+    {
+      return (frame == nullptr) || lib->is_call_complete(call);
+    }
+    /**
+     * Wait for the call to complete and return its result.  This may be
+     * called only once.  Throws an exception if the child exits before the
+     * call completes.
+     */
+    Ret get()
+    {
+      assert(frame != nullptr);
+      lib->wait_for_call(call);
+      void* f = frame;
+      frame = nullptr;
+      if constexpr (!std::is_void_v<Ret>)
+      {
+        Ret r = *ret;
+        lib->free(f);
+        return r;
+      }
+      else
+      {
+        lib->free(f);
+      }
+    }
+  };
+
   /**
    * A wrapper for invoking a function exported from a sandbox.
    */
@@ -423,6 +1058,88 @@ namespace sandbox
         lib.free(callframe);
       }
     }
+    /**
+     * Asynchronous call.  Passes the arguments into the sandbox and signals it
+     * to invoke the method, but does not wait for it to complete.  The return
+     * value can be retrieved from the returned future.
+     *
+     * Any number of calls may be in flight at once.  The child's worker
+     * threads claim them in the order that they were issued, draining all
+     * pending calls each time that they wake.  With more than one worker,
+     * calls may complete out of order.
+     */
+    SandboxedFuture<Ret> async(Args... args)
+    {
+      argframe* callframe = lib.alloc<argframe>();
+      callframe->args = std::forward_as_tuple(args...);
+      uint32_t call = lib.enqueue(vtable_index, callframe);
+      return {lib, callframe, &callframe->ret, call};
+    }
+    /**
+     * Call operator for calls that pass `SharedBuffer` or `SandboxSpan`
+     * handles in place of pointer arguments.  Each handle is checked to refer
+     * to this sandbox and is replaced by the pointer that it wraps.  The
+     * buffers are not copied.
+     */
+    template<
+      typename... CallArgs,
+      typename = std::enable_if_t<
+        (sizeof...(CallArgs) == sizeof...(Args)) &&
+        (internal::is_shared_buffer_handle_v<CallArgs> || ...)>>
+    Ret operator()(CallArgs&&... args)
+    {
+      return (*this)(lower<Args>(std::forward<CallArgs>(args))...);
+    }
+    /**
+     * Asynchronous call that passes `SharedBuffer` or `SandboxSpan` handles in
+     * place of pointer arguments.  The child owns the buffers until the call
+     * completes: any access to them from the parent before then blocks.
+     */
+    template<
+      typename... CallArgs,
+      typename = std::enable_if_t<
+        (sizeof...(CallArgs) == sizeof...(Args)) &&
+        (internal::is_shared_buffer_handle_v<CallArgs> || ...)>>
+    SandboxedFuture<Ret> async(CallArgs&&... args)
+    {
+      SandboxedFuture<Ret> future = async(lower<Args>(args)...);
+      (mark_in_use(args, future.call), ...);
+      return future;
+    }
+
+  private:
+    /**
+     * Convert an argument to the parameter type `Param`.  Shared buffer
+     * handles are checked and replaced with the underlying pointer, all other
+     * arguments are passed through unmodified.
+     */
+    template<typename Param, typename Arg>
+    decltype(auto) lower(Arg&& arg)
+    {
+      if constexpr (internal::is_shared_buffer_handle_v<Arg>)
+      {
+        static_assert(
+          std::is_pointer_v<Param>,
+          "Shared buffers can be passed only as pointer arguments");
+        return static_cast<Param>(arg.pointer_for(lib));
+      }
+      else
+      {
+        return std::forward<Arg>(arg);
+      }
+    }
+    /**
+     * If `arg` is a shared buffer handle, record that the asynchronous call
+     * `call` is using the buffer.
+     */
+    template<typename Arg>
+    static void mark_in_use(const Arg& arg, uint32_t call)
+    {
+      if constexpr (internal::is_shared_buffer_handle_v<Arg>)
+      {
+        arg.owner().set_pending_call(call);
+      }
+    }
   };
 
   /**
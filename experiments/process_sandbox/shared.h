@@ -1,6 +1,14 @@
 // Copyright Microsoft and Project Verona Contributors.
 // SPDX-License-Identifier: MIT
 
+#include <stddef.h>
+#include <stdint.h>
 #include <zlib.h>
 int sum(int, int);
+int add(int, int);
+int alloc_churn(int);
+unsigned long checksum(const unsigned char*, unsigned long);
+long fill_churn(int);
+uintptr_t alloc_and_free(size_t);
+size_t usable_size(void*);
 int crash();
@@ -0,0 +1,71 @@
+# Shared harness for the compiler scaling benchmarks in this directory.
+#
+# Each benchmark generates a Verona program for each of a list of sizes, and
+# times veronac on it. The time is the best of `--repeats` runs. The last
+# column is how much longer each size took than the previous one, relative to
+# the growth in size, so it stays around 1 when compilation scales linearly.
+
+import argparse
+import os
+import os.path
+import subprocess
+import sys
+import tempfile
+import time
+
+def make_parser(size_help, default_sizes):
+  """
+  Create an argument parser with the options shared by every benchmark.
+  `size_help` describes what a size counts, for example "regions".
+  """
+  parser = argparse.ArgumentParser()
+  parser.add_argument("install_dir", help="Directory containing veronac")
+  parser.add_argument("--sizes", default=default_sizes,
+                      help="Comma-separated numbers of %s (default: %s)" %
+                           (size_help, default_sizes))
+  parser.add_argument("-r", "--repeats", type=int, default=3,
+                      help="Number of runs for each size (default: 3)")
+  parser.add_argument("--keep", metavar="DIR",
+                      help="Write the generated programs to DIR")
+  return parser
+
+def compile_time(veronac, source, output, repeats):
+  best = None
+  for _ in range(repeats):
+    start = time.perf_counter()
+    subprocess.run([veronac, source, "--output=" + output], check=True)
+    elapsed = time.perf_counter() - start
+    best = elapsed if best is None else min(best, elapsed)
+  return best
+
+def run(args, name, headings, generate, describe=lambda size: [size]):
+  """
+  Time veronac on the program returned by `generate(size)` for each size in
+  `args.sizes`, and print a table. `describe(size)` gives the integer columns
+  printed before the time, under `headings`.
+  """
+  sizes = [int(s) for s in args.sizes.split(",")]
+  if not sizes or min(sizes) <= 0:
+    sys.exit("sizes must be positive")
+
+  veronac = os.path.join(args.install_dir, "veronac")
+  print(" ".join("%10s" % h for h in headings) +
+        " %12s %10s" % ("time", "growth"))
+
+  with tempfile.TemporaryDirectory() as tmp:
+    directory = args.keep or tmp
+    previous = None
+    for size in sizes:
+      source = os.path.join(directory, "%s-%d.verona" % (name, size))
+      with open(source, "w") as f:
+        f.write(generate(size))
+
+      elapsed = compile_time(
+        veronac, source, os.path.join(tmp, "out.vbc"), args.repeats)
+      if previous is None:
+        growth = ""
+      else:
+        growth = "%.2f" % ((elapsed / previous[1]) / (size / previous[0]))
+      print(" ".join("%10d" % v for v in describe(size)) +
+            " %10.3fs %10s" % (elapsed, growth))
+      previous = (size, elapsed)
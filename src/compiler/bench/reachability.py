@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+
+# Measure how the compiler scales with the number of generic instantiations.
+#
+# For each size N, this generates a program that instantiates a generic class
+# `Box[T]` with N different classes, and passes each instantiation to a method
+# expecting one of a few interfaces, then times veronac on it. Every
+# instantiation is reachable and a subtype of every interface, so the
+# reachability phase has to relate N entities to the interfaces, and find
+# that none of the instantiations are equivalent to each other.
+#
+# See benchlib.py for how the programs are timed.
+
+import sys
+
+import benchlib
+
+parser = benchlib.make_parser("instantiations", "100,200,400,800")
+parser.add_argument("--interfaces", type=int, default=4,
+                    help="Number of interfaces implemented by Box (default: 4)")
+args = parser.parse_args()
+
+def generate(size, interfaces):
+  lines = ["// Generated by src/compiler/bench/reachability.py", ""]
+
+  for k in range(interfaces):
+    lines += ["interface Area%d" % k,
+              "{",
+              "  area%d(self: mut): U64 & imm;" % k,
+              "}",
+              ""]
+
+  for i in range(size):
+    lines += ["class Leaf%d { }" % i]
+  lines += [""]
+
+  lines += ["class Box[T]",
+            "{",
+            "  value: U64 & imm;",
+            "",
+            "  create(): Box[T] & iso",
+            "  {",
+            "    var result = new Box;",
+            "    result.value = 1;",
+            "    result",
+            "  }"]
+  for k in range(interfaces):
+    lines += ["",
+              "  area%d(self: mut): U64 & imm" % k,
+              "  {",
+              "    self.value",
+              "  }"]
+  lines += ["}", ""]
+
+  lines += ["class Main", "{", "  main()", "  {"]
+  for i in range(size):
+    lines += ["    Main.use%d(mut-view (Box.create()));" % i]
+  lines += ["  }"]
+
+  for i in range(size):
+    lines += ["",
+              "  use%d(box: Box[Leaf%d] & mut)" % (i, i),
+              "  {",
+              "    Main.measure%d(box);" % (i % interfaces),
+              "  }"]
+
+  for k in range(interfaces):
+    lines += ["",
+              "  measure%d(shape: Area%d & mut)" % (k, k),
+              "  {",
+              "    shape.area%d();" % k,
+              "  }"]
+  lines += ["}", ""]
+
+  return "\n".join(lines)
+
+if args.interfaces <= 0:
+  sys.exit("--interfaces must be positive")
+
+benchlib.run(args, "reachability", ["instances"],
+             lambda size: generate(size, args.interfaces))
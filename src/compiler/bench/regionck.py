@@ -0,0 +1,51 @@
+#!/usr/bin/env python3
+
+# Measure how region checking scales with the number of variables in a
+# function.
+#
+# For each size N, this generates a single method which creates N regions, and
+# allocates a chain of `--depth` objects inside each of them, each object
+# pointing to the next one. Every object is held by a variable, so the method
+# has roughly N * (depth + 1) variables, all of which are part of the region
+# graph, then times veronac on it. When the regions go out of scope, region
+# checking needs the transitive children of each of them.
+#
+# See benchlib.py for how the programs are timed.
+
+import sys
+
+import benchlib
+
+parser = benchlib.make_parser("regions", "250,500,1000,2000")
+parser.add_argument("--depth", type=int, default=3,
+                    help="Number of objects allocated in each region "
+                         "(default: 3)")
+args = parser.parse_args()
+
+def generate(size, depth):
+  lines = ["// Generated by src/compiler/bench/regionck.py", "",
+           "class A { f: (A & mut) | (None & imm); }", "",
+           "class Main", "{", "  main()", "  {"]
+
+  for i in range(size):
+    if i > 0:
+      lines += [""]
+    lines += ["    var r%d = new A;" % i,
+              "    r%d.f = None.create();" % i]
+    parent = "r%d" % i
+    for d in range(depth):
+      child = "a%d_%d" % (i, d)
+      lines += ["    var %s = new A in %s;" % (child, parent),
+                "    %s.f = None.create();" % child,
+                "    %s.f = %s;" % (parent, child)]
+      parent = child
+
+  lines += ["  }", "}", ""]
+  return "\n".join(lines)
+
+if args.depth <= 0:
+  sys.exit("--depth must be positive")
+
+benchlib.run(args, "regionck", ["regions", "variables"],
+             lambda size: generate(size, args.depth),
+             lambda size: [size, size * (args.depth + 1)])
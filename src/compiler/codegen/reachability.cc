@@ -10,6 +10,7 @@
 #include "compiler/typecheck/solver.h"
 #include "compiler/typecheck/typecheck.h"
 
+#include <algorithm>
 #include <fmt/ostream.h>
 #include <map>
 #include <queue>
@@ -105,11 +106,29 @@ namespace verona::compiler
      *
      * If such an equivalent entity is found, the equivalence is recorded in the
      * result and true is returned.
+     *
+     * Classes and primitives are nominal, so they can only be equivalent to
+     * another instantiation of the same definition. An interface can only be
+     * equivalent to another interface with the same member names, since each
+     * must have all of the other's members.
      */
     bool find_equivalence(const CodegenItem<Entity>& new_item)
     {
-      for (auto& [other, _] : result_.entities)
+      const std::set<CodegenItem<Entity>>* candidates;
+      if (is_interface(new_item))
+        candidates = find_index(
+          interfaces_by_members_, member_names(new_item.definition));
+      else
+        candidates = find_index(entities_by_definition_, new_item.definition);
+
+      if (candidates == nullptr)
+        return false;
+
+      for (const auto& other : *candidates)
       {
+        if (!may_be_equivalent(new_item, other))
+          continue;
+
         if (check_equivalent(new_item, other))
         {
           result_.equivalent_entities.insert({new_item, other});
@@ -123,18 +142,168 @@ namespace verona::compiler
      * For the given entity, find all other reachable entities that are sub-
      * or supertypes of that one, and update the reachability info with any of
      * these relationship.
+     *
+     * Only pairs that could be related are checked:
+     * - The supertype must be an interface, whose members the subtype must
+     *   all have. Type arguments are invariant, so another instantiation of
+     *   the same class would only be a sub- or supertype if it were
+     *   equivalent, which `find_equivalence` has already ruled out.
+     * - If `item` is an interface, its subtypes are the entities that have
+     *   all of its members.
      */
     void consider_entity_subtyping(
       const CodegenItem<Entity>& item, EntityReachability& item_info)
     {
-      for (auto& [other, other_info] : result_.entities)
+      for (const auto& other : find_subtype_candidates(item))
       {
         if (item == other)
           continue;
 
         consider_subtyping_pair(other, item, item_info);
-        consider_subtyping_pair(item, other, other_info);
       }
+
+      for (const auto& other : find_supertype_candidates(item))
+      {
+        if (item == other)
+          continue;
+
+        consider_subtyping_pair(item, other, result_.entities.at(other));
+      }
+    }
+
+    /**
+     * Reachable entities that have all the members of the interface `super`.
+     */
+    std::set<CodegenItem<Entity>>
+    find_subtype_candidates(const CodegenItem<Entity>& super)
+    {
+      std::set<CodegenItem<Entity>> result;
+      if (!is_interface(super))
+        return result;
+
+      const std::vector<std::string>& names = member_names(super.definition);
+      if (names.empty())
+      {
+        for (const auto& [other, _] : result_.entities)
+        {
+          result.insert(other);
+        }
+        return result;
+      }
+
+      // Start from the smallest set of entities that have one of the names,
+      // and keep the ones that have all the others.
+      const std::set<CodegenItem<Entity>>* smallest = nullptr;
+      for (const auto& name : names)
+      {
+        const auto* entities = find_index(entities_by_member_, name);
+        if (entities == nullptr)
+          return result;
+        if (smallest == nullptr || entities->size() < smallest->size())
+          smallest = entities;
+      }
+
+      for (const auto& other : *smallest)
+      {
+        if (has_members(other.definition, names))
+          result.insert(other);
+      }
+      return result;
+    }
+
+    /**
+     * Reachable interfaces whose members `sub` all has.
+     */
+    std::set<CodegenItem<Entity>>
+    find_supertype_candidates(const CodegenItem<Entity>& sub)
+    {
+      std::set<CodegenItem<Entity>> result;
+      for (const auto& [names, interfaces] : interfaces_by_members_)
+      {
+        if (has_members(sub.definition, names))
+          result.insert(interfaces.begin(), interfaces.end());
+      }
+      return result;
+    }
+
+    /**
+     * Cheap test for whether two instantiations of the same class or
+     * primitive could be equivalent, without running the solver. These are
+     * nominal, so the instantiations are only equivalent if their type
+     * arguments are. A class or primitive is only equivalent to itself, so
+     * arguments that are both classes or primitives must have the same
+     * definition.
+     *
+     * This does not apply to interfaces, which are structural: two
+     * instantiations of an interface are equivalent whenever their members
+     * are, even if their arguments are not, for instance when a type
+     * parameter is not used by any member.
+     */
+    static bool may_be_equivalent(
+      const CodegenItem<Entity>& left, const CodegenItem<Entity>& right)
+    {
+      if (left.definition != right.definition || is_interface(left))
+        return true;
+
+      const TypeList& left_args = left.instantiation.types();
+      const TypeList& right_args = right.instantiation.types();
+      for (size_t i = 0; i < left_args.size(); i++)
+      {
+        auto left_ty = left_args[i]->dyncast<EntityType>();
+        auto right_ty = right_args[i]->dyncast<EntityType>();
+        if (
+          left_ty && right_ty && left_ty->definition != right_ty->definition &&
+          !is_interface(left_ty->definition) &&
+          !is_interface(right_ty->definition))
+          return false;
+      }
+      return true;
+    }
+
+    static bool is_interface(const Entity* entity)
+    {
+      return entity->kind->value() == Entity::Interface;
+    }
+
+    static bool is_interface(const CodegenItem<Entity>& item)
+    {
+      return is_interface(item.definition);
+    }
+
+    static bool
+    has_members(const Entity* entity, const std::vector<std::string>& names)
+    {
+      return std::all_of(names.begin(), names.end(), [&](const auto& name) {
+        return entity->members_table.count(name) > 0;
+      });
+    }
+
+    /**
+     * The sorted names of the members of `entity`.
+     */
+    const std::vector<std::string>& member_names(const Entity* entity)
+    {
+      auto [it, inserted] = member_names_.insert({entity, {}});
+      if (inserted)
+      {
+        for (const auto& [name, _] : entity->members_table)
+        {
+          it->second.push_back(name);
+        }
+        std::sort(it->second.begin(), it->second.end());
+      }
+      return it->second;
+    }
+
+    template<typename K>
+    static const std::set<CodegenItem<Entity>>* find_index(
+      const std::map<K, std::set<CodegenItem<Entity>>>& index, const K& key)
+    {
+      auto it = index.find(key);
+      if (it != index.end())
+        return &it->second;
+      else
+        return nullptr;
     }
 
     /**
@@ -163,9 +332,21 @@ namespace verona::compiler
 
     /**
      * Check whether one entity is a subtype of another.
+     *
+     * The result is cached, as the same pair is queried both when looking for
+     * an equivalent entity and when looking for subtypes.
      */
     bool check_subtype(
       const CodegenItem<Entity>& sub, const CodegenItem<Entity>& super)
+    {
+      auto [it, inserted] = subtype_cache_.insert({{sub, super}, false});
+      if (inserted)
+        it->second = solve_subtype(sub, super);
+      return it->second;
+    }
+
+    bool solve_subtype(
+      const CodegenItem<Entity>& sub, const CodegenItem<Entity>& super)
     {
       Constraint constraint(
         context_.mk_entity_type(sub.definition, sub.instantiation.types()),
@@ -183,23 +364,14 @@ namespace verona::compiler
 
     /**
      * Check whether two entities are equivalent to each other.
+     *
+     * Reified entities have no inference variables, so this is the same as
+     * checking each direction separately, which lets both checks be cached.
      */
     bool check_equivalent(
       const CodegenItem<Entity>& left, const CodegenItem<Entity>& right)
     {
-      TypePtr left_ty =
-        context_.mk_entity_type(left.definition, left.instantiation.types());
-      TypePtr right_ty =
-        context_.mk_entity_type(right.definition, right.instantiation.types());
-
-      Solver solver(context_, *solver_out_);
-      Solver::SolutionSet solutions = solver.solve_all(
-        {Constraint(left_ty, right_ty, 0, context_),
-         Constraint(right_ty, left_ty, 0, context_)},
-        SolverMode::Verify);
-      solver.print_stats(solutions);
-
-      return !solutions.empty();
+      return check_subtype(left, right) && check_subtype(right, left);
     }
 
     /**
@@ -562,6 +734,15 @@ namespace verona::compiler
       if (!inserted)
         throw std::logic_error("Entity added multiple times");
 
+      entities_by_definition_[entity.definition].insert(entity);
+      const std::vector<std::string>& names = member_names(entity.definition);
+      for (const auto& name : names)
+      {
+        entities_by_member_[name].insert(entity);
+      }
+      if (is_interface(entity))
+        interfaces_by_members_[names].insert(entity);
+
       return it->second;
     }
 
@@ -595,6 +776,18 @@ namespace verona::compiler
     std::queue<ReachabilityItem> queue_;
     std::set<ReachabilityItem> visited_;
     std::unique_ptr<std::ostream> solver_out_;
+
+    // Indices over the reachable entities, used to only check subtyping
+    // between entities that could be related.
+    std::map<const Entity*, std::set<CodegenItem<Entity>>>
+      entities_by_definition_;
+    std::map<std::string, std::set<CodegenItem<Entity>>> entities_by_member_;
+    std::map<std::vector<std::string>, std::set<CodegenItem<Entity>>>
+      interfaces_by_members_;
+    std::map<const Entity*, std::vector<std::string>> member_names_;
+
+    std::map<std::pair<CodegenItem<Entity>, CodegenItem<Entity>>, bool>
+      subtype_cache_;
   };
 
   const CodegenItem<Entity>&
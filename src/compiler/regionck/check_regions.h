@@ -297,38 +297,18 @@ namespace verona::compiler
       Diagnostic reason_diagnostic,
       Args&&... reason_args)
     {
-      std::unordered_set<Variable> visited;
-      std::vector<Variable> todo;
-
       /**
-       * We walk the region graph to find all transitive direct and indirect
-       * children, and call check_not_live on them.
+       * The transitive direct and indirect children are precomputed by the
+       * region graph, so we only need to call check_not_live on them.
        */
-
-      auto push_children = [&](Variable v) {
-        if (auto it = graph.incoming_edges.find(v);
-            it != graph.incoming_edges.end())
-        {
-          for (auto [child, _] : it->second)
-          {
-            if (visited.find(child) == visited.end())
-              todo.push_back(child);
-          }
-        }
-      };
-
-      push_children(root);
-      while (!todo.empty())
+      for (RegionGraph::Node child : graph.children(root))
       {
-        Variable current = todo.back();
-        todo.pop_back();
-
-        if (auto [_, inserted] = visited.insert(current); inserted)
-        {
-          check_not_live(
-            live, current, reason_range, reason_diagnostic, reason_args...);
-          push_children(current);
-        }
+        check_not_live(
+          live,
+          graph.variable(child),
+          reason_range,
+          reason_diagnostic,
+          reason_args...);
       }
     }
 
@@ -3,12 +3,282 @@
 #include "compiler/regionck/region_graph.h"
 
 #include "compiler/format.h"
+#include "compiler/freevars.h"
 #include "compiler/typecheck/solver.h"
 #include "compiler/typecheck/typecheck.h"
 #include "compiler/visitor.h"
 
+#include <algorithm>
+#include <limits>
+#include <tuple>
+
 namespace verona::compiler
 {
+  RegionGraph::RegionGraph(std::vector<Variable> variables)
+  : variables_(std::move(variables))
+  {
+    std::sort(variables_.begin(), variables_.end());
+    assert(
+      std::adjacent_find(variables_.begin(), variables_.end()) ==
+      variables_.end());
+    assert(variables_.size() < std::numeric_limits<Node>::max());
+  }
+
+  std::optional<RegionGraph::Node> RegionGraph::find(Variable variable) const
+  {
+    auto it = std::lower_bound(variables_.begin(), variables_.end(), variable);
+    if (it == variables_.end() || *it != variable)
+      return std::nullopt;
+    return Node(it - variables_.begin());
+  }
+
+  void RegionGraph::add_edge(Variable from, Variable to, Edge edge)
+  {
+    assert(outgoing_offsets_.empty());
+    std::optional<Node> from_node = find(from);
+    std::optional<Node> to_node = find(to);
+    assert(from_node && to_node);
+    pending_.push_back({*from_node, *to_node, edge});
+  }
+
+  void RegionGraph::finish()
+  {
+    build_edges();
+    compress_cycles();
+    compute_children();
+  }
+
+  RegionGraph::Range<RegionGraph::Target>
+  RegionGraph::outgoing_edges(Node node) const
+  {
+    const Target* base = outgoing_.data();
+    return {base + outgoing_offsets_.at(node),
+            base + outgoing_offsets_.at(node + 1)};
+  }
+
+  RegionGraph::Range<RegionGraph::Target>
+  RegionGraph::incoming_edges(Node node) const
+  {
+    const Target* base = incoming_.data();
+    return {base + incoming_offsets_.at(node),
+            base + incoming_offsets_.at(node + 1)};
+  }
+
+  RegionGraph::Range<RegionGraph::Node> RegionGraph::children(Node node) const
+  {
+    uint32_t c = component_.at(node);
+    const Node* base = children_.data();
+    return {base + children_offsets_.at(c), base + children_offsets_.at(c + 1)};
+  }
+
+  RegionGraph::Range<RegionGraph::Node>
+  RegionGraph::children(Variable variable) const
+  {
+    if (std::optional<Node> node = find(variable))
+      return children(*node);
+    return {nullptr, nullptr};
+  }
+
+  /**
+   * Move the pending edges into the outgoing and incoming arrays.
+   *
+   * The pending edges are sorted by source then target first, which makes
+   * every row of both arrays sorted as they get filled in.
+   */
+  void RegionGraph::build_edges()
+  {
+    std::sort(
+      pending_.begin(),
+      pending_.end(),
+      [](const PendingEdge& left, const PendingEdge& right) {
+        return std::tie(left.from, left.to) < std::tie(right.from, right.to);
+      });
+
+    size_t count = size();
+    outgoing_offsets_.assign(count + 1, 0);
+    incoming_offsets_.assign(count + 1, 0);
+    for (const PendingEdge& e : pending_)
+    {
+      outgoing_offsets_[e.from + 1]++;
+      incoming_offsets_[e.to + 1]++;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+      outgoing_offsets_[i + 1] += outgoing_offsets_[i];
+      incoming_offsets_[i + 1] += incoming_offsets_[i];
+    }
+
+    std::vector<uint32_t> outgoing_next(
+      outgoing_offsets_.begin(), outgoing_offsets_.end() - 1);
+    std::vector<uint32_t> incoming_next(
+      incoming_offsets_.begin(), incoming_offsets_.end() - 1);
+    outgoing_.resize(pending_.size());
+    incoming_.resize(pending_.size());
+    for (const PendingEdge& e : pending_)
+    {
+      outgoing_[outgoing_next[e.from]++] = {e.to, e.edge};
+      incoming_[incoming_next[e.to]++] = {e.from, e.edge};
+    }
+
+    pending_.clear();
+    pending_.shrink_to_fit();
+  }
+
+  /**
+   * Find the strongly connected components of the graph, using an iterative
+   * version of Tarjan's algorithm that follows incoming edges.
+   *
+   * Tarjan's algorithm completes a component only once every component
+   * reachable from it has been completed, so numbering the components in the
+   * order they are completed gives children a lower number than their parents.
+   */
+  void RegionGraph::compress_cycles()
+  {
+    constexpr uint32_t unvisited = std::numeric_limits<uint32_t>::max();
+
+    size_t count = size();
+    std::vector<uint32_t> index(count, unvisited);
+    std::vector<uint32_t> lowlink(count);
+    std::vector<bool> on_stack(count, false);
+    std::vector<Node> stack;
+    uint32_t next_index = 0;
+
+    struct Frame
+    {
+      Node node;
+      uint32_t next_edge;
+    };
+    std::vector<Frame> frames;
+
+    auto visit = [&](Node node) {
+      index[node] = lowlink[node] = next_index++;
+      stack.push_back(node);
+      on_stack[node] = true;
+      frames.push_back({node, incoming_offsets_[node]});
+    };
+
+    component_.assign(count, unvisited);
+    component_offsets_.assign(1, 0);
+    component_members_.clear();
+    component_members_.reserve(count);
+
+    for (Node root = 0; root < count; root++)
+    {
+      if (index[root] != unvisited)
+        continue;
+
+      visit(root);
+      while (!frames.empty())
+      {
+        Node node = frames.back().node;
+        uint32_t edge = frames.back().next_edge;
+        if (edge < incoming_offsets_[node + 1])
+        {
+          frames.back().next_edge++;
+          Node child = incoming_[edge].node;
+          if (index[child] == unvisited)
+            visit(child);
+          else if (on_stack[child])
+            lowlink[node] = std::min(lowlink[node], index[child]);
+          continue;
+        }
+
+        frames.pop_back();
+        if (!frames.empty())
+        {
+          Node parent = frames.back().node;
+          lowlink[parent] = std::min(lowlink[parent], lowlink[node]);
+        }
+
+        if (lowlink[node] == index[node])
+        {
+          uint32_t c = uint32_t(component_offsets_.size() - 1);
+          size_t first = component_members_.size();
+          Node member;
+          do
+          {
+            member = stack.back();
+            stack.pop_back();
+            on_stack[member] = false;
+            component_[member] = c;
+            component_members_.push_back(member);
+          } while (member != node);
+
+          std::sort(
+            component_members_.begin() + first, component_members_.end());
+          component_offsets_.push_back(uint32_t(component_members_.size()));
+        }
+      }
+    }
+  }
+
+  /**
+   * Compute the children of every component, in increasing order of the
+   * components, so the children of a component's children are always known
+   * by the time we get to it.
+   *
+   * The children of a component are made of whole components, so we first
+   * find the components that are reachable, then expand them to their members.
+   * A component is only reachable from itself if it is a cycle, in which case
+   * one of its members has an incoming edge from inside of it.
+   */
+  void RegionGraph::compute_children()
+  {
+    size_t count = component_offsets_.size() - 1;
+    constexpr uint32_t unmarked = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> marked(count, unmarked);
+    std::vector<uint32_t> reached;
+
+    auto members = [&](uint32_t c) {
+      return Range<Node>{component_members_.data() + component_offsets_[c],
+                         component_members_.data() + component_offsets_[c + 1]};
+    };
+
+    children_offsets_.assign(1, 0);
+    children_.clear();
+    for (uint32_t c = 0; c < count; c++)
+    {
+      reached.clear();
+      for (Node member : members(c))
+      {
+        for (const Target& edge : incoming_edges(member))
+        {
+          // Anything reachable from an already marked component has been
+          // marked along with it.
+          uint32_t child = component_[edge.node];
+          if (marked[child] == c)
+            continue;
+          marked[child] = c;
+          reached.push_back(child);
+
+          if (child == c)
+            continue;
+          const Node* base = children_.data();
+          for (const Node* it = base + children_offsets_[child];
+               it != base + children_offsets_[child + 1];
+               it++)
+          {
+            uint32_t grandchild = component_[*it];
+            if (marked[grandchild] != c)
+            {
+              marked[grandchild] = c;
+              reached.push_back(grandchild);
+            }
+          }
+        }
+      }
+
+      size_t first = children_.size();
+      for (uint32_t r : reached)
+      {
+        for (Node node : members(r))
+          children_.push_back(node);
+      }
+      std::sort(children_.begin() + first, children_.end());
+      children_offsets_.push_back(uint32_t(children_.size()));
+    }
+  }
+
   void dump_region_graphs(
     Context& context, const Method& method, const RegionGraphs& graphs)
   {
@@ -20,15 +290,17 @@ namespace verona::compiler
       fmt::print(*out, "  {}:\n", *bb);
 
       size_t padding = 0;
-      for (const auto& [from, _] : graph.outgoing_edges)
+      for (RegionGraph::Node from = 0; from < graph.size(); from++)
       {
-        padding = std::max(padding, fmt::formatted_size("{}", from));
+        if (!graph.outgoing_edges(from).empty())
+          padding = std::max(
+            padding, fmt::formatted_size("{}", graph.variable(from)));
       }
 
-      for (const auto& [from, edges] : graph.outgoing_edges)
+      for (RegionGraph::Node from = 0; from < graph.size(); from++)
       {
         bool first = true;
-        for (const auto& [to, kind] : edges)
+        for (const auto& [to, kind] : graph.outgoing_edges(from))
         {
           char kind_char;
           switch (kind)
@@ -45,12 +317,46 @@ namespace verona::compiler
           }
           if (first)
             fmt::print(
-              *out, "   {:>{}} ->{} {}\n", from, padding, kind_char, to);
+              *out,
+              "   {:>{}} ->{} {}\n",
+              graph.variable(from),
+              padding,
+              kind_char,
+              graph.variable(to));
           else
-            fmt::print(*out, "   {:>{}} ->{} {}\n", "", padding, kind_char, to);
+            fmt::print(
+              *out,
+              "   {:>{}} ->{} {}\n",
+              "",
+              padding,
+              kind_char,
+              graph.variable(to));
           first = false;
         }
       }
+
+      // Print the cycles merged by path compression. A node is part of a
+      // cycle if it is one of its own children, and each cycle is printed
+      // once, from its first node.
+      for (RegionGraph::Node node = 0; node < graph.size(); node++)
+      {
+        std::vector<RegionGraph::Node> cycle;
+        for (RegionGraph::Node child : graph.children(node))
+        {
+          if (graph.component(child) == graph.component(node))
+            cycle.push_back(child);
+        }
+
+        if (!cycle.empty() && cycle.front() == node)
+        {
+          fmt::print(*out, "   cycle:");
+          for (RegionGraph::Node member : cycle)
+          {
+            fmt::print(*out, " {}", graph.variable(member));
+          }
+          fmt::print(*out, "\n");
+        }
+      }
     }
   }
 
@@ -87,6 +393,86 @@ namespace verona::compiler
     return std::nullopt;
   }
 
+  /**
+   * Add the edges from `variable` to the other variables of the graph.
+   *
+   * The solver only ever compares regions for equality, so the edge towards a
+   * region which the type doesn't mention is the same whichever region that
+   * is. Rather than querying the solver for every pair of variables, which is
+   * quadratic in the size of the function, we query it once for each region
+   * mentioned by the type, and once for all the others.
+   */
+  void add_edges(
+    Context& context,
+    Solver& solver,
+    RegionGraph& graph,
+    Variable variable,
+    TypePtr type)
+  {
+    auto add_edge =
+      [&](Variable parent, std::optional<RegionGraph::Edge> edge) {
+        if (edge)
+          graph.add_edge(variable, parent, *edge);
+      };
+
+    const FreeVariables& freevars = context.free_variables(type);
+
+    // Indirect and inference types may refer to regions without them being
+    // part of the free variables, so every region needs its own query.
+    if (freevars.has_indirect_type || !freevars.inference.empty())
+    {
+      for (RegionGraph::Node node = 0; node < graph.size(); node++)
+      {
+        Variable parent = graph.variable(node);
+        add_edge(
+          parent,
+          compute_edge(
+            context, solver, variable, type, RegionVariable{parent}));
+      }
+      return;
+    }
+
+    // Query the solver on the first region not mentioned by the type, which
+    // stands for all of them.
+    std::optional<RegionGraph::Edge> unmentioned_edge;
+    for (RegionGraph::Node node = 0; node < graph.size(); node++)
+    {
+      Variable parent = graph.variable(node);
+      if (!freevars.contains_region(parent))
+      {
+        unmentioned_edge =
+          compute_edge(context, solver, variable, type, RegionVariable{parent});
+        break;
+      }
+    }
+
+    if (unmentioned_edge)
+    {
+      for (RegionGraph::Node node = 0; node < graph.size(); node++)
+      {
+        Variable parent = graph.variable(node);
+        if (freevars.contains_region(parent))
+          add_edge(
+            parent,
+            compute_edge(
+              context, solver, variable, type, RegionVariable{parent}));
+        else
+          add_edge(parent, unmentioned_edge);
+      }
+    }
+    else
+    {
+      for (Variable parent : freevars.region_variables)
+      {
+        if (graph.find(parent))
+          add_edge(
+            parent,
+            compute_edge(
+              context, solver, variable, type, RegionVariable{parent}));
+      }
+    }
+  }
+
   std::unique_ptr<RegionGraphs> make_region_graphs(
     Context& context, const Method& method, const TypecheckResults& typecheck)
   {
@@ -96,22 +482,20 @@ namespace verona::compiler
     std::unique_ptr<RegionGraphs> result = std::make_unique<RegionGraphs>();
     for (const auto& [bb, assignment] : typecheck.types)
     {
-      RegionGraph& graph = (*result)[bb];
+      std::vector<Variable> variables;
+      variables.reserve(assignment.size());
+      for (const auto& [variable, _] : assignment)
+      {
+        variables.push_back(variable);
+      }
+
+      RegionGraph graph(std::move(variables));
       for (const auto& [variable, ty] : assignment)
       {
-        for (const auto& [parent, _] : assignment)
-        {
-          Region parent_region = RegionVariable{parent};
-          RegionGraph& graph = (*result)[bb];
-          if (
-            auto edge =
-              compute_edge(context, solver, variable, ty, parent_region))
-          {
-            graph.outgoing_edges[variable][parent] = *edge;
-            graph.incoming_edges[parent][variable] = *edge;
-          }
-        }
+        add_edges(context, solver, graph, variable, ty);
       }
+      graph.finish();
+      result->emplace(bb, std::move(graph));
     }
 
     dump_region_graphs(context, method, *result);
@@ -3,8 +3,9 @@
 #pragma once
 #include "compiler/ir/ir.h"
 
-#include <map>
+#include <optional>
 #include <unordered_map>
+#include <vector>
 
 namespace verona::compiler
 {
@@ -21,14 +22,21 @@ namespace verona::compiler
    * fine because it is hard / impossible to get the IR to produce intersections
    * to different regions. Would be nice to be handling this properly though.
    *
-   * The graph should be acyclic, but this is not yet the case because path
-   * compression isn't properly implemented, which can lead to variables that
-   * mention themselves in their own type.
+   * The graph should be acyclic, but this is not guaranteed because path
+   * compression in types isn't properly implemented, which can lead to
+   * variables that mention themselves in their own type. Cycles are instead
+   * compressed when the graph is built: the variables of a cycle are merged
+   * into a single component, and the graph of components is acyclic.
    *
    * Currently only edges between RegionVariable regions are tracked. This is
    * fine because the graph is only being used to find children of a region.
    * When we start looking for sibling regions, we'll need to add edges to
    * RegionExternal as well.
+   *
+   * Functions can have thousands of variables, so the graph is stored in flat
+   * arrays: each variable is given a dense node index, edges are stored in
+   * compressed sparse row form, and the transitive children of every node are
+   * computed once, rather than walking the graph on every query.
    */
   struct RegionGraph
   {
@@ -53,10 +61,137 @@ namespace verona::compiler
       Indirect,
     };
 
-    std::map<Variable, std::map<Variable, Edge>> outgoing_edges;
-    std::map<Variable, std::map<Variable, Edge>> incoming_edges;
+    /**
+     * Index of a variable in the graph. Nodes are numbered in increasing
+     * order of the variables.
+     */
+    typedef uint32_t Node;
+
+    struct Target
+    {
+      Node node;
+      Edge edge;
+    };
+
+    /**
+     * View over a contiguous range of the graph's arrays.
+     */
+    template<typename T>
+    struct Range
+    {
+      const T* first;
+      const T* last;
+
+      const T* begin() const
+      {
+        return first;
+      }
+      const T* end() const
+      {
+        return last;
+      }
+      size_t size() const
+      {
+        return last - first;
+      }
+      bool empty() const
+      {
+        return first == last;
+      }
+    };
 
+    /**
+     * Create a graph with a node for each of the variables, and no edges.
+     */
+    explicit RegionGraph(std::vector<Variable> variables);
+
+    /**
+     * Add an edge between two variables of the graph. Edges may only be added
+     * before `finish` is called, and at most once for each pair of variables.
+     */
     void add_edge(Variable from, Variable to, Edge edge);
+
+    /**
+     * Build the edge arrays, compress cycles and compute the children of each
+     * node. This must be called after all edges have been added, and before
+     * the graph is queried.
+     */
+    void finish();
+
+    size_t size() const
+    {
+      return variables_.size();
+    }
+
+    Variable variable(Node node) const
+    {
+      return variables_.at(node);
+    }
+
+    std::optional<Node> find(Variable variable) const;
+
+    /**
+     * Edges from `node` to its parents, in increasing order of the parents.
+     */
+    Range<Target> outgoing_edges(Node node) const;
+
+    /**
+     * Edges from the children of `node` to it, in increasing order of the
+     * children.
+     */
+    Range<Target> incoming_edges(Node node) const;
+
+    /**
+     * Component the node was merged into by path compression. Nodes of the
+     * same cycle have the same component, and every other node has a
+     * component of its own.
+     */
+    size_t component(Node node) const
+    {
+      return component_.at(node);
+    }
+
+    /**
+     * All nodes reachable by following incoming edges from `node`, that is
+     * its direct and indirect children, in increasing order. The node itself
+     * is only included if it is part of a cycle.
+     */
+    Range<Node> children(Node node) const;
+    Range<Node> children(Variable variable) const;
+
+  private:
+    struct PendingEdge
+    {
+      Node from;
+      Node to;
+      Edge edge;
+    };
+
+    void build_edges();
+    void compress_cycles();
+    void compute_children();
+
+    std::vector<Variable> variables_;
+
+    // Edges added before `finish` is called.
+    std::vector<PendingEdge> pending_;
+
+    // Edges of node n are in the range [offsets[n], offsets[n + 1]).
+    std::vector<uint32_t> outgoing_offsets_;
+    std::vector<Target> outgoing_;
+    std::vector<uint32_t> incoming_offsets_;
+    std::vector<Target> incoming_;
+
+    // Components are numbered so that the children of a component have a
+    // lower number than it.
+    std::vector<uint32_t> component_;
+    std::vector<uint32_t> component_offsets_;
+    std::vector<Node> component_members_;
+
+    // Children of component c are in the range
+    // [children_offsets_[c], children_offsets_[c + 1]).
+    std::vector<uint32_t> children_offsets_;
+    std::vector<Node> children_;
   };
   typedef std::unordered_map<const BasicBlock*, RegionGraph> RegionGraphs;
 
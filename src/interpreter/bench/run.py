@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+
+# Run the interpreter benchmarks.
+#
+# Each NAME.verona file in this directory is compiled once with veronac, then
+# executed by the interpreter with `--iterations` and `--stats`, so that the
+# bytecode is only loaded once and every iteration reports its own time and
+# number of allocations. The first `--warmup` iterations are discarded, and the
+# remaining ones are summarised as the median and minimum time, and the mean
+# number of objects, regions and cowns allocated per iteration.
+#
+# Every benchmark prints a line that is checked against its CHECK-L comment,
+# so that a benchmark that stops computing the right result is noticed.
+
+import argparse
+import glob
+import os
+import os.path
+import re
+import statistics
+import subprocess
+import sys
+import tempfile
+
+parser = argparse.ArgumentParser()
+parser.add_argument("install_dir",
+                    help="Directory containing veronac and interpreter")
+parser.add_argument("-n", "--iterations", type=int, default=10,
+                    help="Number of measured iterations (default: 10)")
+parser.add_argument("--warmup", type=int, default=2,
+                    help="Number of iterations to discard (default: 2)")
+parser.add_argument("--cores", type=int, default=4,
+                    help="Number of scheduler threads (default: 4)")
+parser.add_argument("--csv", action="store_true",
+                    help="Print the results as CSV")
+parser.add_argument("benchmarks", nargs="*",
+                    help="Names of the benchmarks to run (default: all)")
+args = parser.parse_args()
+
+VERONAC = os.path.join(args.install_dir, "veronac")
+INTERPRETER = os.path.join(args.install_dir, "interpreter")
+BENCH_DIR = os.path.dirname(os.path.abspath(__file__))
+ITERATION = re.compile(r"iteration (\d+): (\d+) ns, (\d+) allocations")
+
+def expected_output(source):
+  with open(source) as f:
+    return [line.split("CHECK-L:", 1)[1].strip()
+            for line in f if "CHECK-L:" in line]
+
+def run(name, bytecode, expected):
+  total = args.warmup + args.iterations
+  result = subprocess.run(
+      [INTERPRETER, bytecode, "--cores", str(args.cores),
+       "--iterations", str(total), "--stats"],
+      check=True, stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+      universal_newlines=True)
+
+  for line in expected:
+    if result.stdout.count(line) != total:
+      sys.exit("%s: expected `%s` in the output of every iteration" %
+               (name, line))
+
+  samples = [(int(m.group(2)), int(m.group(3)))
+             for m in ITERATION.finditer(result.stderr)]
+  if len(samples) != total:
+    sys.exit("%s: expected %d iterations, got %d" %
+             (name, total, len(samples)))
+  return samples[args.warmup:]
+
+if args.csv:
+  print("benchmark,median_ms,min_ms,allocations")
+else:
+  print("%-12s %12s %12s %14s" %
+        ("Benchmark", "median", "min", "allocations"))
+
+with tempfile.TemporaryDirectory() as tmp:
+  for source in sorted(glob.glob(os.path.join(BENCH_DIR, "*.verona"))):
+    name = os.path.splitext(os.path.basename(source))[0]
+    if args.benchmarks and name not in args.benchmarks:
+      continue
+
+    bytecode = os.path.join(tmp, name + ".vbc")
+    subprocess.run([VERONAC, source, "--output=" + bytecode], check=True)
+
+    samples = run(name, bytecode, expected_output(source))
+    times = [ns / 1e6 for ns, _ in samples]
+    allocations = statistics.mean(a for _, a in samples)
+
+    if args.csv:
+      print("%s,%.3f,%.3f,%d" %
+            (name, statistics.median(times), min(times), allocations))
+    else:
+      print("%-12s %10.3fms %10.3fms %14d" %
+            (name, statistics.median(times), min(times), allocations))
@@ -4,6 +4,7 @@
 #include "interpreter/vm.h"
 #include "options.h"
 
+#include <chrono>
 #include <iterator>
 #include <verona.h>
 
@@ -58,6 +59,37 @@ namespace verona::interpreter
     snmalloc::current_alloc_pool()->debug_check_empty();
   }
 
+  /**
+   * Run the program `options.iterations` times. Each run starts and stops the
+   * scheduler, but the bytecode is only loaded once.
+   *
+   * With `options.stats`, the wall-clock time of each run and the number of
+   * objects, regions and cowns it allocated are printed to stderr, as
+   * `iteration 0: 1234567 ns, 89 allocations`.
+   */
+  void instantiate_repeatedly(
+    InterpreterOptions& options, const Code& code, size_t seed = 1234)
+  {
+    for (size_t i = 0; i < options.iterations; i++)
+    {
+      auto start = std::chrono::steady_clock::now();
+      interpreter::instantiate(options.cores, code, options.verbose, seed);
+      auto elapsed = std::chrono::steady_clock::now() - start;
+
+      size_t allocations = VM::take_allocations();
+      if (options.stats)
+      {
+        fmt::print(
+          std::cerr,
+          "iteration {}: {} ns, {} allocations\n",
+          i,
+          std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+            .count(),
+          allocations);
+      }
+    }
+  }
+
   void instantiate(InterpreterOptions& options, const Code& code)
   {
 #ifdef USE_SYSTEMATIC_TESTING
@@ -77,16 +109,15 @@ namespace verona::interpreter
       }
       else
       {
-        interpreter::instantiate(
-          options.cores, code, options.verbose, options.run_seed.value());
+        instantiate_repeatedly(options, code, options.run_seed.value());
       }
     }
     else
     {
-      interpreter::instantiate(options.cores, code, options.verbose);
+      instantiate_repeatedly(options, code);
     }
 #else
-    interpreter::instantiate(options.cores, code, options.verbose);
+    instantiate_repeatedly(options, code);
 #endif
   }
 }
@@ -11,6 +11,8 @@ namespace verona::interpreter
     uint8_t cores = 4;
     bool verbose = false;
     bool run = false;
+    size_t iterations = 1;
+    bool stats = false;
 #ifdef USE_SYSTEMATIC_TESTING
     std::optional<size_t> run_seed;
     std::optional<size_t> run_seed_upper;
@@ -33,6 +35,14 @@ namespace verona::interpreter
 
     app.add_option("--" + tag + "cores", options.cores);
     app.add_flag("--" + tag + "verbose", options.verbose);
+    app.add_option(
+      "--" + tag + "iterations",
+      options.iterations,
+      "Number of times to run the program");
+    app.add_flag(
+      "--" + tag + "stats",
+      options.stats,
+      "Print the time and allocations of each run to stderr");
 #ifdef USE_SYSTEMATIC_TESTING
     app.add_option("--" + tag + "seed", options.run_seed);
     app.add_option("--" + tag + "seed_upper", options.run_seed_upper);
@@ -379,6 +379,7 @@ namespace verona::interpreter
     check_type(parent, {Value::ISO, Value::MUT});
 
     VMObject* region = parent->object->region();
+    allocations_++;
     rt::Object* object = rt::Region::alloc(alloc_, region, descriptor);
     return Value::mut(new (object) VMObject(region, descriptor));
   }
@@ -387,6 +388,7 @@ namespace verona::interpreter
   {
     // TODO(region): For now, the only kind of region we can create is a trace
     // region. Later, we might need a new bytecode?
+    allocations_++;
     rt::Object* object = rt::RegionTrace::create(alloc_, descriptor);
     return Value::iso(new (object) VMObject(nullptr, descriptor));
   }
@@ -395,11 +397,13 @@ namespace verona::interpreter
   {
     check_type(src, Value::ISO);
     VMObject* contents = src.consume_iso();
+    allocations_++;
     return Value::cown(new VMCown(descriptor, contents));
   }
 
   Value VM::opcode_new_sleeping_cown(const VMDescriptor* descriptor)
   {
+    allocations_++;
     auto a = Value::cown(new VMCown(descriptor));
     trace(" New sleeping cown {}", a);
 
@@ -4,6 +4,7 @@
 
 #include "interpreter/code.h"
 
+#include <atomic>
 #include <fmt/core.h>
 #include <fmt/ostream.h>
 
@@ -22,6 +23,8 @@ namespace verona::interpreter
 
     static void dealloc_vm()
     {
+      total_allocations.fetch_add(
+        local_vm->allocations_, std::memory_order_relaxed);
       delete local_vm;
     }
 
@@ -51,6 +54,18 @@ namespace verona::interpreter
      **/
     static void execute_finaliser(VMObject* object);
 
+    /**
+     * Return the number of objects, regions and cowns allocated by all VMs
+     * since the last call, and reset the count.
+     *
+     * Each VM only adds its own count to the total when its thread exits, so
+     * this should be called after the scheduler has stopped.
+     */
+    static size_t take_allocations()
+    {
+      return total_allocations.exchange(0, std::memory_order_relaxed);
+    }
+
   private:
     Value
     opcode_binop(bytecode::BinaryOperator op, uint64_t left, uint64_t right);
@@ -164,6 +179,13 @@ namespace verona::interpreter
     rt::Alloc* const alloc_;
     const bool verbose_;
 
+    /**
+     * Number of objects, regions and cowns allocated by this VM.
+     */
+    size_t allocations_ = 0;
+
+    static inline std::atomic<size_t> total_allocations{0};
+
     /**
      * Address of the currently executing instruction.
      *
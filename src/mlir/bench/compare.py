@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+
+# Compare the run time of programs executed by the bytecode interpreter with
+# the same programs JIT-compiled from the Verona MLIR dialect.
+#
+# Each benchmark is a pair of files in this directory, NAME.verona and
+# NAME.mlir, which must compute the same result. The Verona file is compiled
+# with veronac and run with the interpreter; the MLIR file is run with
+# `verona-mlir --run`. Times include start-up and compilation.
+
+import argparse
+import glob
+import os
+import os.path
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+parser = argparse.ArgumentParser()
+parser.add_argument("install_dir",
+                    help="Directory containing veronac, interpreter and verona-mlir")
+parser.add_argument("-n", "--repeat", type=int, default=5,
+                    help="Number of runs of each program (default: 5)")
+parser.add_argument("-O", dest="opt", default="3",
+                    help="Optimisation level for verona-mlir (default: 3)")
+args = parser.parse_args()
+
+VERONAC = os.path.join(args.install_dir, "veronac")
+INTERPRETER = os.path.join(args.install_dir, "interpreter")
+MLIRGEN = os.path.join(args.install_dir, "verona-mlir")
+BENCH_DIR = os.path.dirname(os.path.abspath(__file__))
+
+def timed(command):
+  times = []
+  for _ in range(args.repeat):
+    start = time.perf_counter()
+    subprocess.run(command, check=True, stdout=subprocess.DEVNULL)
+    times.append(time.perf_counter() - start)
+  return statistics.median(times)
+
+print("%-20s %12s %12s %8s" % ("Benchmark", "interpreter", "jit", "speedup"))
+with tempfile.TemporaryDirectory() as tmp:
+  for source in sorted(glob.glob(os.path.join(BENCH_DIR, "*.verona"))):
+    name = os.path.splitext(os.path.basename(source))[0]
+    mlir = os.path.join(BENCH_DIR, name + ".mlir")
+    if not os.path.exists(mlir):
+      print("Skipping %s: no %s.mlir" % (name, name), file=sys.stderr)
+      continue
+
+    bytecode = os.path.join(tmp, name + ".vbc")
+    subprocess.run([VERONAC, source, "--output=" + bytecode], check=True)
+
+    interpreted = timed([INTERPRETER, bytecode])
+    jit = timed([MLIRGEN, "--run", "-O" + args.opt, mlir])
+    print("%-20s %11.3fs %11.3fs %7.1fx" %
+          (name, interpreted, jit, interpreted / jit))
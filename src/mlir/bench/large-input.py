@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+
+# Time verona-mlir on large MLIR modules, built by repeating the patterns of
+# the tests in testsuite/mlir: object operations, loops, and copies that
+# exercise subtyping. Each configuration is run on the same module, so the
+# effect of optimisation levels and threading can be compared. Threading only
+# affects the passes nested under func in the -O1 pipeline; the typechecker
+# always runs on the whole module on one thread. Use --pass-timing to also
+# print MLIR's per-pass timing report for each run.
+
+import argparse
+import os
+import statistics
+import subprocess
+import tempfile
+import time
+
+parser = argparse.ArgumentParser()
+parser.add_argument("verona_mlir", help="Path to the verona-mlir binary")
+parser.add_argument("-f", "--functions", type=int, nargs="+",
+                    default=[1000, 4000, 16000],
+                    help="Number of functions in each generated module")
+parser.add_argument("-n", "--repeat", type=int, default=3,
+                    help="Number of runs of each configuration (default: 3)")
+parser.add_argument("--pass-timing", action="store_true",
+                    help="Print the per-pass timing report of each run")
+args = parser.parse_args()
+
+CLASSES = """
+  verona.class @C {
+  }
+
+  verona.class @D {
+    verona.field "f" : !verona.U64
+    verona.field "g" : !verona.S32
+  }
+"""
+
+OBJECTS = """
+  func @objects{0}() {{
+    %a = verona.new_region @C [ ] : !verona.U64
+    %b = verona.view %a : !verona.U64 -> !verona.U64
+    %c = verona.new_object @D [ "f", "g" ] (%b, %b : !verona.U64, !verona.U64) in (%a : !verona.U64) : !verona.S64
+    %d = verona.field_read %c["f"] : !verona.S64 -> !verona.U64
+    verona.field_write %c["f"], %d : !verona.S64 -> !verona.U64 -> !verona.U64
+    verona.tidy %a : !verona.U64
+    verona.drop %a : !verona.U64
+    return
+  }}
+"""
+
+LOOP = """
+  func @loop{0}(%arg0: none) -> none {{
+    %0 = "verona.alloca"() : () -> !type.alloca
+    %1 = "verona.store"(%arg0, %0) : (none, !type.alloca) -> !type.unk
+    verona.while {{
+      %2 = "verona.load"(%0) : (!type.alloca) -> !type.unk
+      %3 = "verona.constant(5)"() : () -> !type.int
+      %4 = "verona.lt"(%2, %3) : (!type.unk, !type.int) -> i1
+      verona.loop_exit %4 : i1
+      %5 = "verona.add"(%2, %3) : (!type.unk, !type.int) -> !type.unk
+      %6 = "verona.store"(%5, %0) : (!type.unk, !type.alloca) -> !type.unk
+      cond_br %4, ^bb1, ^bb2
+    ^bb1:
+      verona.break
+    ^bb2:
+      verona.continue
+    }}
+    %7 = "verona.load"(%0) : (!type.alloca) -> !type.unk
+    %8 = "verona.cast"(%7) : (!type.unk) -> none
+    return %8 : none
+  }}
+"""
+
+SUBTYPING = """
+  func @subtyping{0}(%a: !verona.meet<U64, imm>) {{
+    %b = verona.copy %a : !verona.meet<U64, imm> -> !verona.U64
+    %c = verona.copy %b : !verona.U64 -> !verona.join<U64, S64>
+    %d = verona.copy %c : !verona.join<U64, S64> -> !verona.join<U64, S64, U32>
+    %e = verona.copy %d : !verona.join<U64, S64, U32> -> !verona.join<U32, U64, S64>
+    %f = verona.copy %e : !verona.join<U32, U64, S64> -> !verona.top
+    %g = verona.copy %a : !verona.meet<U64, imm> -> !verona.join<meet<U64, imm>, S64>
+    return
+  }}
+"""
+
+CONFIGURATIONS = [
+  ("typecheck", []),
+  ("-O1", ["-O1"]),
+  ("-O1, 1 thread", ["-O1", "-mlir-disable-threading"]),
+]
+
+def generate(path, functions):
+  templates = [OBJECTS, LOOP, SUBTYPING]
+  with open(path, "w") as f:
+    f.write("module {\n")
+    f.write(CLASSES)
+    for i in range(functions):
+      f.write(templates[i % len(templates)].format(i))
+    f.write("}\n")
+
+def timed(command):
+  times = []
+  for _ in range(args.repeat):
+    start = time.perf_counter()
+    result = subprocess.run(command, check=True, stdout=subprocess.DEVNULL,
+                            stderr=subprocess.PIPE, universal_newlines=True)
+    times.append(time.perf_counter() - start)
+  if args.pass_timing:
+    print(result.stderr)
+  return statistics.median(times)
+
+print("%10s, %-22s, %10s" % ("Functions", "configuration", "time (s)"))
+with tempfile.TemporaryDirectory() as tmp:
+  for functions in args.functions:
+    source = os.path.join(tmp, "large-%d.mlir" % functions)
+    generate(source, functions)
+    for name, flags in CONFIGURATIONS:
+      if args.pass_timing:
+        flags = flags + ["-pass-timing"]
+      command = [args.verona_mlir, source, "-o", os.devnull] + flags
+      print("%10d, %-22s, %10.3f" % (functions, name, timed(command)),
+            flush=True)
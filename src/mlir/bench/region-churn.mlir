@@ -0,0 +1,41 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+// Allocates a small region on every iteration, links objects inside it,
+// collects it and releases it. This is the same program as
+// `region-churn.verona`, whose generated MLIR cannot be executed yet.
+
+module {
+  verona.class @Node {
+    verona.field "next" : !verona.mut
+  }
+
+  func @main() -> i64 {
+    %zero = constant 0 : i64
+    %one = constant 1 : i64
+    %limit = constant 1000000 : i64
+    %counter = alloca() : memref<i64>
+    store %zero, %counter[] : memref<i64>
+
+    verona.while {
+      %i = load %counter[] : memref<i64>
+      %cond = cmpi "slt", %i, %limit : i64
+      verona.loop_exit %cond : i1
+
+      %r = verona.new_region @Node [ ] : !verona.iso
+      %a = verona.new_object @Node [ ] in (%r : !verona.iso) : !verona.mut
+      %b = verona.new_object @Node [ "next" ] (%a : !verona.mut) in (%r : !verona.iso) : !verona.mut
+      %0 = verona.field_write %r["next"], %b : !verona.iso -> !verona.mut -> !verona.mut
+      %c = verona.field_read %r["next"] : !verona.iso -> !verona.mut
+      verona.tidy %r : !verona.iso
+      verona.drop %r : !verona.iso
+
+      %next = addi %i, %one : i64
+      store %next, %counter[] : memref<i64>
+      verona.continue
+    }
+
+    %result = load %counter[] : memref<i64>
+    return %result : i64
+  }
+}
@@ -0,0 +1,188 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include "AliasAnalysis.h"
+
+#include "Typechecker.h"
+#include "VeronaOps.h"
+
+namespace mlir::verona
+{
+  namespace
+  {
+    bool isSubtypeOfCapability(Type type, Capability capability)
+    {
+      Type expected = CapabilityType::get(type.getContext(), capability);
+      return isSubtype(normalizeType(type), expected);
+    }
+
+    bool isInteger(Type type)
+    {
+      type = normalizeType(type);
+      if (auto meet = type.dyn_cast<MeetType>())
+      {
+        return llvm::any_of(meet.getElements(), [](Type element) {
+          return element.isa<verona::IntegerType>();
+        });
+      }
+      return type.isa<verona::IntegerType>();
+    }
+
+    bool isAllocation(Value value)
+    {
+      Operation* op = value.getDefiningOp();
+      return op && isa<AllocateRegionOp, AllocateObjectOp>(op);
+    }
+
+    /// Returns true if every use of `value`, and of the views and copies of
+    /// it, only accesses the object without letting the reference escape.
+    bool isUnescaped(Value value)
+    {
+      for (OpOperand& use : value.getUses())
+      {
+        Operation* user = use.getOwner();
+        if (isa<ViewOp, CopyOp>(user))
+        {
+          if (!isUnescaped(user->getResult(0)))
+            return false;
+        }
+        else if (isa<FieldWriteOp>(user))
+        {
+          // Writing the reference itself into a field lets it escape.
+          if (use.getOperandNumber() != 0)
+            return false;
+        }
+        else if (auto alloc = dyn_cast<AllocateObjectOp>(user))
+        {
+          if (use.get() != alloc.region())
+            return false;
+        }
+        else if (!isa<FieldReadOp, TidyOp, DropOp>(user))
+        {
+          return false;
+        }
+      }
+      return true;
+    }
+  }
+
+  bool mayBeOwned(Type type)
+  {
+    return !isSubtypeOfCapability(type, Capability::Mutable) &&
+      !isSubtypeOfCapability(type, Capability::Immutable) && !isInteger(type);
+  }
+
+  bool isImmutable(Type type)
+  {
+    return isSubtypeOfCapability(type, Capability::Immutable) ||
+      isInteger(type);
+  }
+
+  RegionAliasAnalysis::RegionAliasAnalysis(Operation* op)
+  {
+    ModuleOp module = dyn_cast<ModuleOp>(op);
+    if (!module)
+      module = op->getParentOfType<ModuleOp>();
+    if (module)
+    {
+      for (ClassOp cls : module.getOps<ClassOp>())
+      {
+        for (FieldOp field : cls.body().front().getOps<FieldOp>())
+        {
+          bool sameRegion = !mayBeOwned(field.type());
+          auto [it, inserted] =
+            sameRegionFields.try_emplace(field.name(), sameRegion);
+          if (!inserted)
+            it->second &= sameRegion;
+        }
+      }
+    }
+
+    visit(op);
+  }
+
+  void RegionAliasAnalysis::visit(Operation* op)
+  {
+    if (auto alloc = dyn_cast<AllocateRegionOp>(op))
+    {
+      regions[alloc] = alloc;
+    }
+    else if (auto alloc = dyn_cast<AllocateObjectOp>(op))
+    {
+      if (Value region = getRegion(getRoot(alloc.region())))
+        regions[alloc] = region;
+    }
+    else if (auto read = dyn_cast<FieldReadOp>(op))
+    {
+      // Mutable references held in a field point into the same region,
+      // unless the field may be an `iso` reference to another region. Fields
+      // are not typed by class at the point of the read, so this only holds
+      // if no class declares the field with a type that may be owned.
+      auto field = sameRegionFields.find(read.field());
+      if (
+        field != sameRegionFields.end() && field->second &&
+        isSubtypeOfCapability(read.getType(), Capability::Mutable))
+      {
+        if (Value region = getRegion(getRoot(read.origin())))
+          regions[read] = region;
+      }
+    }
+
+    if (isa<AllocateRegionOp, AllocateObjectOp>(op) &&
+        isUnescaped(op->getResult(0)))
+      unescaped.insert(op->getResult(0));
+
+    // Nested operations are visited after their parent, and blocks in order,
+    // so the region of an allocation's operand is known by the time the
+    // allocation is visited, except across back-edges.
+    for (Region& region : op->getRegions())
+    {
+      for (Block& block : region)
+      {
+        for (BlockArgument arg : block.getArguments())
+        {
+          if (isSubtypeOfCapability(arg.getType(), Capability::Isolated))
+            regions[arg] = arg;
+        }
+        for (Operation& inner : block)
+          visit(&inner);
+      }
+    }
+  }
+
+  Value RegionAliasAnalysis::getRoot(Value value)
+  {
+    while (Operation* op = value.getDefiningOp())
+    {
+      if (!isa<ViewOp, CopyOp>(op))
+        break;
+      value = op->getOperand(0);
+    }
+    return value;
+  }
+
+  Value RegionAliasAnalysis::getRegion(Value root) const
+  {
+    auto it = regions.find(root);
+    return it == regions.end() ? Value() : it->second;
+  }
+
+  bool RegionAliasAnalysis::mayAlias(Value a, Value b) const
+  {
+    a = getRoot(a);
+    b = getRoot(b);
+    if (a == b)
+      return true;
+
+    bool allocA = isAllocation(a);
+    bool allocB = isAllocation(b);
+    if (allocA && allocB)
+      return false;
+    if (unescaped.count(a) || unescaped.count(b))
+      return false;
+
+    Value regionA = getRegion(a);
+    Value regionB = getRegion(b);
+    return !regionA || !regionB || regionA == regionB;
+  }
+}
@@ -0,0 +1,76 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "VeronaTypes.h"
+#include "mlir/IR/Operation.h"
+#include "mlir/IR/Value.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/StringMap.h"
+
+namespace mlir::verona
+{
+  /// Returns true if a value of the given type may be an owned reference,
+  /// which must eventually be dropped or moved.
+  bool mayBeOwned(Type type);
+
+  /// Returns true if every value of the given type is an immutable reference
+  /// or an integer, so the fields it refers to never change.
+  bool isImmutable(Type type);
+
+  /// Alias analysis for Verona references within a function, based on region
+  /// ownership.
+  ///
+  /// References are tracked through `verona.view` and `verona.copy` back to
+  /// their root, the value they were originally derived from. Two references
+  /// may alias unless one of the following holds:
+  /// - Both roots are distinct allocations.
+  /// - One root is an allocation that never escapes, so it can only be
+  ///   referred to through its own views and copies.
+  /// - The roots are known to be in different regions. Each allocation with
+  ///   `verona.new_region` and each `iso` argument is its own region. Objects
+  ///   allocated with `verona.new_object` are in the region of the object
+  ///   they came from, and so are `mut` references read from a field that
+  ///   every class declaring it declares with a type that cannot be owned.
+  ///   An `iso` field refers to a different region.
+  ///
+  /// The analysis is computed once for a function, and may be used through
+  /// MLIR's analysis manager.
+  class RegionAliasAnalysis
+  {
+  public:
+    RegionAliasAnalysis(Operation* op);
+
+    /// Returns the value that `value` was derived from through views and
+    /// copies, or `value` itself if it wasn't.
+    static Value getRoot(Value value);
+
+    /// Returns true if `a` and `b` may refer to the same object.
+    bool mayAlias(Value a, Value b) const;
+
+  private:
+    /// Records the region of the values defined by `op` and by the operations
+    /// nested in it.
+    void visit(Operation* op);
+
+    /// Returns the root of a value that identifies the region containing the
+    /// object `root` refers to, or a null value if it isn't known.
+    Value getRegion(Value root) const;
+
+    /// Allocations whose references are only used to access the allocated
+    /// object's fields, to allocate more objects in its region, or to drop
+    /// it.
+    llvm::DenseSet<Value> unescaped;
+
+    /// Regions known for allocations and arguments, indexed by root.
+    llvm::DenseMap<Value, Value> regions;
+
+    /// For each field name declared by a class in the enclosing module,
+    /// whether every declaration of it has a type that cannot be owned, so
+    /// that the field always refers into the region of its object.
+    llvm::StringMap<bool> sameRegionFields;
+  };
+}
@@ -0,0 +1,574 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include "Lowering.h"
+
+#include "Typechecker.h"
+#include "VeronaDialect.h"
+#include "VeronaOps.h"
+#include "VeronaTypes.h"
+#include "mlir/Conversion/StandardToLLVM/ConvertStandardToLLVMPass.h"
+#include "mlir/Dialect/StandardOps/IR/Ops.h"
+#include "mlir/Transforms/DialectConversion.h"
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/StringMap.h"
+
+namespace mlir::verona
+{
+  namespace
+  {
+    /// Names of the runtime entry points that lowered code calls. Their
+    /// definitions live in the `verona-mlir` runtime support, and all of
+    /// their arguments and results are 64-bit integers.
+    namespace runtime
+    {
+      constexpr llvm::StringLiteral newRegion = "verona_rt_new_region";
+      constexpr llvm::StringLiteral newObject = "verona_rt_new_object";
+      constexpr llvm::StringLiteral fieldRead = "verona_rt_field_read";
+      constexpr llvm::StringLiteral fieldWrite = "verona_rt_field_write";
+      constexpr llvm::StringLiteral tidy = "verona_rt_tidy";
+      constexpr llvm::StringLiteral drop = "verona_rt_drop";
+    }
+
+    /// The runtime representation of a class.
+    struct ClassLayout
+    {
+      /// Index of the class, used by the runtime to cache its descriptor.
+      int64_t id;
+      /// Number of slots in objects of the class.
+      int64_t slots;
+      /// Bit `i` is set if slot `i` holds a reference.
+      uint64_t referenceMask;
+    };
+
+    struct ObjectLayout
+    {
+      llvm::StringMap<ClassLayout> classes;
+      llvm::StringMap<unsigned> fieldSlots;
+    };
+
+    /// Returns true if the conjunct of a normalised type is an integer.
+    bool isScalarConjunct(Type type)
+    {
+      if (auto meet = type.dyn_cast<MeetType>())
+      {
+        return llvm::any_of(
+          meet.getElements(), [](Type e) { return e.isa<IntegerType>(); });
+      }
+      return type.isa<IntegerType>();
+    }
+
+    /// Returns whether values of `type` are references, or None if some
+    /// values of the type are references and others are integers. The runtime
+    /// could not tell them apart when tracing.
+    llvm::Optional<bool> isReferenceType(Type type)
+    {
+      type = normalizeType(type);
+      auto join = type.dyn_cast<JoinType>();
+      if (!join)
+        return !isScalarConjunct(type);
+
+      llvm::ArrayRef<Type> elements = join.getElements();
+      if (elements.empty())
+        return true;
+
+      bool scalar = isScalarConjunct(elements.front());
+      if (llvm::any_of(elements, [&](Type e) {
+            return isScalarConjunct(e) != scalar;
+          }))
+      {
+        return llvm::None;
+      }
+      return !scalar;
+    }
+
+    /// Assign a slot to every field name, and compute the layout of each
+    /// class.
+    ///
+    /// Field names are coloured greedily, in order of first appearance: a
+    /// field takes the lowest slot that no other field of a class defining it
+    /// already uses.
+    LogicalResult computeLayout(ModuleOp module, ObjectLayout& layout)
+    {
+      llvm::MapVector<StringRef, SmallVector<ClassOp, 4>> definedIn;
+      llvm::DenseMap<Operation*, llvm::BitVector> usedSlots;
+      for (ClassOp cls : module.getOps<ClassOp>())
+      {
+        usedSlots[cls];
+        for (FieldOp field : cls.body().front().getOps<FieldOp>())
+          definedIn[field.name()].push_back(cls);
+      }
+
+      for (auto& [name, classes] : definedIn)
+      {
+        llvm::BitVector forbidden;
+        for (ClassOp cls : classes)
+          forbidden |= usedSlots[cls];
+
+        int slot = forbidden.find_first_unset();
+        unsigned index = slot < 0 ? forbidden.size() : slot;
+        for (ClassOp cls : classes)
+        {
+          llvm::BitVector& used = usedSlots[cls];
+          if (used.size() <= index)
+            used.resize(index + 1);
+          used.set(index);
+        }
+        layout.fieldSlots[name] = index;
+      }
+
+      int64_t id = 0;
+      for (ClassOp cls : module.getOps<ClassOp>())
+      {
+        ClassLayout& result = layout.classes[cls.sym_name()];
+        result.id = id++;
+        result.slots = usedSlots[cls].size();
+        result.referenceMask = 0;
+        for (FieldOp field : cls.body().front().getOps<FieldOp>())
+        {
+          unsigned slot = layout.fieldSlots[field.name()];
+          if (slot >= 64)
+            return field.emitError("too many fields to lower");
+
+          llvm::Optional<bool> reference = isReferenceType(field.type());
+          if (!reference)
+          {
+            return field.emitError(
+              "cannot lower a field that may hold both integers and "
+              "references");
+          }
+          if (*reference)
+            result.referenceMask |= uint64_t(1) << slot;
+        }
+      }
+      return success();
+    }
+
+    /// Declare the runtime entry points, so lowered operations can call them.
+    void declareRuntime(ModuleOp module)
+    {
+      Builder builder(module.getContext());
+      Type i64 = builder.getIntegerType(64);
+      auto declare = [&](StringRef name, unsigned inputs, bool hasResult) {
+        if (module.lookupSymbol(name))
+          return;
+        SmallVector<Type, 4> inputTypes(inputs, i64);
+        SmallVector<Type, 1> resultTypes;
+        if (hasResult)
+          resultTypes.push_back(i64);
+        module.push_back(FuncOp::create(
+          module.getLoc(),
+          name,
+          builder.getFunctionType(inputTypes, resultTypes)));
+      };
+
+      declare(runtime::newRegion, 3, true);
+      declare(runtime::newObject, 4, true);
+      declare(runtime::fieldRead, 2, true);
+      declare(runtime::fieldWrite, 3, true);
+      declare(runtime::tidy, 1, false);
+      declare(runtime::drop, 1, false);
+    }
+
+    /// Base class for patterns that lower an operation to runtime calls.
+    template<typename Op>
+    class RuntimeLowering : public OpConversionPattern<Op>
+    {
+    public:
+      RuntimeLowering(MLIRContext* context, const ObjectLayout& layout)
+      : OpConversionPattern<Op>(context), layout(layout)
+      {}
+
+    protected:
+      const ObjectLayout& layout;
+
+      static Value
+      constant(ConversionPatternRewriter& rewriter, Location loc, int64_t n)
+      {
+        return rewriter.create<ConstantIntOp>(loc, n, 64);
+      }
+
+      static Value call(
+        ConversionPatternRewriter& rewriter,
+        Location loc,
+        StringRef name,
+        ValueRange operands,
+        bool hasResult = true)
+      {
+        SmallVector<Type, 1> results;
+        if (hasResult)
+          results.push_back(rewriter.getIntegerType(64));
+        Operation* op = rewriter.create<CallOp>(loc, name, results, operands);
+        return hasResult ? op->getResult(0) : Value();
+      }
+
+      /// Find the slot of the field `name`, emitting an error on `op` if no
+      /// class defines it.
+      llvm::Optional<int64_t> slot(Operation* op, StringRef name) const
+      {
+        auto it = layout.fieldSlots.find(name);
+        if (it == layout.fieldSlots.end())
+        {
+          op->emitError("no class defines field '") << name << "'";
+          return llvm::None;
+        }
+        return it->second;
+      }
+
+      /// Allocate an object of class `className`, by calling the runtime
+      /// function `name` with `prefix` followed by the class layout, and then
+      /// initialise its fields.
+      Value allocate(
+        ConversionPatternRewriter& rewriter,
+        Operation* op,
+        StringRef name,
+        ValueRange prefix,
+        SymbolRefAttr className,
+        ArrayAttr fieldNames,
+        ValueRange fields) const
+      {
+        Location loc = op->getLoc();
+        auto cls = layout.classes.find(className.getRootReference());
+        if (cls == layout.classes.end())
+        {
+          op->emitError("unknown class ") << className;
+          return Value();
+        }
+
+        SmallVector<Value, 4> operands(prefix.begin(), prefix.end());
+        operands.push_back(constant(rewriter, loc, cls->second.id));
+        operands.push_back(constant(rewriter, loc, cls->second.slots));
+        operands.push_back(
+          constant(rewriter, loc, int64_t(cls->second.referenceMask)));
+        Value object = call(rewriter, loc, name, operands);
+
+        for (auto [fieldName, value] : llvm::zip(fieldNames, fields))
+        {
+          auto index = slot(op, fieldName.cast<StringAttr>().getValue());
+          if (!index)
+            return Value();
+          call(
+            rewriter,
+            loc,
+            runtime::fieldWrite,
+            {object, constant(rewriter, loc, *index), value});
+        }
+        return object;
+      }
+    };
+
+    class NewRegionLowering : public RuntimeLowering<AllocateRegionOp>
+    {
+      using RuntimeLowering::RuntimeLowering;
+
+      LogicalResult matchAndRewrite(
+        AllocateRegionOp op,
+        ArrayRef<Value> operands,
+        ConversionPatternRewriter& rewriter) const override
+      {
+        Value object = allocate(
+          rewriter,
+          op,
+          runtime::newRegion,
+          llvm::None,
+          op.class_name(),
+          op.field_names(),
+          operands);
+        if (!object)
+          return failure();
+        rewriter.replaceOp(op, object);
+        return success();
+      }
+    };
+
+    class NewObjectLowering : public RuntimeLowering<AllocateObjectOp>
+    {
+      using RuntimeLowering::RuntimeLowering;
+
+      LogicalResult matchAndRewrite(
+        AllocateObjectOp op,
+        ArrayRef<Value> operands,
+        ConversionPatternRewriter& rewriter) const override
+      {
+        // The region operand follows the variadic field values.
+        Value object = allocate(
+          rewriter,
+          op,
+          runtime::newObject,
+          operands.back(),
+          op.class_name(),
+          op.field_names(),
+          operands.drop_back());
+        if (!object)
+          return failure();
+        rewriter.replaceOp(op, object);
+        return success();
+      }
+    };
+
+    class FieldReadLowering : public RuntimeLowering<FieldReadOp>
+    {
+      using RuntimeLowering::RuntimeLowering;
+
+      LogicalResult matchAndRewrite(
+        FieldReadOp op,
+        ArrayRef<Value> operands,
+        ConversionPatternRewriter& rewriter) const override
+      {
+        auto index = slot(op, op.field());
+        if (!index)
+          return failure();
+        Location loc = op.getLoc();
+        rewriter.replaceOp(
+          op,
+          call(
+            rewriter,
+            loc,
+            runtime::fieldRead,
+            {operands[0], constant(rewriter, loc, *index)}));
+        return success();
+      }
+    };
+
+    class FieldWriteLowering : public RuntimeLowering<FieldWriteOp>
+    {
+      using RuntimeLowering::RuntimeLowering;
+
+      LogicalResult matchAndRewrite(
+        FieldWriteOp op,
+        ArrayRef<Value> operands,
+        ConversionPatternRewriter& rewriter) const override
+      {
+        auto index = slot(op, op.field());
+        if (!index)
+          return failure();
+        Location loc = op.getLoc();
+        rewriter.replaceOp(
+          op,
+          call(
+            rewriter,
+            loc,
+            runtime::fieldWrite,
+            {operands[0], constant(rewriter, loc, *index), operands[1]}));
+        return success();
+      }
+    };
+
+    class TidyLowering : public RuntimeLowering<TidyOp>
+    {
+      using RuntimeLowering::RuntimeLowering;
+
+      LogicalResult matchAndRewrite(
+        TidyOp op,
+        ArrayRef<Value> operands,
+        ConversionPatternRewriter& rewriter) const override
+      {
+        call(rewriter, op.getLoc(), runtime::tidy, operands[0], false);
+        rewriter.eraseOp(op);
+        return success();
+      }
+    };
+
+    class DropLowering : public RuntimeLowering<DropOp>
+    {
+      using RuntimeLowering::RuntimeLowering;
+
+      LogicalResult matchAndRewrite(
+        DropOp op,
+        ArrayRef<Value> operands,
+        ConversionPatternRewriter& rewriter) const override
+      {
+        // Only an owned reference keeps its region alive. Dropping any other
+        // value has no runtime effect.
+        Type iso = CapabilityType::get(op.getContext(), Capability::Isolated);
+        if (isSubtype(normalizeType(op.region().getType()), iso))
+          call(rewriter, op.getLoc(), runtime::drop, operands[0], false);
+        rewriter.eraseOp(op);
+        return success();
+      }
+    };
+
+    /// Lowers an operation whose result is the same reference as its operand.
+    template<typename Op>
+    class ForwardLowering : public OpConversionPattern<Op>
+    {
+      using OpConversionPattern<Op>::OpConversionPattern;
+
+      LogicalResult matchAndRewrite(
+        Op op,
+        ArrayRef<Value> operands,
+        ConversionPatternRewriter& rewriter) const override
+      {
+        rewriter.replaceOp(op, operands[0]);
+        return success();
+      }
+    };
+
+    /// Rebuilds a `return` whose operands have Verona types.
+    class ReturnLowering : public OpConversionPattern<ReturnOp>
+    {
+      using OpConversionPattern::OpConversionPattern;
+
+      LogicalResult matchAndRewrite(
+        ReturnOp op,
+        ArrayRef<Value> operands,
+        ConversionPatternRewriter& rewriter) const override
+      {
+        rewriter.replaceOpWithNewOp<ReturnOp>(op, operands);
+        return success();
+      }
+    };
+
+    /// Rebuilds a call whose operands or results have Verona types.
+    class CallLowering : public OpConversionPattern<CallOp>
+    {
+    public:
+      CallLowering(MLIRContext* context, TypeConverter& converter)
+      : OpConversionPattern(context), converter(converter)
+      {}
+
+    private:
+      TypeConverter& converter;
+
+      LogicalResult matchAndRewrite(
+        CallOp op,
+        ArrayRef<Value> operands,
+        ConversionPatternRewriter& rewriter) const override
+      {
+        SmallVector<Type, 1> results;
+        for (Type type : op.getOperation()->getResultTypes())
+          results.push_back(converter.convertType(type));
+        rewriter.replaceOpWithNewOp<CallOp>(
+          op, op.getCallee(), results, operands);
+        return success();
+      }
+    };
+  }
+
+  void LowerLoopsPass::runOnFunction()
+  {
+    // Walks are post-order, so inner loops come before the loops that
+    // contain them. The loops are collected first since lowering splits the
+    // blocks that the walk would be iterating over.
+    SmallVector<WhileOp, 4> loops;
+    getFunction().walk([&](WhileOp loop) { loops.push_back(loop); });
+
+    OpBuilder builder(&getContext());
+    ValueRange empty{};
+    for (WhileOp loop : loops)
+    {
+      Location loc = loop.getLoc();
+      Block* before = loop.getOperation()->getBlock();
+      Block* after =
+        before->splitBlock(std::next(Block::iterator(loop.getOperation())));
+
+      // Move the body between the code before and after the loop.
+      Block* header = &loop.body().front();
+      before->getParent()->getBlocks().splice(
+        Region::iterator(after), loop.body().getBlocks());
+      builder.setInsertionPointToEnd(before);
+      builder.create<BranchOp>(loc, header, empty);
+      loop.erase();
+
+      SmallVector<Operation*, 8> control;
+      for (Block* block = header; block != after; block = block->getNextNode())
+      {
+        for (Operation& op : *block)
+        {
+          if (isa<ContinueOp, BreakOp, LoopExitOp, LoopReturnOp>(op))
+            control.push_back(&op);
+        }
+      }
+
+      for (Operation* op : control)
+      {
+        builder.setInsertionPoint(op);
+        if (isa<ContinueOp>(op))
+        {
+          builder.create<BranchOp>(op->getLoc(), header, empty);
+        }
+        else if (isa<BreakOp>(op))
+        {
+          builder.create<BranchOp>(op->getLoc(), after, empty);
+        }
+        else if (isa<LoopReturnOp>(op))
+        {
+          builder.create<ReturnOp>(op->getLoc(), op->getOperands());
+        }
+        else
+        {
+          // The loop carries on in a new block if the condition holds.
+          Block* block = op->getBlock();
+          Block* rest = block->splitBlock(std::next(Block::iterator(op)));
+          builder.setInsertionPointToEnd(block);
+          builder.create<CondBranchOp>(
+            op->getLoc(), op->getOperand(0), rest, empty, after, empty);
+        }
+        op->erase();
+      }
+    }
+  }
+
+  void LowerObjectsPass::runOnOperation()
+  {
+    ModuleOp module = getOperation();
+    MLIRContext* context = &getContext();
+
+    ObjectLayout layout;
+    if (failed(computeLayout(module, layout)))
+      return signalPassFailure();
+
+    // Class definitions only describe the layout, which is now encoded in the
+    // runtime calls.
+    for (ClassOp cls : llvm::make_early_inc_range(module.getOps<ClassOp>()))
+      cls.erase();
+    declareRuntime(module);
+
+    TypeConverter converter;
+    converter.addConversion([](Type type) { return type; });
+    converter.addConversion([](Type type) -> llvm::Optional<Type> {
+      if (isaVeronaType(type))
+        return mlir::IntegerType::get(64, type.getContext());
+      return llvm::None;
+    });
+    auto isLegal = [&](Operation* op) {
+      auto legal = [&](Type type) { return converter.isLegal(type); };
+      return llvm::all_of(op->getOperandTypes(), legal) &&
+        llvm::all_of(op->getResultTypes(), legal);
+    };
+
+    ConversionTarget target(*context);
+    target.addLegalDialect<StandardOpsDialect>();
+    target.addLegalOp<ModuleOp, ModuleTerminatorOp>();
+    target.addIllegalDialect<VeronaDialect>();
+    target.addDynamicallyLegalOp<FuncOp>(
+      [&](FuncOp op) { return converter.isSignatureLegal(op.getType()); });
+    target.addDynamicallyLegalOp<ReturnOp, CallOp>(isLegal);
+
+    OwningRewritePatternList patterns;
+    patterns.insert<
+      NewRegionLowering,
+      NewObjectLowering,
+      FieldReadLowering,
+      FieldWriteLowering,
+      TidyLowering,
+      DropLowering>(context, layout);
+    patterns.insert<ForwardLowering<CopyOp>, ForwardLowering<ViewOp>>(
+      context);
+    patterns.insert<ReturnLowering>(context);
+    patterns.insert<CallLowering>(context, converter);
+    populateFuncOpTypeConversionPattern(patterns, context, converter);
+
+    if (failed(applyPartialConversion(module, target, patterns)))
+      signalPassFailure();
+  }
+
+  void addLLVMLoweringPasses(OpPassManager& pm)
+  {
+    pm.nest<FuncOp>().addPass(std::make_unique<LowerLoopsPass>());
+    pm.addPass(std::make_unique<LowerObjectsPass>());
+    pm.addPass(createLowerToLLVMPass());
+  }
+}
@@ -0,0 +1,50 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "mlir/IR/Function.h"
+#include "mlir/IR/Module.h"
+#include "mlir/Pass/Pass.h"
+
+namespace mlir::verona
+{
+  /// Replace `verona.while` loops with explicit control flow, using the
+  /// standard dialect's branches.
+  ///
+  /// The body of the loop is inlined into the enclosing function. Its entry
+  /// block becomes the loop header, which `verona.continue` branches back to.
+  /// `verona.break` and a failing `verona.loop_exit` branch to the code that
+  /// followed the loop, and `verona.loop_return` becomes a `return`.
+  ///
+  /// Nested loops are lowered innermost first, so any control flow operation
+  /// left in a loop's body when it is lowered belongs to that loop.
+  class LowerLoopsPass : public PassWrapper<LowerLoopsPass, FunctionPass>
+  {
+    void runOnFunction() override;
+  };
+
+  /// Replace Verona object operations with calls into the runtime, and Verona
+  /// types with `i64`.
+  ///
+  /// References are passed to and from the runtime as integers. The object
+  /// layout is owned by the runtime: each object has one 64-bit slot per
+  /// field, and fields are accessed through calls. Since Verona values do not
+  /// carry their class, slots are assigned by field name, such that no two
+  /// fields of the same class share a slot. A field therefore has the same
+  /// slot in every class that defines it.
+  ///
+  /// `verona.copy` and `verona.view` have no runtime effect. `verona.drop`
+  /// releases the region only if the value is an `iso` reference.
+  ///
+  /// Loops must have been lowered with `LowerLoopsPass` first.
+  class LowerObjectsPass
+  : public PassWrapper<LowerObjectsPass, OperationPass<ModuleOp>>
+  {
+    void runOnOperation() override;
+  };
+
+  /// Add the passes needed to lower a Verona module all the way to the LLVM
+  /// dialect, so it can be translated to LLVM IR or executed.
+  void addLLVMLoweringPasses(OpPassManager& pm);
+}
@@ -0,0 +1,219 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include "Optimizations.h"
+
+#include "AliasAnalysis.h"
+#include "VeronaOps.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
+
+#include "llvm/ADT/SetVector.h"
+
+namespace mlir::verona
+{
+  namespace
+  {
+    /// A value known to be stored in a field of an object.
+    struct KnownField
+    {
+      /// Root of the reference the object was accessed through.
+      Value root;
+      StringRef field;
+      Value value;
+      /// The object was accessed through an immutable reference, so the field
+      /// can never change.
+      bool immutable;
+    };
+
+    /// The values known to be stored in fields at some point of a block.
+    class KnownFields
+    {
+    public:
+      KnownFields(const RegionAliasAnalysis& analysis) : analysis(analysis) {}
+
+      Value lookup(Value origin, StringRef field) const
+      {
+        Value root = RegionAliasAnalysis::getRoot(origin);
+        for (const KnownField& known : fields)
+        {
+          if (known.root == root && known.field == field)
+            return known.value;
+        }
+        return Value();
+      }
+
+      void insert(Value origin, StringRef field, Value value)
+      {
+        Value root = RegionAliasAnalysis::getRoot(origin);
+        fields.push_back({root, field, value, isImmutable(origin.getType())});
+      }
+
+      /// Forget the values of `field` in any object that `origin` may refer
+      /// to.
+      void write(Value origin, StringRef field)
+      {
+        llvm::erase_if(fields, [&](const KnownField& known) {
+          return !known.immutable && known.field == field &&
+            analysis.mayAlias(known.root, origin);
+        });
+      }
+
+      /// Forget the values of every field that may change.
+      void clobber()
+      {
+        llvm::erase_if(
+          fields, [](const KnownField& known) { return !known.immutable; });
+      }
+
+    private:
+      const RegionAliasAnalysis& analysis;
+      SmallVector<KnownField, 8> fields;
+    };
+
+    /// Returns true if `op` cannot change the contents of any field.
+    bool preservesFields(Operation* op)
+    {
+      // Tidying a region only deallocates objects that are unreachable, and
+      // dropping a reference makes any object it owns unreachable, so neither
+      // affects the fields of objects that can still be accessed.
+      if (isa<ViewOp, CopyOp, TidyOp, DropOp>(op))
+        return true;
+
+      if (op->getNumRegions() > 0)
+        return false;
+
+      auto effects = dyn_cast<MemoryEffectOpInterface>(op);
+      return effects && effects.hasNoEffect();
+    }
+
+    void eliminateRedundantReads(
+      Block& block, const RegionAliasAnalysis& analysis, unsigned& eliminated)
+    {
+      KnownFields known(analysis);
+      OpBuilder builder(block.getParent()->getContext());
+
+      for (Operation& op : llvm::make_early_inc_range(block))
+      {
+        if (auto read = dyn_cast<FieldReadOp>(op))
+        {
+          Value value = known.lookup(read.origin(), read.field());
+          if (!value)
+          {
+            known.insert(read.origin(), read.field(), read.output());
+            continue;
+          }
+
+          if (value.getType() != read.getType())
+          {
+            builder.setInsertionPoint(read);
+            value =
+              builder.create<ViewOp>(read.getLoc(), read.getType(), value);
+          }
+          read.replaceAllUsesWith(value);
+          read.erase();
+          eliminated++;
+        }
+        else if (auto write = dyn_cast<FieldWriteOp>(op))
+        {
+          known.write(write.origin(), write.field());
+          known.insert(write.origin(), write.field(), write.value());
+        }
+        else if (auto alloc = dyn_cast<AllocateRegionOp>(op))
+        {
+          for (auto [name, value] :
+               llvm::zip(alloc.field_names(), alloc.fields()))
+            known.insert(alloc, name.cast<StringAttr>().getValue(), value);
+        }
+        else if (auto alloc = dyn_cast<AllocateObjectOp>(op))
+        {
+          for (auto [name, value] :
+               llvm::zip(alloc.field_names(), alloc.fields()))
+            known.insert(alloc, name.cast<StringAttr>().getValue(), value);
+        }
+        else if (!preservesFields(&op))
+        {
+          known.clobber();
+        }
+      }
+    }
+
+    /// Collect the operations that make up the uses of `value`, if they are
+    /// all drops, or views and copies whose uses are all drops. Uses come after
+    /// the operation they use in `ops`.
+    bool collectDrops(Value value, llvm::SetVector<Operation*>& ops)
+    {
+      for (Operation* user : value.getUsers())
+      {
+        if (isa<DropOp>(user))
+          ops.insert(user);
+        else if (isa<ViewOp, CopyOp>(user))
+        {
+          ops.insert(user);
+          if (!collectDrops(user->getResult(0), ops))
+            return false;
+        }
+        else
+          return false;
+      }
+      return true;
+    }
+  }
+
+  void RedundantReadEliminationPass::runOnFunction()
+  {
+    const RegionAliasAnalysis& analysis = getAnalysis<RegionAliasAnalysis>();
+
+    // Blocks are collected first, since eliminating reads modifies them.
+    SmallVector<Block*, 8> blocks;
+    getFunction().walk([&](Operation* op) {
+      for (Region& region : op->getRegions())
+      {
+        for (Block& block : region)
+          blocks.push_back(&block);
+      }
+    });
+
+    unsigned eliminated = 0;
+    for (Block* block : blocks)
+      eliminateRedundantReads(*block, analysis, eliminated);
+    readsEliminated += eliminated;
+
+    if (eliminated == 0)
+      markAllAnalysesPreserved();
+  }
+
+  void DeadAllocationEliminationPass::runOnFunction()
+  {
+    SmallVector<Operation*, 8> allocations;
+    getFunction().walk([&](Operation* op) {
+      if (isa<AllocateRegionOp, AllocateObjectOp>(op))
+        allocations.push_back(op);
+    });
+
+    // Allocations are visited in reverse, so that removing an allocation can
+    // make the allocations it used as field values dead too.
+    unsigned eliminated = 0;
+    for (Operation* alloc : llvm::reverse(allocations))
+    {
+      Operation::operand_range fields = isa<AllocateRegionOp>(alloc) ?
+        cast<AllocateRegionOp>(alloc).fields() :
+        cast<AllocateObjectOp>(alloc).fields();
+      if (llvm::any_of(
+            fields, [](Value field) { return mayBeOwned(field.getType()); }))
+        continue;
+
+      llvm::SetVector<Operation*> ops;
+      if (!collectDrops(alloc->getResult(0), ops))
+        continue;
+
+      for (Operation* op : llvm::reverse(ops))
+        op->erase();
+      alloc->erase();
+      eliminated++;
+    }
+    allocationsEliminated += eliminated;
+
+    if (eliminated == 0)
+      markAllAnalysesPreserved();
+  }
+}
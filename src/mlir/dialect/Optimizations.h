@@ -0,0 +1,61 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "mlir/IR/Function.h"
+#include "mlir/Pass/Pass.h"
+
+namespace mlir::verona
+{
+  /// Replace a `verona.field_read` with a value that is already known to be
+  /// stored in the field.
+  ///
+  /// Values become known by reading a field, by writing it, or by allocating
+  /// an object with the field initialised. A `verona.field_write` forgets the
+  /// values known for the same field of any reference that may alias the one
+  /// being written to, according to `RegionAliasAnalysis`. Any operation with
+  /// unknown side-effects forgets every known value, except those read through
+  /// immutable references.
+  ///
+  /// Values are only reused within a block. If the type of the read differs
+  /// from the type of the known value, a `verona.view` of the value is used.
+  class RedundantReadEliminationPass
+  : public PassWrapper<RedundantReadEliminationPass, FunctionPass>
+  {
+  public:
+    RedundantReadEliminationPass() = default;
+    RedundantReadEliminationPass(const RedundantReadEliminationPass& other)
+    : PassWrapper(other)
+    {}
+
+  private:
+    void runOnFunction() override;
+
+    Statistic readsEliminated{
+      this, "reads-eliminated", "Field reads replaced with a known value"};
+  };
+
+  /// Remove allocations whose result is only ever dropped, along with the
+  /// `verona.drop` operations.
+  ///
+  /// Views and copies of the allocation are followed, and removed as well. An
+  /// allocation is kept if any of the values it initialises its fields with
+  /// may be an owned reference, since dropping the object would have released
+  /// the region it owns.
+  class DeadAllocationEliminationPass
+  : public PassWrapper<DeadAllocationEliminationPass, FunctionPass>
+  {
+  public:
+    DeadAllocationEliminationPass() = default;
+    DeadAllocationEliminationPass(const DeadAllocationEliminationPass& other)
+    : PassWrapper(other)
+    {}
+
+  private:
+    void runOnFunction() override;
+
+    Statistic allocationsEliminated{
+      this, "allocations-eliminated", "Allocations removed"};
+  };
+}
@@ -6,10 +6,29 @@
 #include "TypecheckInterface.h"
 #include "VeronaTypes.h"
 
+#include <algorithm>
+#include <climits>
+
 namespace mlir::verona
 {
+  namespace
+  {
+    /// The cache used by `isSubtype` on the current thread, if any.
+    thread_local SubtypingCache* activeCache = nullptr;
+
+    /// Marker for proven judgements that do not depend on any assumption.
+    constexpr unsigned NO_ASSUMPTION = UINT_MAX;
+  }
+
   LogicalResult typecheck(Operation* op)
   {
+    SubtypingCache cache;
+    return typecheck(op, cache);
+  }
+
+  LogicalResult typecheck(Operation* op, SubtypingCache& cache)
+  {
+    SubtypingCache::Scope scope(cache);
     auto callback = [](TypecheckInterface innerOp) -> WalkResult {
       // If typecheck fails, WalkResult::interrupt is returned.
       return innerOp.typecheck();
@@ -23,10 +42,14 @@ namespace mlir::verona
 
   void TypecheckerPass::runOnOperation()
   {
-    if (failed(typecheck(getOperation())))
+    unsigned hits = cache.getHits();
+    unsigned misses = cache.getMisses();
+    if (failed(typecheck(getOperation(), cache)))
     {
       signalPassFailure();
     }
+    cacheHits += cache.getHits() - hits;
+    cacheMisses += cache.getMisses() - misses;
 
     // Typechecking does not modify the IR, so all analysis are preserved.
     markAllAnalysesPreserved();
@@ -144,7 +167,95 @@ namespace mlir::verona
     assert(isaVeronaType(lhs));
     assert(isaVeronaType(rhs));
 
-    return RULES(lhs, rhs);
+    if (activeCache != nullptr)
+      return activeCache->isSubtype(lhs, rhs);
+
+    SubtypingCache cache;
+    return cache.isSubtype(lhs, rhs);
+  }
+
+  SubtypingCache::Scope::Scope(SubtypingCache& cache) : previous(activeCache)
+  {
+    activeCache = &cache;
+  }
+
+  SubtypingCache::Scope::~Scope()
+  {
+    activeCache = previous;
+  }
+
+  bool SubtypingCache::isSubtype(Type lhs, Type rhs)
+  {
+    auto it = entries.find({lhs, rhs});
+    if (it == entries.end())
+    {
+      misses++;
+      return derive({lhs, rhs});
+    }
+
+    hits++;
+    switch (it->second.state)
+    {
+      case State::Refuted:
+        return false;
+
+      case State::InProgress:
+      case State::Proven:
+        // Either we are assuming that an in-progress judgement holds, or
+        // reusing a result that may itself rely on such an assumption. Either
+        // way, the judgement currently being derived inherits the dependency.
+        if (!stack.empty())
+          stack.back() = std::min(stack.back(), it->second.depth);
+        return true;
+    }
+    llvm_unreachable("Invalid subtyping cache state");
+  }
+
+  bool SubtypingCache::derive(Judgement judgement)
+  {
+    unsigned depth = stack.size();
+    size_t mark = provisional.size();
+    entries[judgement] = {State::InProgress, depth};
+    stack.push_back(NO_ASSUMPTION);
+
+    bool result;
+    {
+      // Make sure the recursive calls made by the rules come back to us.
+      Scope scope(*this);
+      result = RULES(judgement.first, judgement.second);
+    }
+    unsigned assumption = stack.pop_back_val();
+
+    if (!result)
+    {
+      // Judgements proven since we started may have assumed that this one
+      // holds, so they can no longer be trusted. A refutation, on the other
+      // hand, is valid even under assumptions, since assuming that a
+      // judgement holds can only make more judgements hold.
+      for (const Judgement& dependent : llvm::drop_begin(provisional, mark))
+        entries.erase(dependent);
+      provisional.resize(mark);
+      entries[judgement] = {State::Refuted, NO_ASSUMPTION};
+      return false;
+    }
+
+    if (assumption < depth)
+    {
+      // This result depends on a judgement further up the stack. Keep it
+      // provisionally until that one has been decided.
+      entries[judgement] = {State::Proven, assumption};
+      provisional.push_back(judgement);
+      stack.back() = std::min(stack.back(), assumption);
+      return true;
+    }
+
+    // Every assumption made since we started has now been discharged, so all
+    // of the provisional results since then are final.
+    for (const Judgement& dependent : llvm::drop_begin(provisional, mark))
+      entries[dependent] = {State::Proven, NO_ASSUMPTION};
+    provisional.resize(mark);
+    entries[judgement] = {State::Proven, NO_ASSUMPTION};
+    return true;
   }
 
   LogicalResult checkSubtype(Operation* op, Type lhs, Type rhs)
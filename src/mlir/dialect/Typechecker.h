@@ -4,26 +4,146 @@
 #include "mlir/IR/OpDefinition.h"
 #include "mlir/Pass/Pass.h"
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+
 namespace mlir::verona
 {
+  /// Memoises subtyping judgements.
+  ///
+  /// MLIR types are uniqued, so a `(Type, Type)` pair is a cheap key, and the
+  /// subtyping relation between two types never changes. Programs that use
+  /// unions and intersections heavily check the same judgements many times,
+  /// which this avoids.
+  ///
+  /// Judgements are checked coinductively: if checking `A <: B` requires
+  /// checking `A <: B` again, the inner check assumes that it holds. A result
+  /// that depends on such an assumption is kept provisionally, and is only
+  /// committed to the cache once the judgement that was assumed has been
+  /// proven. If it is refuted, the provisional results are discarded.
+  ///
+  /// A cache is not thread-safe. Each thread must use its own.
+  class SubtypingCache
+  {
+  public:
+    /// Returns true if `lhs` is a subtype of `rhs`. Both types should be in
+    /// normal form already.
+    bool isSubtype(Type lhs, Type rhs);
+
+    /// Number of judgements that were answered from the cache.
+    unsigned getHits() const
+    {
+      return hits;
+    }
+
+    /// Number of judgements that had to be derived.
+    unsigned getMisses() const
+    {
+      return misses;
+    }
+
+    /// While a Scope is alive, calls to the free-standing `isSubtype` function
+    /// on the current thread use the given cache.
+    class Scope
+    {
+    public:
+      Scope(SubtypingCache& cache);
+      ~Scope();
+
+    private:
+      SubtypingCache* previous;
+    };
+
+  private:
+    using Judgement = std::pair<Type, Type>;
+
+    enum class State
+    {
+      /// The judgement is being checked further up the stack.
+      InProgress,
+      /// The judgement holds, possibly under assumptions that have not been
+      /// discharged yet.
+      Proven,
+      /// The judgement does not hold.
+      Refuted,
+    };
+
+    struct Entry
+    {
+      State state;
+      /// For in-progress judgements, their position in `stack`. For proven
+      /// judgements, the position of the shallowest assumption they depend on,
+      /// or `UINT_MAX` if they depend on none.
+      unsigned depth;
+    };
+
+    /// Derive a judgement that is not in the cache.
+    bool derive(Judgement judgement);
+
+    llvm::DenseMap<Judgement, Entry> entries;
+
+    /// For each judgement in progress, the shallowest in-progress judgement
+    /// that its derivation has assumed to hold so far.
+    llvm::SmallVector<unsigned, 8> stack;
+
+    /// Judgements proven under assumptions that have not been discharged yet.
+    llvm::SmallVector<Judgement, 8> provisional;
+
+    unsigned hits = 0;
+    unsigned misses = 0;
+  };
+
   /// Perform typechecking on the given operation.
   ///
   /// For every operation contained within `op` (including `op` itself), if the
   /// operation implements `TypecheckInterface`, the `typecheck` implementation
   /// of that operation will be executed.
   ///
+  /// Subtyping judgements are memoised in `cache`, which may be shared across
+  /// calls.
+  ///
   /// Returns a successful result if all operations typecheck correctly.
+  LogicalResult typecheck(Operation* op, SubtypingCache& cache);
+
+  /// Perform typechecking on the given operation, using a fresh subtyping
+  /// cache.
   LogicalResult typecheck(Operation* op);
 
   /// TypecheckerPass wraps the `typecheck` function into a conventional MLIR
   /// pass, so it can easily be interleaved with other passes in a PassManager.
+  ///
+  /// The pass is meant to run on the module, so that class declarations are
+  /// checked along with functions. It walks the whole operation on a single
+  /// thread.
+  ///
+  /// The pass owns a subtyping cache, which outlives a single run since
+  /// subtyping judgements between uniqued types remain valid for the lifetime
+  /// of the context.
   class TypecheckerPass : public PassWrapper<TypecheckerPass, OperationPass<>>
   {
+  public:
+    TypecheckerPass() = default;
+
+    /// Clones start with an empty cache and statistics of their own.
+    TypecheckerPass(const TypecheckerPass& other) : PassWrapper(other) {}
+
+  private:
     void runOnOperation() override;
+
+    SubtypingCache cache;
+
+    Statistic cacheHits{
+      this, "subtyping-cache-hits", "Subtyping judgements found in the cache"};
+    Statistic cacheMisses{
+      this, "subtyping-cache-misses", "Subtyping judgements derived"};
   };
 
   /// Returns true if `lhs` is a subtype of `rhs`.
   /// `lhs` and `rhs` should be in normal form already.
+  ///
+  /// The judgement is memoised in the cache of the innermost active
+  /// `SubtypingCache::Scope` on this thread, or in a temporary cache if there
+  /// is none.
   bool isSubtype(Type lhs, Type rhs);
 
   /// Check whether `lhs` is a subtype of `rhs`. If it isn't, an error is
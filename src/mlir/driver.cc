@@ -3,22 +3,31 @@
 
 #include "driver.h"
 
+#include "dialect/Lowering.h"
+#include "dialect/Optimizations.h"
 #include "dialect/Typechecker.h"
+#include "dialect/VeronaTypes.h"
 #include "generator.h"
 #include "mlir/Conversion/StandardToLLVM/ConvertStandardToLLVMPass.h"
+#include "mlir/ExecutionEngine/ExecutionEngine.h"
+#include "mlir/ExecutionEngine/OptUtils.h"
 #include "mlir/IR/Verifier.h"
 #include "mlir/Parser.h"
 #include "mlir/Pass/Pass.h"
+#include "mlir/Pass/PassRegistry.h"
 #include "mlir/Transforms/Passes.h"
 
 #include "llvm/IR/Module.h"
 #include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/TargetSelect.h"
 #include "llvm/Support/ToolOutputFile.h"
 
 namespace mlir::verona
 {
   Driver::Driver(unsigned optLevel)
-  : passManager(&context), diagnosticHandler(sourceManager, &context)
+  : optLevel(optLevel),
+    passManager(&context),
+    diagnosticHandler(sourceManager, &context)
   {
     // Opaque operations and types can only exist if we allow
     // unregistered dialects to co-exist. Full conversions later will
@@ -26,18 +35,8 @@ namespace mlir::verona
     // dialects, then LLVM dialect, before converting to LLVM IR.
     context.allowUnregisteredDialects();
 
-    // TODO: make the set of passes configurable from the command-line
-    passManager.addPass(std::make_unique<TypecheckerPass>());
-
-    if (optLevel > 0)
-    {
-      passManager.addPass(mlir::createInlinerPass());
-      passManager.addPass(mlir::createSymbolDCEPass());
-
-      mlir::OpPassManager& funcPM = passManager.nest<mlir::FuncOp>();
-      funcPM.addPass(mlir::createCanonicalizerPass());
-      funcPM.addPass(mlir::createCSEPass());
-    }
+    // Timing, statistics and IR printing, as requested on the command-line.
+    mlir::applyPassManagerCLOptions(passManager);
   }
 
   llvm::Error Driver::readAST(const ::ast::Ast& ast)
@@ -79,18 +78,59 @@ namespace mlir::verona
     return llvm::Error::success();
   }
 
-  llvm::Error Driver::emitMLIR(llvm::StringRef filename)
+  llvm::Error Driver::setPassPipeline(llvm::StringRef pipeline)
   {
-    assert(module);
+    if (pipelineConfigured)
+      return runtimeError("Pass pipeline has already been configured");
 
-    if (filename.empty())
-      return runtimeError("No output filename provided");
+    std::string message;
+    llvm::raw_string_ostream os(message);
+    if (failed(mlir::parsePassPipeline(pipeline, passManager, os)))
+      return runtimeError("Invalid pass pipeline: " + os.str());
+
+    pipelineConfigured = true;
+    return llvm::Error::success();
+  }
+
+  llvm::Error Driver::runPasses()
+  {
+    if (!pipelineConfigured)
+    {
+      passManager.addPass(std::make_unique<TypecheckerPass>());
+
+      if (optLevel > 0)
+      {
+        passManager.addPass(mlir::createInlinerPass());
+        passManager.addPass(mlir::createSymbolDCEPass());
+
+        // The Verona passes run after inlining, which exposes more accesses
+        // to the same objects, and leave dead views for the canonicalizer.
+        mlir::OpPassManager& funcPM = passManager.nest<mlir::FuncOp>();
+        funcPM.addPass(std::make_unique<RedundantReadEliminationPass>());
+        funcPM.addPass(std::make_unique<DeadAllocationEliminationPass>());
+        funcPM.addPass(mlir::createCanonicalizerPass());
+        funcPM.addPass(mlir::createCSEPass());
+      }
+      pipelineConfigured = true;
+    }
 
     if (failed(passManager.run(module.get())))
     {
       module->dump();
       return runtimeError("Failed to run some passes");
     }
+    return llvm::Error::success();
+  }
+
+  llvm::Error Driver::emitMLIR(llvm::StringRef filename)
+  {
+    assert(module);
+
+    if (filename.empty())
+      return runtimeError("No output filename provided");
+
+    if (auto err = runPasses())
+      return err;
 
     // Write to the file requested
     std::error_code error;
@@ -101,4 +141,59 @@ namespace mlir::verona
     module->print(out);
     return llvm::Error::success();
   }
+
+  llvm::Expected<llvm::Optional<int64_t>> Driver::runJIT(llvm::StringRef entry)
+  {
+    assert(module);
+
+    auto func = module->lookupSymbol<mlir::FuncOp>(entry);
+    if (!func)
+      return runtimeError("Cannot find entry point " + entry.str());
+
+    // The result is read back as an `int64_t`, so integers of any other width
+    // are rejected. Verona values are lowered to 64-bit references.
+    mlir::FunctionType type = func.getType();
+    bool hasResult = type.getNumResults() == 1;
+    if (
+      type.getNumInputs() != 0 || type.getNumResults() > 1 ||
+      (hasResult && !type.getResult(0).isInteger(64) &&
+       !isaVeronaType(type.getResult(0))))
+    {
+      return runtimeError(
+        "Entry point " + entry.str() +
+        " must take no arguments and return at most one 64-bit integer");
+    }
+
+    // Lowering to LLVM comes after the passes that `emitMLIR` would run.
+    if (auto err = runPasses())
+      return std::move(err);
+    mlir::PassManager lowering(&context);
+    mlir::applyPassManagerCLOptions(lowering);
+    addLLVMLoweringPasses(lowering);
+    if (failed(lowering.run(module.get())))
+    {
+      module->dump();
+      return runtimeError("Failed to lower module to LLVM");
+    }
+
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+    auto transformer = mlir::makeOptimizingTransformer(
+      optLevel, /*sizeLevel=*/0, /*targetMachine=*/nullptr);
+    auto engine = mlir::ExecutionEngine::create(module.get(), transformer);
+    if (!engine)
+      return engine.takeError();
+
+    // Results are returned through a pointer, passed after the arguments.
+    int64_t result = 0;
+    llvm::SmallVector<void*, 1> args;
+    if (hasResult)
+      args.push_back(&result);
+    if (auto err = (*engine)->invoke(entry, args))
+      return std::move(err);
+
+    if (!hasResult)
+      return llvm::Optional<int64_t>();
+    return llvm::Optional<int64_t>(result);
+  }
 }
@@ -8,6 +8,7 @@
 #include "mlir/IR/Module.h"
 #include "mlir/Pass/PassManager.h"
 
+#include "llvm/ADT/Optional.h"
 #include "llvm/Support/SourceMgr.h"
 
 namespace mlir::verona
@@ -16,10 +17,13 @@ namespace mlir::verona
    * Main compiler API.
    *
    * The driver is user by first calling one of the `readXXX` methods, followed
-   * by `emitMLIR`. The various `readXXX` methods allow using different kinds of
-   * input.
+   * by `emitMLIR` or `runJIT`. The various `readXXX` methods allow using
+   * different kinds of input.
    *
-   * The lowering pipeline is configured through Driver's constructor arguments.
+   * The lowering pipeline is configured through Driver's constructor arguments,
+   * or replaced entirely with `setPassPipeline`. Pass instrumentation, such as
+   * timing and statistics, is configured from MLIR's pass manager command-line
+   * options, if they were registered.
    *
    * For now, the error handling is crude and needs proper consideration,
    * especially aggregating all errors and context before sending it back to
@@ -39,10 +43,37 @@ namespace mlir::verona
     /// Read textual MLIR into the driver's module.
     llvm::Error readMLIR(const std::string& filename);
 
+    /// Run the passes described by `pipeline` instead of the default ones.
+    /// The description uses the textual format of `mlir-opt`, for example
+    /// `verona-typecheck,func(canonicalize),symbol-dce`. Passes nested under
+    /// `func` run on functions in parallel; `verona-typecheck` should run on
+    /// the module, so that class declarations are checked.
+    llvm::Error setPassPipeline(llvm::StringRef pipeline);
+
     /// Emit the module as textual MLIR.
     llvm::Error emitMLIR(const llvm::StringRef filename);
 
+    /// Lower the module to LLVM and execute the function `entry` with the
+    /// JIT. The function must take no arguments, and return either nothing or
+    /// a single 64-bit integer or Verona value, which is returned as an
+    /// `int64_t`.
+    ///
+    /// Verona objects are allocated through the runtime linked into the
+    /// current process.
+    llvm::Expected<llvm::Optional<int64_t>> runJIT(llvm::StringRef entry);
+
   private:
+    /// Add the default passes for `optLevel` to the pass manager, unless a
+    /// pipeline was given explicitly, and run them on the module.
+    llvm::Error runPasses();
+
+    /// Optimisation level, used for both MLIR and LLVM passes.
+    unsigned optLevel;
+
+    /// Whether the pass manager has been populated already, either by
+    /// `setPassPipeline` or with the default passes.
+    bool pipelineConfigured = false;
+
     /// MLIR context.
     mlir::MLIRContext context;
 
@@ -51,7 +82,7 @@ namespace mlir::verona
     mlir::OwningModuleRef module;
 
     /// MLIR Pass Manager
-    /// It gets configured by the constructor based on the provided arguments.
+    /// It gets populated on first use, unless `setPassPipeline` was called.
     mlir::PassManager passManager;
 
     /// Source manager.
@@ -0,0 +1,200 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <verona.h>
+
+using namespace verona;
+
+/**
+ * Runtime support for code lowered from the Verona dialect and executed by
+ * `verona-mlir --run`.
+ *
+ * The functions at the bottom of this file are the entry points that
+ * `LowerObjectsPass` emits calls to. The JIT resolves them in the
+ * `verona-mlir` process, which exports its symbols. References are passed as
+ * 64-bit integers, and every field is a 64-bit slot, which holds either an
+ * integer or a reference.
+ */
+namespace
+{
+  struct JITDescriptor : public rt::Descriptor
+  {
+    JITDescriptor(size_t slots, uint64_t reference_mask);
+
+    const size_t slots;
+    /**
+     * Bit `i` is set if slot `i` holds a reference.
+     */
+    const uint64_t reference_mask;
+  };
+
+  struct JITObject : public rt::Object
+  {
+    /**
+     * `region` should be the entrypoint of the region which contains this
+     * object, or nullptr if this object is the entrypoint of a new region.
+     */
+    JITObject(const JITDescriptor* desc, JITObject* region)
+    : Object(desc), region_(region)
+    {
+      std::fill_n(fields(), desc->slots, 0);
+    }
+
+    const JITDescriptor* descriptor() const
+    {
+      return static_cast<const JITDescriptor*>(rt::Object::get_descriptor());
+    }
+
+    /**
+     * The slots are allocated directly after the object header.
+     */
+    uint64_t* fields()
+    {
+      return reinterpret_cast<uint64_t*>(this + 1);
+    }
+
+    const uint64_t* fields() const
+    {
+      return reinterpret_cast<const uint64_t*>(this + 1);
+    }
+
+    JITObject* region()
+    {
+      return region_ == nullptr ? this : region_;
+    }
+
+    template<typename F>
+    void for_each_reference(F f) const
+    {
+      const JITDescriptor* desc = descriptor();
+      for (size_t i = 0; i < desc->slots; i++)
+      {
+        if (((desc->reference_mask >> i) & 1) && (fields()[i] != 0))
+          f(reinterpret_cast<rt::Object*>(fields()[i]));
+      }
+    }
+
+    static void trace_fn(const rt::Object* base_object, rt::ObjectStack& stack)
+    {
+      static_cast<const JITObject*>(base_object)->for_each_reference(
+        [&](rt::Object* o) { stack.push(o); });
+    }
+
+    /**
+     * Collect the entrypoints of the sub-regions that this object owns, so the
+     * runtime releases them with this object.
+     */
+    static void collect_iso_fields(
+      rt::Object* base_object,
+      rt::Object* region,
+      rt::ObjectStack& sub_regions)
+    {
+      rt::ObjectStack fields(rt::ThreadAlloc::get());
+      base_object->get_descriptor()->trace(base_object, fields);
+      while (!fields.empty())
+        add_sub_region(fields.pop(), region, sub_regions);
+    }
+
+    /**
+     * Get the address of the given slot, aborting if the object does not have
+     * that many slots.
+     */
+    uint64_t* slot(uint64_t index)
+    {
+      if (index >= descriptor()->slots)
+      {
+        fprintf(
+          stderr,
+          "Slot %" PRIu64 " is out of bounds for an object with %zu slots\n",
+          index,
+          descriptor()->slots);
+        abort();
+      }
+      return &fields()[index];
+    }
+
+    static JITObject* from(uint64_t reference)
+    {
+      return reinterpret_cast<JITObject*>(reference);
+    }
+
+  private:
+    JITObject* region_;
+  };
+
+  JITDescriptor::JITDescriptor(size_t slots, uint64_t reference_mask)
+  : slots(slots), reference_mask(reference_mask)
+  {
+    rt::Descriptor::size = sizeof(JITObject) + (slots * sizeof(uint64_t));
+    rt::Descriptor::trace = JITObject::trace_fn;
+    // Objects are trivially destructible, so they can stay on the trivial
+    // ring unless they may own sub-regions.
+    rt::Descriptor::finaliser =
+      reference_mask != 0 ? JITObject::collect_iso_fields : nullptr;
+    rt::Descriptor::destructor = nullptr;
+  }
+
+  /**
+   * Get the descriptor for the class with the given index, creating it on its
+   * first use. Lowered code is run on a single thread.
+   */
+  const JITDescriptor*
+  get_descriptor(uint64_t id, uint64_t slots, uint64_t reference_mask)
+  {
+    static std::vector<std::unique_ptr<JITDescriptor>> descriptors;
+    if (descriptors.size() <= id)
+      descriptors.resize(id + 1);
+    if (!descriptors[id])
+      descriptors[id] = std::make_unique<JITDescriptor>(slots, reference_mask);
+    return descriptors[id].get();
+  }
+}
+
+extern "C"
+{
+  uint64_t verona_rt_new_region(uint64_t id, uint64_t slots, uint64_t mask)
+  {
+    const JITDescriptor* desc = get_descriptor(id, slots, mask);
+    rt::Object* object = rt::RegionTrace::create(rt::ThreadAlloc::get(), desc);
+    return reinterpret_cast<uint64_t>(new (object) JITObject(desc, nullptr));
+  }
+
+  uint64_t verona_rt_new_object(
+    uint64_t in, uint64_t id, uint64_t slots, uint64_t mask)
+  {
+    const JITDescriptor* desc = get_descriptor(id, slots, mask);
+    JITObject* region = JITObject::from(in)->region();
+    rt::Object* object =
+      rt::Region::alloc(rt::ThreadAlloc::get(), region, desc);
+    return reinterpret_cast<uint64_t>(new (object) JITObject(desc, region));
+  }
+
+  uint64_t verona_rt_field_read(uint64_t object, uint64_t slot)
+  {
+    return *JITObject::from(object)->slot(slot);
+  }
+
+  uint64_t verona_rt_field_write(uint64_t object, uint64_t slot, uint64_t value)
+  {
+    return std::exchange(*JITObject::from(object)->slot(slot), value);
+  }
+
+  void verona_rt_tidy(uint64_t object)
+  {
+    rt::RegionTrace::gc(
+      rt::ThreadAlloc::get(), JITObject::from(object)->region());
+  }
+
+  void verona_rt_drop(uint64_t object)
+  {
+    rt::Region::release(rt::ThreadAlloc::get(), JITObject::from(object));
+  }
+}
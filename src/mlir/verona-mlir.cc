@@ -8,10 +8,15 @@
 #include "ast/prec.h"
 #include "ast/ref.h"
 #include "ast/sym.h"
+#include "dialect/Lowering.h"
+#include "dialect/Optimizations.h"
+#include "dialect/Typechecker.h"
 #include "dialect/VeronaDialect.h"
 #include "driver.h"
 #include "mlir/InitAllDialects.h"
 #include "mlir/InitAllPasses.h"
+#include "mlir/Pass/PassManager.h"
+#include "mlir/Pass/PassRegistry.h"
 
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/InitLLVM.h"
@@ -53,6 +58,23 @@ namespace
   // Output file
   cl::opt<std::string> outputFile("o", cl::init(""), cl::desc("Output file"));
 
+  // Passes to run instead of the default ones for the optimisation level
+  cl::opt<std::string> passPipeline(
+    "pass-pipeline",
+    cl::init(""),
+    cl::desc("Textual description of the passes to run, replacing the "
+             "default ones (e.g. 'func(verona-typecheck,canonicalize)')"),
+    cl::value_desc("pipeline"));
+
+  // Execute the module instead of emitting it
+  cl::opt<bool> runJIT(
+    "run", cl::init(false), cl::desc("Execute the module with the JIT"));
+  cl::opt<std::string> entryPoint(
+    "entry",
+    cl::init("main"),
+    cl::desc("Function executed by --run"),
+    cl::value_desc("function"));
+
   // Grammar file is not optional
   std::string grammarFile;
 
@@ -105,9 +127,21 @@ int main(int argc, char** argv)
   // MLIR boilerplace
   mlir::registerAllDialects();
   mlir::registerAllPasses();
-  // TODO: Register verona passes here.
+  mlir::registerPassManagerCLOptions();
   mlir::registerDialect<mlir::verona::VeronaDialect>();
 
+  // Verona passes, which can be used in --pass-pipeline
+  mlir::PassRegistration<mlir::verona::TypecheckerPass>(
+    "verona-typecheck", "Typecheck Verona operations");
+  mlir::PassRegistration<mlir::verona::LowerLoopsPass>(
+    "verona-lower-loops", "Lower Verona loops to standard branches");
+  mlir::PassRegistration<mlir::verona::LowerObjectsPass>(
+    "verona-lower-objects", "Lower Verona objects to runtime calls");
+  mlir::PassRegistration<mlir::verona::RedundantReadEliminationPass>(
+    "verona-redundant-reads", "Reuse known values of Verona fields");
+  mlir::PassRegistration<mlir::verona::DeadAllocationEliminationPass>(
+    "verona-dead-allocations", "Remove Verona allocations that are dropped");
+
   // Set up pretty-print signal handlers
   llvm::InitLLVM y(argc, argv);
 
@@ -124,6 +158,8 @@ int main(int argc, char** argv)
 
   mlir::verona::Driver driver(optLevel);
   llvm::ExitOnError check;
+  if (!passPipeline.empty())
+    check(driver.setPassPipeline(passPipeline));
 
   // Parse the source file (verona/mlir)
   switch (inputKind)
@@ -154,6 +190,15 @@ int main(int argc, char** argv)
       return 1;
   }
 
+  if (runJIT)
+  {
+    // Print the entry point's result, if it has one
+    auto result = check(driver.runJIT(entryPoint));
+    if (result)
+      llvm::outs() << *result << "\n";
+    return 0;
+  }
+
   check(driver.emitMLIR(outputFile));
 
   return 0;
@@ -0,0 +1,203 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+/**
+ * A coroutine interface for scheduling behaviours, only available when
+ * compiling as C++20 with coroutine support.
+ *
+ * A function returning `BehaviourTask` is a coroutine that runs as a sequence
+ * of behaviours:
+ *
+ *   BehaviourTask transfer(Account* from, Account* to, size_t amount)
+ *   {
+ *     co_await when(from, to);
+ *     from->balance -= amount;
+ *     to->balance += amount;
+ *
+ *     co_await when(to);
+ *     to->log(amount);
+ *   }
+ *
+ * Calling the coroutine runs it on the calling thread up to its first
+ * `co_await when(...)`, which schedules a behaviour on the given cowns and
+ * suspends. When the cowns have been acquired, the behaviour resumes the
+ * coroutine, which then runs with exclusive access to them until its next
+ * `co_await when(...)` or its end. Suspending releases the cowns, so the
+ * coroutine only holds the cowns of its most recent `when`.
+ **/
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#  define VERONA_COROUTINES
+
+#  include "../sched/cown.h"
+#  include "vbehaviour.h"
+
+#  include <array>
+#  include <coroutine>
+#  include <type_traits>
+
+namespace verona::rt
+{
+  using namespace snmalloc;
+
+  /**
+   * The return type of a coroutine that runs as a sequence of behaviours.
+   *
+   * Coroutine frames are allocated with the runtime's allocator, and freed
+   * when the coroutine completes. Calling a `BehaviourTask` coroutine does
+   * not give the caller any way to wait for it: it is scheduled like a
+   * `when`.
+   **/
+  class BehaviourTask
+  {
+  public:
+    class promise_type
+    {
+      /**
+       * Cowns passed as arguments to the coroutine.
+       *
+       * While the coroutine is waiting for a `when`, its frame is part of the
+       * message sent to the cowns, and these are reported when the message is
+       * traced. Cowns that the coroutine only holds in local variables are not
+       * visible to the runtime, and must be kept alive by some other object.
+       **/
+      Cown** cowns = nullptr;
+      size_t cown_count = 0;
+
+      template<typename T>
+      static constexpr bool is_cown_v =
+        std::is_convertible_v<std::decay_t<T>, Cown*>;
+
+    public:
+      template<typename... Args>
+      promise_type(Args&... args)
+      {
+        cown_count = (0 + ... + (is_cown_v<Args> ? 1 : 0));
+        if (cown_count == 0)
+          return;
+
+        cowns = (Cown**)ThreadAlloc::get()->alloc(cown_count * sizeof(Cown*));
+        size_t i = 0;
+        (
+          [&](auto& arg) {
+            if constexpr (is_cown_v<decltype(arg)>)
+              cowns[i++] = arg;
+          }(args),
+          ...);
+      }
+
+      ~promise_type()
+      {
+        if (cowns != nullptr)
+          ThreadAlloc::get()->dealloc(cowns, cown_count * sizeof(Cown*));
+      }
+
+      void* operator new(size_t size)
+      {
+        return ThreadAlloc::get()->alloc(size);
+      }
+
+      void operator delete(void* p, size_t size)
+      {
+        ThreadAlloc::get()->dealloc(p, size);
+      }
+
+      BehaviourTask get_return_object()
+      {
+        return {};
+      }
+
+      std::suspend_never initial_suspend() noexcept
+      {
+        return {};
+      }
+
+      std::suspend_never final_suspend() noexcept
+      {
+        return {};
+      }
+
+      void return_void() {}
+
+      void unhandled_exception()
+      {
+        abort();
+      }
+
+      void trace(ObjectStack& st) const
+      {
+        for (size_t i = 0; i < cown_count; i++)
+        {
+          if (cowns[i] != nullptr)
+            st.push(cowns[i]);
+        }
+      }
+    };
+  };
+
+  /**
+   * The behaviour scheduled by `co_await when(...)`. Running it resumes the
+   * coroutine.
+   **/
+  class ResumeBehaviour : public VBehaviour<ResumeBehaviour>
+  {
+    std::coroutine_handle<BehaviourTask::promise_type> handle;
+
+  public:
+    ResumeBehaviour(std::coroutine_handle<BehaviourTask::promise_type> handle)
+    : handle(handle)
+    {}
+
+    void f()
+    {
+      // The coroutine may complete and free its frame, or be resumed on
+      // another thread by its next `when`, before this returns, so nothing
+      // may be accessed after it.
+      handle.resume();
+    }
+
+    void trace(ObjectStack& st) const
+    {
+      handle.promise().trace(st);
+    }
+  };
+
+  template<size_t N>
+  class WhenAwaitable
+  {
+    std::array<Cown*, N> cowns;
+
+  public:
+    WhenAwaitable(std::array<Cown*, N> cowns) : cowns(cowns) {}
+
+    bool await_ready() const noexcept
+    {
+      return false;
+    }
+
+    void await_suspend(std::coroutine_handle<BehaviourTask::promise_type> h)
+    {
+      // `schedule` copies the cowns before sending the message, so it doesn't
+      // matter that this awaitable, which lives in the coroutine frame, may be
+      // gone by the time it returns.
+      Cown::schedule<ResumeBehaviour>(N, cowns.data(), h);
+    }
+
+    void await_resume() const noexcept {}
+  };
+
+  /**
+   * Suspend the current `BehaviourTask` coroutine until all of `cowns` have
+   * been acquired, and resume it inside a behaviour on them.
+   **/
+  template<typename... Cowns>
+  WhenAwaitable<sizeof...(Cowns)> when(Cowns*... cowns)
+  {
+    static_assert(sizeof...(Cowns) > 0, "when needs at least one cown");
+    static_assert(
+      (std::is_base_of_v<Cown, Cowns> && ...), "when can only acquire cowns");
+    return WhenAwaitable<sizeof...(Cowns)>({cowns...});
+  }
+} // namespace verona::rt
+#endif
@@ -0,0 +1,132 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../sched/cown.h"
+#include "promise.h"
+#include "vbehaviour.h"
+
+#include <atomic>
+#include <type_traits>
+
+namespace verona::rt
+{
+  using namespace snmalloc;
+
+  /**
+   * State shared by the behaviours of a `scatter_gather`. It is allocated once
+   * for the whole operation, and freed by the last behaviour to finish.
+   **/
+  template<typename R, class T, class Map, class Reduce>
+  struct GatherState
+  {
+    std::atomic<size_t> remaining;
+    size_t count;
+    R* results;
+    Map map;
+    Reduce reduce;
+    R init;
+    Promise<R>* result;
+
+    GatherState(
+      size_t count,
+      R* results,
+      Map map,
+      Reduce reduce,
+      R init,
+      Promise<R>* result)
+    : remaining(count),
+      count(count),
+      results(results),
+      map(map),
+      reduce(reduce),
+      init(init),
+      result(result)
+    {}
+  };
+
+  template<typename R, class T, class Map, class Reduce>
+  class GatherStep : public VBehaviour<GatherStep<R, T, Map, Reduce>>
+  {
+    using State = GatherState<R, T, Map, Reduce>;
+
+    size_t index;
+    State* state;
+    T* cown;
+
+  public:
+    GatherStep(size_t index, State* state, T** cowns)
+    : index(index), state(state), cown(cowns[index])
+    {}
+
+    void f()
+    {
+      // Each behaviour writes its own slot, so only the count is shared.
+      state->results[index] = state->map(cown);
+      if (state->remaining.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+      R acc = state->init;
+      for (size_t i = 0; i < state->count; i++)
+        acc = state->reduce(acc, state->results[i]);
+
+      auto* alloc = ThreadAlloc::get();
+      state->result->fulfill(acc);
+      Cown::release(alloc, state->result);
+
+      alloc->dealloc(state->results, state->count * sizeof(R));
+      state->~State();
+      alloc->dealloc<sizeof(State)>(state);
+    }
+
+    void trace(ObjectStack& st) const
+    {
+      st.push(cown);
+      st.push(state->result);
+    }
+  };
+
+  /**
+   * Run `map(cowns[i])` in a separate behaviour on each of `count` cowns, and
+   * fulfill `result` with the results combined in order by `reduce`, starting
+   * from `init`.
+   *
+   * The behaviours are scheduled with `Cown::schedule_each`. Each result is
+   * written to its own slot of a shared array, and the last behaviour to
+   * finish reduces them, so there is no contention beyond a shared counter.
+   * `map` and `reduce` are copied into the shared state, and may be called
+   * concurrently from several threads.
+   *
+   * This takes ownership of a reference to `result`.
+   **/
+  template<typename R, class T, class Map, class Reduce>
+  void scatter_gather(
+    size_t count,
+    T** cowns,
+    Map map,
+    Reduce reduce,
+    R init,
+    Promise<R>* result)
+  {
+    static_assert(std::is_base_of_v<Cown, T>);
+    static_assert(
+      std::is_trivially_copyable_v<R>,
+      "Results are stored in uninitialised memory");
+    using State = GatherState<R, T, Map, Reduce>;
+
+    if (count == 0)
+    {
+      result->fulfill(init);
+      Cown::release(ThreadAlloc::get(), result);
+      return;
+    }
+
+    auto* alloc = ThreadAlloc::get();
+    auto* results = (R*)alloc->alloc(count * sizeof(R));
+    auto* state = new (alloc->alloc<sizeof(State)>())
+      State(count, results, map, reduce, init, result);
+
+    Cown::schedule_each<GatherStep<R, T, Map, Reduce>>(
+      count, (Cown**)cowns, state, cowns);
+  }
+} // namespace verona::rt
@@ -0,0 +1,147 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../sched/cown.h"
+#include "vobject.h"
+
+#include <optional>
+#include <type_traits>
+
+namespace verona::rt
+{
+  using namespace snmalloc;
+
+  template<typename T>
+  class Future;
+
+  /**
+   * The writing end of a value that will be provided later, by calling
+   * `fulfill` exactly once.
+   *
+   * A promise is a cown that is not scheduled until it is fulfilled. Behaviours
+   * waiting for the value are scheduled on the promise, through a `Future`, so
+   * they wait in its message queue like any other message, and run once the
+   * value is there. No memory is allocated for a waiter beyond the behaviour
+   * itself.
+   *
+   * As a cown, a promise is reference counted with `Cown::acquire` and
+   * `Cown::release`, starting with one reference owned by its creator. An
+   * unfulfilled promise that is no longer reachable is collected by the leak
+   * detector along with the behaviours waiting for it. If `T` is a pointer to
+   * an object, such as a cown or an immutable, the value is traced.
+   **/
+  template<typename T>
+  class Promise : public VCown<Promise<T>>
+  {
+    friend class Future<T>;
+
+    std::optional<T> value;
+
+  public:
+    Promise()
+    {
+      // Waking the queue, without scheduling the cown, lets messages be
+      // enqueued without the cown ever running them.
+      this->wake();
+    }
+
+    /**
+     * Provide the value, and schedule the behaviours that are waiting for it.
+     *
+     * This must only be called once, and not from a behaviour waiting for
+     * this promise.
+     **/
+    void fulfill(T v)
+    {
+      assert(!value.has_value());
+      value.emplace(std::move(v));
+
+      // The scheduler thread running the cown owns a reference to it.
+      Cown::acquire(this);
+      this->schedule();
+    }
+
+    Future<T> future()
+    {
+      return Future<T>(this);
+    }
+
+    void trace(ObjectStack& st) const
+    {
+      if constexpr (std::is_convertible_v<T, Object*>)
+      {
+        if (value.has_value() && (*value != nullptr))
+          st.push(*value);
+      }
+    }
+  };
+
+  /**
+   * The reading end of a `Promise`.
+   *
+   * A future does not own a reference to its promise, so the promise must be
+   * kept alive while the future is in use, for example by calling
+   * `Cown::acquire` on `cown()`.
+   **/
+  template<typename T>
+  class Future
+  {
+    friend class Promise<T>;
+
+    Promise<T>* promise;
+
+    explicit Future(Promise<T>* promise) : promise(promise) {}
+
+  public:
+    Cown* cown() const
+    {
+      return promise;
+    }
+
+    /**
+     * Schedule the behaviour `Be`, constructed from `args`, to run once the
+     * promise has been fulfilled.
+     *
+     * The behaviour can return a value through another promise, which it
+     * fulfills, so continuations can be chained without any other
+     * bookkeeping.
+     **/
+    template<class Be, typename... Args>
+    void then(Args&&... args) const
+    {
+      Cown::schedule<Be>(promise, std::forward<Args>(args)...);
+    }
+
+    /**
+     * The value of the promise. This may only be called from a behaviour
+     * scheduled with `then` or `when_all` on this future.
+     **/
+    T& get() const
+    {
+      assert(promise->value.has_value());
+      return *promise->value;
+    }
+  };
+
+  /**
+   * Schedule the behaviour `Be`, constructed from `args`, to run once all of
+   * the `count` futures have been fulfilled.
+   *
+   * This schedules a single behaviour over all of the promises, rather than
+   * waiting for each future in turn, so the only per-future cost is the
+   * message the runtime sends to each promise.
+   **/
+  template<class Be, typename T, typename... Args>
+  void when_all(size_t count, const Future<T>* futures, Args&&... args)
+  {
+    auto* alloc = ThreadAlloc::get();
+    auto** cowns = (Cown**)alloc->alloc(count * sizeof(Cown*));
+    for (size_t i = 0; i < count; i++)
+      cowns[i] = futures[i].cown();
+
+    Cown::schedule<Be>(count, cowns, std::forward<Args>(args)...);
+
+    alloc->dealloc(cowns, count * sizeof(Cown*));
+  }
+} // namespace verona::rt
@@ -0,0 +1,508 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "object.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <ostream>
+#include <snmalloc.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(USE_EXECINFO) && !defined(_MSC_VER)
+#  include <execinfo.h>
+#endif
+
+namespace verona::rt
+{
+  using namespace snmalloc;
+
+  /**
+   * A sampling profiler for the objects allocated by the runtime.
+   *
+   * The profiler is off until `start` is called. While it is off, each object
+   * allocation costs a single relaxed load. While it is on, each thread counts
+   * down the bytes it allocates, and records a sample when the count reaches
+   * zero. The distance between samples is drawn from an exponential
+   * distribution with the requested mean, so that every byte is equally
+   * likely to be sampled, and objects of any size are counted without bias
+   * once the samples are scaled back up.
+   *
+   * A sample records the object's descriptor and size, the cown whose
+   * behaviour was running, if any, and the call stack of the allocation. The
+   * stack is only captured where `backtrace` is available, or on Windows.
+   *
+   * `write` produces a profile in pprof's protobuf format, with the estimated
+   * number of objects and bytes allocated since the profiler was started or
+   * reset, and the descriptor and cown of each sample as labels. It does not
+   * track deallocation, so this is a profile of allocations rather than of
+   * the live heap.
+   **/
+  class HeapProfiler
+  {
+  public:
+    static constexpr size_t max_frames = 32;
+
+    struct Sample
+    {
+      Sample* next;
+      const Descriptor* desc;
+      const Object* cown;
+      size_t size;
+      /// The mean sampling interval when the sample was taken.
+      size_t mean;
+      size_t depth;
+      void* frames[max_frames];
+    };
+
+  private:
+    static std::atomic<size_t>& interval()
+    {
+      static std::atomic<size_t> interval;
+      return interval;
+    }
+
+    /**
+     * The most recent interval passed to `start`, which is kept after `stop`.
+     **/
+    static std::atomic<size_t>& last_interval()
+    {
+      static std::atomic<size_t> last_interval;
+      return last_interval;
+    }
+
+    static std::atomic<Sample*>& samples()
+    {
+      static std::atomic<Sample*> samples;
+      return samples;
+    }
+
+    static std::atomic_flag& lock()
+    {
+      static std::atomic_flag lock = ATOMIC_FLAG_INIT;
+      return lock;
+    }
+
+    static std::atomic<uint64_t>& start_time()
+    {
+      static std::atomic<uint64_t> start_time;
+      return start_time;
+    }
+
+    static const Object*& running()
+    {
+      static thread_local const Object* running = nullptr;
+      return running;
+    }
+
+    /**
+     * Bytes this thread can allocate before taking its next sample. This is
+     * negative until the thread first allocates with the profiler on.
+     **/
+    static int64_t& countdown()
+    {
+      static thread_local int64_t countdown = -1;
+      return countdown;
+    }
+
+    static uint64_t next_random()
+    {
+      static thread_local uint64_t state = 0;
+      if (state == 0)
+        state = ((uint64_t)(uintptr_t)&state) | 1;
+
+      // xorshift64*
+      state ^= state >> 12;
+      state ^= state << 25;
+      state ^= state >> 27;
+      return state * 0x2545F4914F6CDD1DULL;
+    }
+
+    static int64_t next_interval(size_t mean)
+    {
+      // Uniform in (0, 1], so that the logarithm is finite.
+      constexpr double scale = 1.0 / (double)(uint64_t(1) << 53);
+      double u = (double)((next_random() >> 11) + 1) * scale;
+      return (int64_t)(-std::log(u) * (double)mean) + 1;
+    }
+
+    static size_t capture_stack(void** frames)
+    {
+#if defined(_MSC_VER)
+      return CaptureStackBackTrace(1, (DWORD)max_frames, frames, nullptr);
+#elif defined(USE_EXECINFO)
+      // Skip the frame for `record`.
+      void* all[max_frames + 1];
+      int n = backtrace(all, max_frames + 1);
+      if (n <= 1)
+        return 0;
+      memcpy(frames, all + 1, (size_t)(n - 1) * sizeof(void*));
+      return (size_t)(n - 1);
+#else
+      UNUSED(frames);
+      return 0;
+#endif
+    }
+
+    NOINLINE static void record(const Descriptor* desc, size_t mean)
+    {
+      int64_t& left = countdown();
+      if (left < 0)
+      {
+        // First allocation on this thread since the profiler was started.
+        left = next_interval(mean);
+      }
+
+      left -= (int64_t)desc->size;
+      if (left > 0)
+        return;
+      left = next_interval(mean);
+
+      auto* s = (Sample*)ThreadAlloc::get()->alloc<sizeof(Sample)>();
+      s->desc = desc;
+      s->cown = running();
+      s->size = desc->size;
+      s->mean = mean;
+      s->depth = capture_stack(s->frames);
+
+      Sample* head = samples().load(std::memory_order_relaxed);
+      do
+      {
+        s->next = head;
+      } while (!samples().compare_exchange_weak(
+        head, s, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+  public:
+    /**
+     * Start sampling, taking one sample on average for every `mean` bytes of
+     * objects allocated. Calling this while the profiler is on changes the
+     * rate for samples taken from then on.
+     **/
+    static void start(size_t mean = 512 * 1024)
+    {
+      assert(mean > 0);
+      uint64_t zero = 0;
+      start_time().compare_exchange_strong(
+        zero,
+        (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count());
+      last_interval().store(mean, std::memory_order_relaxed);
+      interval().store(mean, std::memory_order_relaxed);
+    }
+
+    /**
+     * Stop sampling. The samples taken so far are kept until `reset`.
+     **/
+    static void stop()
+    {
+      interval().store(0, std::memory_order_relaxed);
+    }
+
+    static bool is_active()
+    {
+      return interval().load(std::memory_order_relaxed) != 0;
+    }
+
+    /**
+     * Called for every object allocated by the runtime.
+     **/
+    static void on_alloc(const Descriptor* desc)
+    {
+      size_t mean = interval().load(std::memory_order_relaxed);
+      if (likely(mean == 0))
+        return;
+
+      record(desc, mean);
+    }
+
+    /**
+     * Set the cown that allocations on this thread are attributed to, or
+     * `nullptr` outside a behaviour.
+     **/
+    static void set_running(const Object* cown)
+    {
+      running() = cown;
+    }
+
+    /**
+     * Call `f` on each sample taken so far, most recent first.
+     **/
+    template<typename F>
+    static void for_each(F f)
+    {
+      FlagLock l(lock());
+      for (Sample* s = samples().load(std::memory_order_acquire); s != nullptr;
+           s = s->next)
+        f(*s);
+    }
+
+    /**
+     * Discard the samples taken so far.
+     **/
+    static void reset()
+    {
+      FlagLock l(lock());
+      auto* alloc = ThreadAlloc::get();
+      Sample* s = samples().exchange(nullptr, std::memory_order_acquire);
+      while (s != nullptr)
+      {
+        Sample* next = s->next;
+        alloc->dealloc<sizeof(Sample)>(s);
+        s = next;
+      }
+      start_time().store(0, std::memory_order_relaxed);
+    }
+
+    /**
+     * Write the samples taken so far as an uncompressed pprof profile. This
+     * can be called while the profiler is on.
+     **/
+    static void write(std::ostream& out);
+
+    /**
+     * Write the profile to the file at `path`, returning false if it could not
+     * be written.
+     **/
+    static bool write(const char* path)
+    {
+      std::ofstream out(path, std::ios::binary);
+      write(out);
+      return out.good();
+    }
+  };
+
+  namespace heapprofile
+  {
+    /**
+     * Just enough of the protobuf wire format to write a pprof profile, as
+     * described by `profile.proto` in github.com/google/pprof.
+     **/
+    class Message
+    {
+      std::string bytes;
+
+      void varint(uint64_t v)
+      {
+        while (v >= 0x80)
+        {
+          bytes.push_back((char)((v & 0x7f) | 0x80));
+          v >>= 7;
+        }
+        bytes.push_back((char)v);
+      }
+
+    public:
+      void add(uint32_t field, uint64_t v)
+      {
+        varint((uint64_t)field << 3);
+        varint(v);
+      }
+
+      void add(uint32_t field, const std::string& s)
+      {
+        varint(((uint64_t)field << 3) | 2);
+        varint(s.size());
+        bytes.append(s);
+      }
+
+      void add(uint32_t field, const Message& m)
+      {
+        add(field, m.bytes);
+      }
+
+      void add_packed(uint32_t field, const std::vector<uint64_t>& vs)
+      {
+        Message packed;
+        for (auto v : vs)
+          packed.varint(v);
+        add(field, packed);
+      }
+
+      const std::string& str() const
+      {
+        return bytes;
+      }
+    };
+
+    class Strings
+    {
+      std::vector<std::string> table{""};
+      std::unordered_map<std::string, uint64_t> index{{"", 0}};
+
+    public:
+      uint64_t operator()(const std::string& s)
+      {
+        auto it = index.find(s);
+        if (it != index.end())
+          return it->second;
+
+        table.push_back(s);
+        index.emplace(s, table.size() - 1);
+        return table.size() - 1;
+      }
+
+      void write(Message& profile) const
+      {
+        for (auto& s : table)
+          profile.add(6, s);
+      }
+    };
+
+    struct Mapping
+    {
+      uint64_t start;
+      uint64_t limit;
+      uint64_t offset;
+      std::string file;
+    };
+
+    /**
+     * The executable mappings of the process, so that pprof can find the
+     * binaries to symbolize the addresses with. This is only known on Linux.
+     **/
+    inline std::vector<Mapping> mappings()
+    {
+      std::vector<Mapping> result;
+#ifdef __linux__
+      std::ifstream maps("/proc/self/maps");
+      std::string line;
+      while (std::getline(maps, line))
+      {
+        unsigned long long start, limit, offset;
+        char perms[5];
+        int path = 0;
+        if (
+          sscanf(
+            line.c_str(),
+            "%llx-%llx %4s %llx %*s %*s %n",
+            &start,
+            &limit,
+            perms,
+            &offset,
+            &path) < 4)
+          continue;
+
+        if ((perms[2] != 'x') || (path == 0) || ((size_t)path >= line.size()))
+          continue;
+
+        result.push_back({start, limit, offset, line.substr((size_t)path)});
+      }
+#endif
+      return result;
+    }
+
+    inline std::string hex(const void* p)
+    {
+      char buf[2 + 2 * sizeof(void*) + 1];
+      snprintf(buf, sizeof(buf), "%#zx", (size_t)p);
+      return buf;
+    }
+  } // namespace heapprofile
+
+  inline void HeapProfiler::write(std::ostream& out)
+  {
+    using namespace heapprofile;
+
+    Message profile;
+    Strings strings;
+
+    auto value_type = [&](const char* type, const char* unit) {
+      Message m;
+      m.add(1, strings(type));
+      m.add(2, strings(unit));
+      return m;
+    };
+
+    profile.add(1, value_type("alloc_objects", "count"));
+    profile.add(1, value_type("alloc_space", "bytes"));
+
+    auto maps = mappings();
+    for (size_t i = 0; i < maps.size(); i++)
+    {
+      Message m;
+      m.add(1, i + 1);
+      m.add(2, maps[i].start);
+      m.add(3, maps[i].limit);
+      m.add(4, maps[i].offset);
+      m.add(5, strings(maps[i].file));
+      profile.add(3, m);
+    }
+
+    std::unordered_map<uintptr_t, uint64_t> locations;
+    auto location = [&](void* frame) {
+      // The frames are return addresses, so step back into the call.
+      uintptr_t address = (uintptr_t)frame - 1;
+      auto it = locations.find(address);
+      if (it != locations.end())
+        return it->second;
+
+      uint64_t id = locations.size() + 1;
+      locations.emplace(address, id);
+
+      Message m;
+      m.add(1, id);
+      for (size_t i = 0; i < maps.size(); i++)
+      {
+        if ((address >= maps[i].start) && (address < maps[i].limit))
+        {
+          m.add(2, i + 1);
+          break;
+        }
+      }
+      m.add(3, address);
+      profile.add(4, m);
+      return id;
+    };
+
+    auto label = [&](Message& sample, const char* key, const std::string& s) {
+      Message m;
+      m.add(1, strings(key));
+      m.add(2, strings(s));
+      sample.add(3, m);
+    };
+
+    for_each([&](const Sample& s) {
+      // A sample stands for all of the allocations in the interval it was
+      // drawn from, so scale it by the inverse of its probability.
+      double weight = 1 / (1 - std::exp(-(double)s.size / (double)s.mean));
+
+      std::vector<uint64_t> ids;
+      for (size_t i = 0; i < s.depth; i++)
+        ids.push_back(location(s.frames[i]));
+
+      Message sample;
+      sample.add_packed(1, ids);
+      sample.add_packed(
+        2,
+        {(uint64_t)std::llround(weight),
+         (uint64_t)std::llround(weight * (double)s.size)});
+
+      Message bytes;
+      bytes.add(1, strings("bytes"));
+      bytes.add(3, s.size);
+      sample.add(3, bytes);
+
+      label(sample, "descriptor", hex(s.desc));
+      if (s.cown != nullptr)
+        label(sample, "cown", hex(s.cown));
+
+      profile.add(2, sample);
+    });
+
+    profile.add(9, start_time().load(std::memory_order_relaxed));
+    profile.add(11, value_type("space", "bytes"));
+    profile.add(12, last_interval().load(std::memory_order_relaxed));
+    strings.write(profile);
+
+    out.write(profile.str().data(), (std::streamsize)profile.str().size());
+  }
+} // namespace verona::rt
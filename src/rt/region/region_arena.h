@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include "../object/heapprofiler.h"
 #include "../object/object.h"
 #include "region_base.h"
 
@@ -289,6 +290,7 @@ namespace verona::rt
         reg->last_large != nullptr ?
           reg->last_large->get_next_any_mark() == reg :
           true);
+      HeapProfiler::on_alloc(desc);
 
       return o;
     }
@@ -308,6 +310,7 @@ namespace verona::rt
       RegionArena* reg = get(in);
       Object* o = reg->alloc_internal<size>(alloc, desc);
       assert(Object::debug_is_aligned(o));
+      HeapProfiler::on_alloc(desc);
       return o;
     }
 
@@ -43,11 +43,30 @@ namespace verona::rt
       AllObjects,
     };
 
-    RegionBase(const Descriptor* desc) : Object(desc) {}
+    RegionBase(const Descriptor* desc) : Object(desc)
+    {
+      live().fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * The number of regions that have been created and not yet released,
+     * frozen, or merged into another region.
+     **/
+    static size_t live_count()
+    {
+      return live().load(std::memory_order_relaxed);
+    }
 
   private:
+    static std::atomic<size_t>& live()
+    {
+      static std::atomic<size_t> live;
+      return live;
+    }
+
     inline void dealloc(Alloc* alloc)
     {
+      live().fetch_sub(1, std::memory_order_relaxed);
       ExternalReferenceTable::dealloc(alloc);
       RememberedSet::dealloc(alloc);
       Object::dealloc(alloc);
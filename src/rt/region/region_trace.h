@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include "../object/heapprofiler.h"
 #include "../object/object.h"
 #include "region_arena.h"
 #include "region_base.h"
@@ -122,6 +123,7 @@ namespace verona::rt
       o->set_descriptor(desc);
       o->init_iso();
       o->set_region(reg);
+      HeapProfiler::on_alloc(desc);
 
       return o;
     }
@@ -153,6 +155,7 @@ namespace verona::rt
 
       // GC heuristics.
       reg->use_memory(desc->size);
+      HeapProfiler::on_alloc(desc);
 
       return o;
     }
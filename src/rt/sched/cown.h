@@ -4,6 +4,7 @@
 
 #include "../ds/forward_list.h"
 #include "../ds/mpscq.h"
+#include "../object/heapprofiler.h"
 #include "../region/region.h"
 #include "../test/systematic.h"
 #include "backpressure.h"
@@ -55,6 +56,16 @@ namespace verona::rt
       this->init(ThreadAlloc::get(), desc, Scheduler::alloc_epoch());
     }
 
+    /**
+     * The number of cowns that have been allocated and not yet deallocated.
+     * This includes cowns that have been collected, but whose memory is still
+     * held by weak references.
+     **/
+    static size_t live_count()
+    {
+      return live().load(std::memory_order_relaxed);
+    }
+
   private:
     friend class DLList<Cown>;
     friend class MultiMessage;
@@ -68,6 +79,12 @@ namespace verona::rt
 
     static constexpr auto NO_EPOCH_SET = (std::numeric_limits<uint64_t>::max)();
 
+    static std::atomic<size_t>& live()
+    {
+      static std::atomic<size_t> live;
+      return live;
+    }
+
     union
     {
       std::atomic<Cown*> next_in_queue;
@@ -395,6 +412,8 @@ namespace verona::rt
       set_descriptor(desc);
       set_epoch(epoch);
       queue.init(stub_msg(alloc));
+      live().fetch_add(1, std::memory_order_relaxed);
+      HeapProfiler::on_alloc(desc);
       CownThread* local = Scheduler::local();
 
       if (local != nullptr)
@@ -433,6 +452,19 @@ namespace verona::rt
       t->schedule_lifo(this);
     }
 
+    /**
+     * Schedule the cown on the next scheduler thread in round-robin order,
+     * rather than on the current thread.
+     */
+    void schedule_spread()
+    {
+      CownThread* t = Scheduler::round_robin();
+      if (t == Scheduler::local())
+        t->schedule_fifo(this);
+      else
+        t->schedule_lifo(this);
+    }
+
   private:
     bool in_epoch(EpochMark epoch)
     {
@@ -447,6 +479,7 @@ namespace verona::rt
 
     void dealloc(Alloc* alloc)
     {
+      live().fetch_sub(1, std::memory_order_relaxed);
       Object::dealloc(alloc);
 
 #ifdef USE_SYSTEMATIC_TESTING
@@ -531,8 +564,13 @@ namespace verona::rt
      *     TODO: It would be semantically valid to execute the behaviour without
      *     rescheduling. However, for fairness, it is better to reschedule in
      *     case the behaviour executes for a very long time.
+     *
+     * If `spread` is true, the last cown is scheduled with `schedule_spread`.
      **/
-    static void fast_send(MultiMessage::MultiMessageBody* body, EpochMark epoch)
+    static void fast_send(
+      MultiMessage::MultiMessageBody* body,
+      EpochMark epoch,
+      bool spread = false)
     {
       size_t count = body->count;
       Cown** cowns = body->cowns;
@@ -569,7 +607,10 @@ namespace verona::rt
             << "MultiMessage " << m
             << " fast send complete, reschedule cown: " << cowns[body->index]
             << std::endl;
-          cowns[body->index]->schedule();
+          if (spread)
+            cowns[body->index]->schedule_spread();
+          else
+            cowns[body->index]->schedule();
           return;
         }
 
@@ -707,7 +748,9 @@ namespace verona::rt
       Scheduler::local()->message_body = &body;
 
       // Run the behaviour.
+      HeapProfiler::set_running(cown);
       body.behaviour->f();
+      HeapProfiler::set_running(nullptr);
 
       Systematic::cout() << "MultiMessage " << m << " completed and running on "
                          << cown << std::endl;
@@ -789,6 +832,59 @@ namespace verona::rt
       fast_send(body, epoch);
     }
 
+    /**
+     * Schedules a separate behaviour on each of `count` cowns, constructing
+     * the behaviour for `cowns[i]` as `Be(i, args...)`.
+     *
+     * This behaves like calling `schedule` once for each cown, except that
+     * the cowns that need scheduling are spread round-robin across the
+     * scheduler threads, instead of all being queued on the calling thread and
+     * left for the other threads to steal. Each behaviour is still sent as its
+     * own message, so this allocates as much as the equivalent loop of
+     * `schedule` calls.
+     *
+     * Pass `transfer = YesTransfer` as a template argument if the
+     * caller is transfering ownership of a reference count on each cown to this
+     * method.
+     **/
+    template<
+      class Be,
+      TransferOwnership transfer = NoTransfer,
+      typename... Args>
+    static void schedule_each(size_t count, Cown** cowns, const Args&... args)
+    {
+      static_assert(std::is_base_of_v<Behaviour, Be>);
+      Systematic::cout() << "Schedule " << count
+                         << " behaviours of type: " << typeid(Be).name()
+                         << std::endl;
+
+      auto* alloc = ThreadAlloc::get();
+      auto sched = Scheduler::local();
+
+      for (size_t i = 0; i < count; i++)
+      {
+        auto* be = new ((Be*)alloc->alloc<sizeof(Be)>()) Be(i, args...);
+        auto** single = (Cown**)alloc->alloc<sizeof(Cown*)>();
+        single[0] = cowns[i];
+
+        if constexpr (transfer == NoTransfer)
+          Cown::acquire(single[0]);
+
+        auto body = MultiMessage::make_body(alloc, 1, single, be);
+
+        auto epoch = sched == nullptr ? EpochMark::EPOCH_A : Scheduler::epoch();
+        if (epoch == EpochMark::EPOCH_NONE)
+        {
+          Scheduler::record_inflight_message();
+        }
+
+        if ((sched != nullptr) && (sched->message_body != nullptr))
+          backpressure_scan(*sched->message_body, *body);
+
+        fast_send(body, epoch, true);
+      }
+    }
+
     /**
      * Unmute a cown if it is muted.
      */
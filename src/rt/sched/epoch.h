@@ -90,6 +90,9 @@ namespace verona::rt
     size_t unusable[4] = {0, 0, 0, 0};
     size_t to_dec[4] = {0, 0, 0, 0};
     uint8_t index = 0;
+    // The total of `to_dec`, which other threads can read for statistics.
+    // Only the owning thread writes it, so it doesn't need a read-modify-write.
+    std::atomic<size_t> pending_decs = 0;
 
     std::atomic<uint64_t> epoch = EJECTED_BIT;
     AsymmetricLock lock;
@@ -111,6 +114,9 @@ namespace verona::rt
       node->o = p;
       dec_list.enqueue((InnerNode*)node);
       (*get_to_dec(2))++;
+      pending_decs.store(
+        pending_decs.load(std::memory_order_relaxed) + 1,
+        std::memory_order_relaxed);
       debug_check_count();
     }
 
@@ -183,6 +189,9 @@ namespace verona::rt
           Immutable::release(alloc, o);
         }
 
+        pending_decs.store(
+          pending_decs.load(std::memory_order_relaxed) - usable,
+          std::memory_order_relaxed);
         *cell = 0;
       }
 
@@ -465,5 +474,24 @@ namespace verona::rt
         curr = global_epoch_set().iterate(curr);
       }
     }
+
+    /**
+     * The number of decrements, across all threads, that are waiting for the
+     * epoch to advance. This may be called from any thread, and the result is
+     * approximate while other threads are running.
+     **/
+    static size_t pending_decrements()
+    {
+      size_t sum = 0;
+      auto curr = global_epoch_set().iterate();
+
+      while (curr != nullptr)
+      {
+        sum += curr->pending_decs.load(std::memory_order_relaxed);
+        curr = global_epoch_set().iterate(curr);
+      }
+
+      return sum;
+    }
   };
 } // namespace verona::rt
@@ -0,0 +1,87 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../region/region_base.h"
+#include "cown.h"
+#include "epoch.h"
+
+#include <iostream>
+#include <snmalloc.h>
+
+namespace verona::rt
+{
+  using namespace snmalloc;
+
+  /**
+   * A snapshot of the memory used by the runtime and its allocator.
+   *
+   * The allocator figures cover the whole process, as snmalloc's memory is
+   * shared by every allocator in the pool. When building with `USE_MALLOC`
+   * they are all zero.
+   **/
+  struct MemoryStats
+  {
+    /// Bytes obtained from the OS by the allocator. snmalloc does not return
+    /// memory to the OS, so this is also the peak usage.
+    size_t reserved = 0;
+    /// Bytes of `reserved` that are held by allocators, either for live
+    /// objects or in their per-size-class free lists.
+    size_t heap_in_use = 0;
+    /// Bytes of `reserved` cached as free large chunks, available to any
+    /// allocator without asking the OS for more memory.
+    size_t cached_free = 0;
+    /// Number of allocators in the pool, each owning its own slabs.
+    size_t allocators = 0;
+
+    /// Reference count decrements waiting for the epoch to advance.
+    size_t pending_decrements = 0;
+    /// Cowns that have been allocated and not yet deallocated.
+    size_t live_cowns = 0;
+    /// Regions that have been created and not yet released, frozen or merged.
+    size_t live_regions = 0;
+
+    void print(std::ostream& o) const
+    {
+      o << "Memory stats:" << std::endl;
+      o << "  reserved:           " << reserved << std::endl;
+      o << "  heap in use:        " << heap_in_use << std::endl;
+      o << "  cached free:        " << cached_free << std::endl;
+      o << "  allocators:         " << allocators << std::endl;
+      o << "  pending decrements: " << pending_decrements << std::endl;
+      o << "  live cowns:         " << live_cowns << std::endl;
+      o << "  live regions:       " << live_regions << std::endl;
+    }
+  };
+
+  /**
+   * Collect the current memory statistics.
+   *
+   * This can be called from any thread, including while the scheduler is
+   * running. It reads a handful of counters, and walks the list of allocators
+   * and of per-thread epochs, so it is cheap enough to poll periodically. The
+   * counters are read without synchronising with the threads updating them,
+   * so while the runtime is busy the figures are approximate, and are not
+   * consistent with each other.
+   **/
+  inline MemoryStats memory_stats()
+  {
+    MemoryStats stats;
+
+#ifndef USE_MALLOC
+    auto usage = default_memory_provider().memory_usage();
+    stats.heap_in_use = usage.first;
+    stats.reserved = usage.second;
+    stats.cached_free = usage.second - usage.first;
+
+    auto* pool = current_alloc_pool();
+    for (auto* a = pool->iterate(); a != nullptr; a = pool->iterate(a))
+      stats.allocators++;
+#endif
+
+    stats.pending_decrements = Epoch::pending_decrements();
+    stats.live_cowns = Cown::live_count();
+    stats.live_regions = RegionBase::live_count();
+    return stats;
+  }
+} // namespace verona::rt
@@ -0,0 +1,122 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include <test/harness.h>
+
+/**
+ * Tests `BehaviourTask` coroutines:
+ * - Coroutines that suspend on their own cown and on a cown shared between
+ *   them, and check that every step resumes in order with exclusive access.
+ * - A coroutine that holds a cown only through its arguments while it waits
+ *   on another cown, across a leak detector run. The cown is only reachable
+ *   through the suspended coroutine's frame, so it is collected unless the
+ *   message tracing the frame reports it.
+ *
+ * Each coroutine owns a reference to each of its cowns, and releases them when
+ * it completes. The harness checks that the frames and cowns are not leaked.
+ *
+ * Without coroutine support in the compiler, this only prints a message.
+ **/
+
+#ifdef VERONA_COROUTINES
+static constexpr size_t coroutine_count = 10;
+static constexpr size_t step_count = 20;
+static constexpr size_t ld_wait_steps = 40;
+
+struct Counter : public VCown<Counter>
+{
+  size_t count = 0;
+  size_t finished = 0;
+};
+
+struct Held : public VCown<Held>
+{
+  bool finalised = false;
+
+  void finaliser(Object*, ObjectStack&)
+  {
+    finalised = true;
+  }
+};
+
+BehaviourTask count(Counter* counter, Counter* shared)
+{
+  for (size_t i = 0; i < step_count; i++)
+  {
+    co_await when(counter);
+    check(counter->count == i);
+    counter->count++;
+
+    co_await when(counter, shared);
+    check(counter->count == i + 1);
+    shared->count++;
+  }
+
+  co_await when(shared);
+  shared->finished++;
+  if (shared->finished == coroutine_count)
+    check(shared->count == coroutine_count * step_count);
+
+  auto* alloc = ThreadAlloc::get();
+  Cown::release(alloc, counter);
+  Cown::release(alloc, shared);
+}
+
+void test_suspend_resume()
+{
+  Counter* shared = new Counter;
+  for (size_t i = 0; i < coroutine_count; i++)
+  {
+    // The references created here, and a new one to `shared`, are owned by
+    // the coroutine.
+    Cown::acquire(shared);
+    count(new Counter, shared);
+  }
+  Cown::release(ThreadAlloc::get(), shared);
+}
+
+BehaviourTask wait_then_use(Counter* owner, Held* held)
+{
+  co_await when(owner);
+  Scheduler::want_ld();
+
+  // Keep the coroutine suspended on `owner` while the leak detector runs.
+  for (size_t i = 0; i < ld_wait_steps; i++)
+  {
+    co_await when(owner);
+    owner->count++;
+  }
+
+  co_await when(held);
+  check(!held->finalised);
+
+  auto* alloc = ThreadAlloc::get();
+  Cown::release(alloc, owner);
+  Cown::release(alloc, held);
+}
+
+void test_trace_captured()
+{
+  wait_then_use(new Counter, new Held);
+}
+
+void test_coroutine()
+{
+  test_suspend_resume();
+  test_trace_captured();
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_coroutine);
+
+  return 0;
+}
+#else
+int main(int, char**)
+{
+  printf("Coroutines are not supported by this compiler\n");
+  return 0;
+}
+#endif
@@ -0,0 +1,144 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include <test/harness.h>
+
+#include <sstream>
+
+/**
+ * Tests the heap profiler, sampling every allocation:
+ * - Objects allocated in behaviours are attributed to the cown running the
+ *   behaviour, and cowns allocated outside a behaviour to no cown.
+ * - Nothing is sampled while the profiler is stopped.
+ * - The profile is written in the protobuf format.
+ **/
+
+static constexpr size_t worker_count = 4;
+static constexpr size_t objects_per_worker = 10;
+
+struct Worker : public VCown<Worker>
+{
+  // Make the cown large enough that every allocation is sampled.
+  char padding[256];
+};
+
+struct Node : public V<Node>
+{
+  char padding[256];
+  Node* next = nullptr;
+
+  void trace(ObjectStack& st) const
+  {
+    if (next != nullptr)
+      st.push(next);
+  }
+};
+
+static Worker* workers[worker_count];
+
+static bool is_worker(const Object* o)
+{
+  for (auto* w : workers)
+  {
+    if (w == o)
+      return true;
+  }
+  return false;
+}
+
+struct Allocate : public VBehaviour<Allocate>
+{
+  Worker* worker;
+
+  Allocate(Worker* worker) : worker(worker) {}
+
+  void f()
+  {
+    auto* alloc = ThreadAlloc::get();
+    Node* root = new (alloc) Node;
+    for (size_t i = 1; i < objects_per_worker; i++)
+    {
+      Node* n = new (root) Node;
+      n->next = root->next;
+      root->next = n;
+    }
+    Region::release(alloc, root);
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    st.push(worker);
+  }
+};
+
+struct Check : public VBehaviour<Check>
+{
+  void f()
+  {
+    HeapProfiler::stop();
+
+    size_t in_workers = 0;
+    size_t outside = 0;
+    HeapProfiler::for_each([&](const HeapProfiler::Sample& s) {
+      if (s.size == sizeof(Node))
+      {
+        check(is_worker(s.cown));
+        in_workers++;
+      }
+      else if (s.size == sizeof(Worker))
+      {
+        check(s.cown == nullptr);
+        outside++;
+      }
+    });
+    check(in_workers == worker_count * objects_per_worker);
+    check(outside == worker_count);
+
+    // Allocations are not sampled once the profiler is stopped.
+    auto* alloc = ThreadAlloc::get();
+    Region::release(alloc, new (alloc) Node);
+    size_t after = 0;
+    HeapProfiler::for_each([&](const HeapProfiler::Sample&) { after++; });
+    check(after == in_workers + outside);
+
+    // The profile starts with the `sample_type` field, which is field 1 with
+    // wire type 2.
+    std::stringstream profile;
+    HeapProfiler::write(profile);
+    check(profile.str().size() > 0);
+    check(profile.str()[0] == 0x0a);
+
+    HeapProfiler::reset();
+
+    for (auto* w : workers)
+      Cown::release(alloc, w);
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    for (auto* w : workers)
+      st.push(w);
+  }
+};
+
+void test_heap_profiler()
+{
+  HeapProfiler::reset();
+  HeapProfiler::start(1);
+
+  for (size_t i = 0; i < worker_count; i++)
+  {
+    workers[i] = new Worker;
+    Cown::schedule<Allocate>(workers[i], workers[i]);
+  }
+
+  Cown::schedule<Check>(worker_count, (Cown**)workers);
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_heap_profiler);
+
+  return 0;
+}
@@ -0,0 +1,161 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include <test/harness.h>
+
+/**
+ * Tests `memory_stats`:
+ * - The live cown and region counts follow allocation and release.
+ * - A decrement delayed on the epoch is reported as pending.
+ * - A large allocation is reported as heap in use.
+ * - Polling from behaviours running on several threads.
+ *
+ * Once the runtime has torn down, nothing should be reported as live or
+ * pending.
+ **/
+
+static constexpr size_t cown_count = 10;
+static constexpr size_t poll_count = 100;
+
+struct Cell : public VCown<Cell>
+{};
+
+struct Node : public V<Node>
+{
+  Node* next = nullptr;
+
+  void trace(ObjectStack& st) const
+  {
+    if (next != nullptr)
+      st.push(next);
+  }
+};
+
+struct Leaf : public V<Leaf, RegionType::Arena>
+{
+  void trace(ObjectStack&) const {}
+};
+
+void check_allocator(const MemoryStats& stats)
+{
+  check(stats.heap_in_use <= stats.reserved);
+  check(stats.cached_free == stats.reserved - stats.heap_in_use);
+#ifndef USE_MALLOC
+  check(stats.reserved > 0);
+  check(stats.allocators > 0);
+#endif
+}
+
+void test_live_counts()
+{
+  auto* alloc = ThreadAlloc::get();
+  auto before = memory_stats();
+
+  Cell* cells[cown_count];
+  for (size_t i = 0; i < cown_count; i++)
+    cells[i] = new Cell;
+
+  Object* trace = new (alloc) Node;
+  Object* arena = new (alloc) Leaf;
+
+  auto during = memory_stats();
+  check(during.live_cowns == before.live_cowns + cown_count);
+  check(during.live_regions == before.live_regions + 2);
+  check_allocator(during);
+
+  Region::release(alloc, trace);
+  Region::release(alloc, arena);
+  check(memory_stats().live_regions == before.live_regions);
+
+  // Freezing a region deallocates its metadata object.
+  auto* frozen = new (alloc) Node;
+  check(memory_stats().live_regions == before.live_regions + 1);
+  Freeze::apply(alloc, frozen);
+  check(memory_stats().live_regions == before.live_regions);
+
+  // The frozen object is released when the epoch has moved on, so this only
+  // checks that it is reported as pending.
+  {
+    Epoch e(alloc);
+    e.dec_in_epoch(frozen);
+  }
+  check(memory_stats().pending_decrements > 0);
+
+  // The cowns have not been seen by a scheduler thread, so the last release
+  // deallocates them.
+  for (size_t i = 0; i < cown_count; i++)
+    Cown::release(alloc, cells[i]);
+  check(memory_stats().live_cowns == before.live_cowns);
+}
+
+void test_large_allocation()
+{
+  auto* alloc = ThreadAlloc::get();
+  size_t size = 1 << 25;
+
+  auto before = memory_stats();
+  void* p = alloc->alloc(size);
+  auto during = memory_stats();
+  alloc->dealloc(p, size);
+
+  check_allocator(during);
+#ifndef USE_MALLOC
+  check(during.heap_in_use >= before.heap_in_use + size);
+#else
+  UNUSED(before);
+#endif
+}
+
+struct Poll : public VBehaviour<Poll>
+{
+  Cell* cell;
+
+  Poll(Cell* cell) : cell(cell) {}
+
+  void f()
+  {
+    auto stats = memory_stats();
+    check(stats.live_cowns > 0);
+    check_allocator(stats);
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    st.push(cell);
+  }
+};
+
+void test_poll()
+{
+  auto* alloc = ThreadAlloc::get();
+
+  Cell* cells[cown_count];
+  for (size_t i = 0; i < cown_count; i++)
+    cells[i] = new Cell;
+
+  for (size_t i = 0; i < poll_count; i++)
+    Cown::schedule<Poll>(cells[i % cown_count], cells[i % cown_count]);
+
+  for (size_t i = 0; i < cown_count; i++)
+    Cown::release(alloc, cells[i]);
+}
+
+void test_memory_stats()
+{
+  test_live_counts();
+  test_large_allocation();
+  test_poll();
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_memory_stats);
+
+  auto stats = memory_stats();
+  check(stats.live_cowns == 0);
+  check(stats.live_regions == 0);
+  check(stats.pending_decrements == 0);
+
+  return 0;
+}
@@ -0,0 +1,174 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include <test/harness.h>
+
+/**
+ * Tests promises and futures:
+ * - A chain of promises, in which the continuation of each one fulfills the
+ *   next with its value plus one.
+ * - `when_all` over promises fulfilled by behaviours on other cowns.
+ * - A promise that is never fulfilled, and only released.
+ **/
+
+static constexpr size_t chain_length = 100;
+static constexpr size_t gather_count = 50;
+
+struct Increment : public VBehaviour<Increment>
+{
+  Promise<size_t>* from;
+  Promise<size_t>* to;
+
+  Increment(Promise<size_t>* from, Promise<size_t>* to) : from(from), to(to)
+  {}
+
+  void f()
+  {
+    to->fulfill(from->future().get() + 1);
+
+    auto* alloc = ThreadAlloc::get();
+    Cown::release(alloc, from);
+    Cown::release(alloc, to);
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    st.push(from);
+    st.push(to);
+  }
+};
+
+struct CheckChain : public VBehaviour<CheckChain>
+{
+  Promise<size_t>* last;
+
+  CheckChain(Promise<size_t>* last) : last(last) {}
+
+  void f()
+  {
+    check(last->future().get() == chain_length);
+    Cown::release(ThreadAlloc::get(), last);
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    st.push(last);
+  }
+};
+
+void test_chain()
+{
+  // Each promise is owned by the behaviour that fulfills it, and by the one
+  // waiting for it, which release it when they are done.
+  Promise<size_t>* first = new Promise<size_t>;
+  Promise<size_t>* from = first;
+  for (size_t i = 0; i < chain_length; i++)
+  {
+    Promise<size_t>* to = new Promise<size_t>;
+    Cown::acquire(to);
+    from->future().then<Increment>(from, to);
+    from = to;
+  }
+  from->future().then<CheckChain>(from);
+
+  Cown::acquire(first);
+  first->fulfill(0);
+  Cown::release(ThreadAlloc::get(), first);
+}
+
+struct Worker : public VCown<Worker>
+{
+  size_t id;
+
+  Worker(size_t id) : id(id) {}
+};
+
+struct Produce : public VBehaviour<Produce>
+{
+  Worker* worker;
+  Promise<size_t>* result;
+
+  Produce(Worker* worker, Promise<size_t>* result)
+  : worker(worker), result(result)
+  {}
+
+  void f()
+  {
+    result->fulfill(worker->id);
+    Cown::release(ThreadAlloc::get(), result);
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    st.push(worker);
+    st.push(result);
+  }
+};
+
+struct Gather : public VBehaviour<Gather>
+{
+  Future<size_t>* futures;
+
+  Gather(Future<size_t>* futures) : futures(futures) {}
+
+  void f()
+  {
+    size_t sum = 0;
+    for (size_t i = 0; i < gather_count; i++)
+      sum += futures[i].get();
+    check(sum == gather_count * (gather_count - 1) / 2);
+
+    auto* alloc = ThreadAlloc::get();
+    for (size_t i = 0; i < gather_count; i++)
+      Cown::release(alloc, futures[i].cown());
+    alloc->dealloc(futures, gather_count * sizeof(Future<size_t>));
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    for (size_t i = 0; i < gather_count; i++)
+      st.push(futures[i].cown());
+  }
+};
+
+void test_when_all()
+{
+  auto* alloc = ThreadAlloc::get();
+  auto* futures =
+    (Future<size_t>*)alloc->alloc(gather_count * sizeof(Future<size_t>));
+
+  for (size_t i = 0; i < gather_count; i++)
+  {
+    Promise<size_t>* promise = new Promise<size_t>;
+    new (&futures[i]) Future<size_t>(promise->future());
+
+    // The reference to the worker is transferred to the message, and the
+    // second reference to the promise is owned by `Produce`.
+    Worker* worker = new Worker(i);
+    Cown::acquire(promise);
+    Cown::schedule<Produce, YesTransfer>(worker, worker, promise);
+  }
+
+  when_all<Gather>(gather_count, futures, futures);
+}
+
+void test_unfulfilled()
+{
+  Promise<size_t>* promise = new Promise<size_t>;
+  Cown::release(ThreadAlloc::get(), promise);
+}
+
+void test_promise()
+{
+  test_chain();
+  test_when_all();
+  test_unfulfilled();
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_promise);
+
+  return 0;
+}
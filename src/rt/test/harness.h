@@ -6,6 +6,19 @@
 #include <chrono>
 #include <test/opt.h>
 #include <verona.h>
+#ifndef _WIN32
+#  include <algorithm>
+#  include <cerrno>
+#  include <csignal>
+#  include <cstdio>
+#  include <cstring>
+#  include <deque>
+#  include <map>
+#  include <string>
+#  include <sys/wait.h>
+#  include <unistd.h>
+#  include <vector>
+#endif
 
 using namespace snmalloc;
 using namespace verona::rt;
@@ -24,15 +37,41 @@ extern "C" void dump_flight_recorder()
     abort(); \
   }
 
+/**
+ * Runs a test once for every seed in `--seed` to `--seed_upper`.
+ *
+ * By default the seeds are run one after the other in this process, and the
+ * first failure aborts the whole run. With `--processes N`, each seed is run
+ * in its own forked process instead, with up to N of them at a time. A seed
+ * that fails does not stop the others: once every seed has been run, the
+ * failing ones are listed along with the way their process ended and the last
+ * lines it printed, and the harness exits with a non-zero status. Those lines
+ * only include the systematic testing log with `--log-all`.
+ */
 class SystematicTestHarness
 {
   size_t seed = 0;
 
+#ifndef _WIN32
+  /**
+   * Number of lines of output kept for each failing seed.
+   */
+  static constexpr size_t log_tail_lines = 20;
+
+  struct SeedFailure
+  {
+    size_t seed;
+    int status;
+    std::deque<std::string> log_tail;
+  };
+#endif
+
 public:
   opt::Opt opt;
 
   bool detect_leaks;
   size_t cores;
+  size_t processes;
   size_t seed_lower;
   size_t seed_upper;
   high_resolution_clock::time_point start;
@@ -60,6 +99,17 @@ public:
     cores = opt.is<size_t>("--cores", 4);
     std::cout << " --cores " << cores << std::endl;
 
+    processes = opt.is<size_t>("--processes", 1);
+#ifdef _WIN32
+    if (processes > 1)
+    {
+      std::cout << "--processes is not supported on Windows" << std::endl;
+      processes = 1;
+    }
+#endif
+    if (processes > 1)
+      std::cout << " --processes " << processes << std::endl;
+
     detect_leaks = !opt.has("--allow_leaks");
     if (!detect_leaks)
       std::cout << " --allow_leaks " << std::endl;
@@ -83,41 +133,216 @@ public:
     // When not a CI build use the seed the user specified.
     size_t random = 0;
 #endif
-    for (seed = seed_lower + random; seed < seed_upper + random; seed++)
+#ifndef _WIN32
+    if (processes > 1 && seed_upper - seed_lower > 1)
     {
-      std::cout << "Seed: " << seed << std::endl;
+      run_processes(seed_lower + random, seed_upper + random, f, args...);
+      return;
+    }
+#endif
+    for (seed = seed_lower + random; seed < seed_upper + random; seed++)
+      run_seed(f, std::forward<Args>(args)...);
+  }
+
+  size_t current_seed()
+  {
+    assert(seed != 0);
+    return seed;
+  }
 
-      Scheduler& sched = Scheduler::get();
+private:
+  template<typename... Args>
+  void run_seed(void f(Args...), Args... args)
+  {
+    std::cout << "Seed: " << seed << std::endl;
+
+    Scheduler& sched = Scheduler::get();
 #ifdef USE_SYSTEMATIC_TESTING
-      Systematic::set_seed(seed);
-      if (seed % 2 == 1)
+    Systematic::set_seed(seed);
+    if (seed % 2 == 1)
+    {
+      sched.set_fair(true);
+    }
+    else
+    {
+      sched.set_fair(false);
+    }
+#else
+    UNUSED(seed);
+#endif
+    sched.init(cores);
+
+    f(std::forward<Args>(args)...);
+
+    sched.run();
+    if (detect_leaks)
+      snmalloc::current_alloc_pool()->debug_check_empty();
+    high_resolution_clock::time_point t1 = high_resolution_clock::now();
+    std::cout << "Time so far: "
+              << duration_cast<seconds>((t1 - start)).count() << " seconds"
+              << std::endl;
+  }
+
+#ifndef _WIN32
+  /**
+   * Run each seed in `[lower, upper)` in a forked process, with at most
+   * `processes` of them at a time, and report the seeds that failed.
+   *
+   * The output of each process goes to a temporary file, which is only read
+   * back if the seed fails. A seed passes if its process exits with status 0.
+   */
+  template<typename... Args>
+  void run_processes(size_t lower, size_t upper, void f(Args...), Args... args)
+  {
+    struct Worker
+    {
+      size_t seed;
+      FILE* log;
+    };
+
+    std::map<pid_t, Worker> workers;
+    std::vector<SeedFailure> failures;
+    size_t next = lower;
+
+    std::cout << "Running seeds " << lower << " to " << upper - 1 << " in "
+              << processes << " processes" << std::endl;
+
+    while (next < upper || !workers.empty())
+    {
+      if (next < upper && workers.size() < processes)
       {
-        sched.set_fair(true);
+        FILE* log = tmpfile();
+        if (log == nullptr)
+        {
+          perror("tmpfile");
+          abort();
+        }
+
+        // Anything still buffered would otherwise be printed by the child too.
+        std::cout.flush();
+        fflush(stdout);
+
+        pid_t pid = fork();
+        if (pid == -1)
+        {
+          perror("fork");
+          abort();
+        }
+
+        if (pid == 0)
+        {
+          dup2(fileno(log), STDOUT_FILENO);
+          dup2(fileno(log), STDERR_FILENO);
+          seed = next;
+          run_seed(f, std::forward<Args>(args)...);
+          std::cout.flush();
+          fflush(stdout);
+          _exit(0);
+        }
+
+        workers[pid] = {next, log};
+        next++;
+        continue;
       }
-      else
+
+      int status;
+      pid_t pid = wait(&status);
+      if (pid == -1)
       {
-        sched.set_fair(false);
+        if (errno == EINTR)
+          continue;
+        perror("wait");
+        abort();
       }
-#else
-      UNUSED(seed);
-#endif
-      sched.init(cores);
 
-      f(std::forward<Args>(args)...);
+      auto it = workers.find(pid);
+      if (it == workers.end())
+        continue;
 
-      sched.run();
-      if (detect_leaks)
-        snmalloc::current_alloc_pool()->debug_check_empty();
-      high_resolution_clock::time_point t1 = high_resolution_clock::now();
-      std::cout << "Time so far: "
-                << duration_cast<seconds>((t1 - start)).count() << " seconds"
-                << std::endl;
+      Worker worker = it->second;
+      workers.erase(it);
+
+      if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+      {
+        failures.push_back({worker.seed, status, read_tail(worker.log)});
+        std::cout << "Seed " << worker.seed << " failed: "
+                  << describe_status(status) << std::endl;
+      }
+      fclose(worker.log);
+    }
+
+    high_resolution_clock::time_point t1 = high_resolution_clock::now();
+    std::cout << upper - lower - failures.size() << " of " << upper - lower
+              << " seeds passed in "
+              << duration_cast<seconds>((t1 - start)).count() << " seconds"
+              << std::endl;
+
+    if (failures.empty())
+      return;
+
+    std::sort(
+      failures.begin(),
+      failures.end(),
+      [](const SeedFailure& a, const SeedFailure& b) {
+        return a.seed < b.seed;
+      });
+
+    for (auto& failure : failures)
+    {
+      std::cout << std::endl
+                << "Seed " << failure.seed << " "
+                << describe_status(failure.status) << ", last "
+                << failure.log_tail.size() << " lines of output:" << std::endl;
+      for (auto& line : failure.log_tail)
+        std::cout << "  " << line << std::endl;
     }
+
+    std::cout << std::endl << "Failing seeds:";
+    for (auto& failure : failures)
+      std::cout << " " << failure.seed;
+    std::cout << std::endl
+              << "Replay one with --seed <seed>, which also enables logging."
+              << std::endl;
+    exit(1);
   }
 
-  size_t current_seed()
+  static std::deque<std::string> read_tail(FILE* log)
   {
-    assert(seed != 0);
-    return seed;
+    std::deque<std::string> tail;
+    std::string line;
+    rewind(log);
+    for (int c = fgetc(log); c != EOF; c = fgetc(log))
+    {
+      if (c != '\n')
+      {
+        line.push_back((char)c);
+        continue;
+      }
+
+      tail.push_back(std::move(line));
+      line.clear();
+      if (tail.size() > log_tail_lines)
+        tail.pop_front();
+    }
+
+    if (!line.empty())
+    {
+      tail.push_back(std::move(line));
+      if (tail.size() > log_tail_lines)
+        tail.pop_front();
+    }
+    return tail;
   }
+
+  static std::string describe_status(int status)
+  {
+    if (WIFSIGNALED(status))
+    {
+      int signal = WTERMSIG(status);
+      return "killed by signal " + std::to_string(signal) + " (" +
+        strsignal(signal) + ")";
+    }
+    return "exited with status " + std::to_string(WEXITSTATUS(status));
+  }
+#endif
 };
@@ -0,0 +1,254 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Compares scheduling one behaviour on each of `--cowns` cowns with a loop of
+ * `Cown::schedule` calls against a single `Cown::schedule_each`, and summing
+ * a value from each cown with a hand-built counting cown against
+ * `scatter_gather`.
+ *
+ * The scheduling is done from inside a behaviour, as it would be in a
+ * program, so that the cowns scheduled by the loop are queued on a single
+ * scheduler thread. The time reported is from the start of that behaviour to
+ * the end of the run, averaged over `--repeats` runs.
+ */
+
+#include "test/opt.h"
+#include "verona.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+using namespace snmalloc;
+using namespace verona::rt;
+using timer = std::chrono::high_resolution_clock;
+
+struct Cell : public VCown<Cell>
+{
+  uint64_t value = 0;
+};
+
+struct Total : public VCown<Total>
+{
+  uint64_t sum = 0;
+};
+
+struct Driver : public VCown<Driver>
+{};
+
+enum class Variant
+{
+  Loop,
+  ScheduleEach,
+  LoopWithCount,
+  ScatterGather,
+};
+
+static std::vector<Cell*> cells;
+static Total* total;
+static Promise<uint64_t>* gathered;
+static timer::time_point start;
+
+struct AddOne : public VBehaviour<AddOne>
+{
+  Cell* cell;
+
+  AddOne(Cell* cell) : cell(cell) {}
+
+  void f()
+  {
+    cell->value++;
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    st.push(cell);
+  }
+};
+
+struct AddOneAt : public VBehaviour<AddOneAt>
+{
+  Cell* cell;
+
+  AddOneAt(size_t index, Cell** cells) : cell(cells[index]) {}
+
+  void f()
+  {
+    cell->value++;
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    st.push(cell);
+  }
+};
+
+struct Count : public VBehaviour<Count>
+{
+  uint64_t value;
+
+  Count(uint64_t value) : value(value) {}
+
+  void f()
+  {
+    total->sum += value;
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    st.push(total);
+  }
+};
+
+struct AddOneAndCount : public VBehaviour<AddOneAndCount>
+{
+  Cell* cell;
+
+  AddOneAndCount(Cell* cell) : cell(cell) {}
+
+  void f()
+  {
+    Cown::schedule<Count>(total, ++cell->value);
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    st.push(cell);
+    st.push(total);
+  }
+};
+
+struct Start : public VBehaviour<Start>
+{
+  Variant variant;
+
+  Start(Variant variant) : variant(variant) {}
+
+  void f()
+  {
+    start = timer::now();
+    switch (variant)
+    {
+      case Variant::Loop:
+        for (auto* cell : cells)
+          Cown::schedule<AddOne>(cell, cell);
+        break;
+
+      case Variant::ScheduleEach:
+        Cown::schedule_each<AddOneAt>(
+          cells.size(), (Cown**)cells.data(), cells.data());
+        break;
+
+      case Variant::LoopWithCount:
+        for (auto* cell : cells)
+          Cown::schedule<AddOneAndCount>(cell, cell);
+        break;
+
+      case Variant::ScatterGather:
+        Cown::acquire(gathered);
+        scatter_gather(
+          cells.size(),
+          cells.data(),
+          [](Cell* cell) { return ++cell->value; },
+          [](uint64_t a, uint64_t b) { return a + b; },
+          (uint64_t)0,
+          gathered);
+        break;
+    }
+  }
+};
+
+static void expect(bool condition, const char* what)
+{
+  if (!condition)
+  {
+    std::cout << "Unexpected result: " << what << std::endl;
+    abort();
+  }
+}
+
+static const char* variant_name(Variant variant)
+{
+  switch (variant)
+  {
+    case Variant::Loop:
+      return "schedule loop";
+    case Variant::ScheduleEach:
+      return "schedule_each";
+    case Variant::LoopWithCount:
+      return "loop + count cown";
+    case Variant::ScatterGather:
+      return "scatter_gather";
+  }
+  abort();
+}
+
+static double run(Variant variant, size_t cores, size_t count, size_t repeats)
+{
+  auto* alloc = ThreadAlloc::get();
+  timer::duration elapsed{};
+
+  for (size_t r = 0; r < repeats; r++)
+  {
+    for (size_t i = 0; i < count; i++)
+      cells.push_back(new (alloc) Cell);
+    total = new (alloc) Total;
+    gathered = new (alloc) Promise<uint64_t>;
+
+    Scheduler& sched = Scheduler::get();
+    sched.init(cores);
+
+    auto* driver = new (alloc) Driver;
+    Cown::schedule<Start, YesTransfer>(driver, variant);
+    sched.run();
+    elapsed += timer::now() - start;
+
+    if (variant == Variant::LoopWithCount)
+      expect(total->sum == count, "counted sum");
+    if (variant == Variant::ScatterGather)
+      expect(gathered->future().get() == count, "gathered sum");
+
+    for (auto* cell : cells)
+    {
+      expect(cell->value == 1, "cell value");
+      Cown::release(alloc, cell);
+    }
+    cells.clear();
+    Cown::release(alloc, total);
+    Cown::release(alloc, gathered);
+  }
+
+  return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+           .count() /
+    (double)(repeats * count);
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+  const auto cores = opt.is<size_t>("--cores", 4);
+  const auto count = opt.is<size_t>("--cowns", 1'000'000);
+  const auto repeats = opt.is<size_t>("--repeats", 1);
+  assert(count > 0);
+  assert(repeats > 0);
+
+  std::cout << std::left << std::setw(20) << "variant" << std::right
+            << std::setw(14) << "ns per cown" << std::endl;
+
+  for (auto variant :
+       {Variant::Loop,
+        Variant::ScheduleEach,
+        Variant::LoopWithCount,
+        Variant::ScatterGather})
+  {
+    double ns = run(variant, cores, count, repeats);
+    std::cout << std::left << std::setw(20) << variant_name(variant)
+              << std::right << std::fixed << std::setprecision(1)
+              << std::setw(14) << ns << std::endl;
+  }
+
+  snmalloc::current_alloc_pool()->debug_check_empty();
+  return 0;
+}
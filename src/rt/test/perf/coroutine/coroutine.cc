@@ -0,0 +1,182 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Compares chains of behaviours written as `VBehaviour` subclasses that each
+ * schedule the next step, with the same chains written as `BehaviourTask`
+ * coroutines that `co_await when(...)` in a loop.
+ *
+ * There are `--chains` chains, each of `--steps` behaviours on its own cown.
+ * In the `pair` variants every step also acquires the cown of the next chain,
+ * so steps contend with the neighbouring chain. Each variant is run
+ * `--repeats` times, and the mean time per step is reported, along with the
+ * time of the coroutine relative to the handwritten behaviours.
+ *
+ * Without coroutine support in the compiler, this only prints a message.
+ */
+
+#include "test/opt.h"
+#include "verona.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+using namespace snmalloc;
+using namespace verona::rt;
+using timer = std::chrono::high_resolution_clock;
+
+#ifdef VERONA_COROUTINES
+struct Counter : public VCown<Counter>
+{
+  size_t count = 0;
+};
+
+struct Step : public VBehaviour<Step>
+{
+  Counter* counter;
+  Counter* other;
+  size_t remaining;
+
+  Step(Counter* counter, Counter* other, size_t remaining)
+  : counter(counter), other(other), remaining(remaining)
+  {}
+
+  void f()
+  {
+    counter->count++;
+    if (remaining == 1)
+      return;
+
+    if (other == nullptr)
+    {
+      Cown::schedule<Step>(counter, counter, nullptr, remaining - 1);
+    }
+    else
+    {
+      Cown* cowns[2] = {counter, other};
+      Cown::schedule<Step>(2, cowns, counter, other, remaining - 1);
+    }
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    st.push(counter);
+    if (other != nullptr)
+      st.push(other);
+  }
+};
+
+static void start_behaviours(Counter* counter, Counter* other, size_t steps)
+{
+  if (other == nullptr)
+  {
+    Cown::schedule<Step>(counter, counter, nullptr, steps);
+  }
+  else
+  {
+    Cown* cowns[2] = {counter, other};
+    Cown::schedule<Step>(2, cowns, counter, other, steps);
+  }
+}
+
+static BehaviourTask
+start_coroutine(Counter* counter, Counter* other, size_t steps)
+{
+  for (size_t i = 0; i < steps; i++)
+  {
+    if (other == nullptr)
+      co_await when(counter);
+    else
+      co_await when(counter, other);
+    counter->count++;
+  }
+}
+
+template<typename Start>
+static double run(
+  Start start,
+  bool pair,
+  size_t cores,
+  size_t chains,
+  size_t steps,
+  size_t repeats)
+{
+  auto* alloc = ThreadAlloc::get();
+  timer::duration total{};
+
+  for (size_t r = 0; r < repeats; r++)
+  {
+    std::vector<Counter*> counters;
+    for (size_t i = 0; i < chains; i++)
+      counters.push_back(new (alloc) Counter);
+
+    Scheduler& sched = Scheduler::get();
+    sched.init(cores);
+
+    auto begin = timer::now();
+    for (size_t i = 0; i < chains; i++)
+    {
+      Counter* other = pair ? counters[(i + 1) % chains] : nullptr;
+      start(counters[i], other, steps);
+    }
+    sched.run();
+    total += timer::now() - begin;
+
+    for (auto* counter : counters)
+    {
+      if (counter->count != steps)
+      {
+        std::cout << "Chain ran " << counter->count << " steps, expected "
+                  << steps << std::endl;
+        abort();
+      }
+      Cown::release(alloc, counter);
+    }
+  }
+
+  return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(total)
+           .count() /
+    (double)(repeats * chains * steps);
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+  const auto cores = opt.is<size_t>("--cores", 4);
+  const auto chains = opt.is<size_t>("--chains", 100);
+  const auto steps = opt.is<size_t>("--steps", 1000);
+  const auto repeats = opt.is<size_t>("--repeats", 3);
+  assert(chains > 1);
+  assert(steps > 0);
+  assert(repeats > 0);
+
+  std::cout << std::left << std::setw(8) << "cowns" << std::right
+            << std::setw(16) << "behaviour ns" << std::setw(16)
+            << "coroutine ns" << std::setw(10) << "ratio" << std::endl;
+
+  for (bool pair : {false, true})
+  {
+    double behaviour =
+      run(start_behaviours, pair, cores, chains, steps, repeats);
+    double coroutine =
+      run(start_coroutine, pair, cores, chains, steps, repeats);
+
+    std::cout << std::left << std::setw(8) << (pair ? "pair" : "single")
+              << std::right << std::fixed << std::setprecision(1)
+              << std::setw(16) << behaviour << std::setw(16) << coroutine
+              << std::setw(10) << std::setprecision(2)
+              << coroutine / behaviour << std::endl;
+  }
+
+  snmalloc::current_alloc_pool()->debug_check_empty();
+  return 0;
+}
+#else
+int main(int, char**)
+{
+  std::cout << "Coroutines are not supported by this compiler" << std::endl;
+  return 0;
+}
+#endif
@@ -0,0 +1,295 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Microbenchmarks for region operations: allocating objects in trace and arena
+ * regions, garbage collecting trace regions, releasing regions, freezing
+ * regions into immutable graphs and releasing those.
+ *
+ * Each operation is run on graphs of the following shapes:
+ * - `list`: a singly linked list.
+ * - `tree`: a balanced binary tree.
+ * - `cycles`: a ring, with an extra edge from every object to a random one, so
+ *   that the whole graph is a single dense strongly connected component.
+ * - `fanout`: a tree in which every object has 64 children.
+ *
+ * Sizes go from `--min_size` to `--max_size` objects, growing tenfold. Each
+ * result is the mean of `--repeats` runs, reported as the time per object and
+ * the throughput in objects per second, along with the peak resident set size
+ * of the process so far. `--csv` prints the results as CSV.
+ *
+ * `gc live` collects a region in which every object is reachable, and
+ * `gc dead` one in which only the entry point is. Freezing is only measured
+ * for trace regions, since arena regions cannot be frozen.
+ */
+
+#include "test/opt.h"
+#include "test/xoroshiro.h"
+#include "verona.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#ifndef _WIN32
+#  include <sys/resource.h>
+#endif
+
+using namespace snmalloc;
+using namespace verona::rt;
+using timer = std::chrono::high_resolution_clock;
+
+template<RegionType region_type, size_t N>
+struct Node : public V<Node<region_type, N>, region_type>
+{
+  std::array<Object*, N> fields{};
+
+  void trace(ObjectStack& st) const
+  {
+    for (auto* f : fields)
+    {
+      if (f != nullptr)
+        st.push(f);
+    }
+  }
+};
+
+enum class Shape
+{
+  List,
+  Tree,
+  Cycles,
+  Fanout,
+};
+
+static const char* shape_name(Shape shape)
+{
+  switch (shape)
+  {
+    case Shape::List:
+      return "list";
+    case Shape::Tree:
+      return "tree";
+    case Shape::Cycles:
+      return "cycles";
+    case Shape::Fanout:
+      return "fanout";
+  }
+  abort();
+}
+
+static bool csv = false;
+
+/**
+ * Peak resident set size of the process, in kilobytes, or 0 if it isn't
+ * known on this platform.
+ */
+static size_t peak_rss_kb()
+{
+#ifdef _WIN32
+  return 0;
+#else
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#  ifdef __APPLE__
+  return (size_t)usage.ru_maxrss / 1024;
+#  else
+  return (size_t)usage.ru_maxrss;
+#  endif
+#endif
+}
+
+static void print_header()
+{
+  if (csv)
+  {
+    std::cout << "operation,region,shape,size,ns_per_object,objects_per_s,"
+                 "peak_rss_kb"
+              << std::endl;
+    return;
+  }
+
+  std::cout << std::left << std::setw(18) << "operation" << std::setw(7)
+            << "region" << std::setw(8) << "shape" << std::right
+            << std::setw(10) << "size" << std::setw(12) << "ns/object"
+            << std::setw(14) << "objects/s" << std::setw(14) << "peak RSS KiB"
+            << std::endl;
+}
+
+static void report(
+  const char* operation,
+  const char* region,
+  Shape shape,
+  size_t size,
+  size_t repeats,
+  timer::duration total)
+{
+  double ns =
+    (double)std::chrono::duration_cast<std::chrono::nanoseconds>(total)
+      .count() /
+    (double)(size * repeats);
+  double rate = ns == 0 ? 0 : 1e9 / ns;
+
+  if (csv)
+  {
+    std::cout << operation << "," << region << "," << shape_name(shape) << ","
+              << size << "," << ns << "," << (uint64_t)rate << ","
+              << peak_rss_kb() << std::endl;
+    return;
+  }
+
+  std::cout << std::left << std::setw(18) << operation << std::setw(7)
+            << region << std::setw(8) << shape_name(shape) << std::right
+            << std::setw(10) << size << std::setw(12) << std::fixed
+            << std::setprecision(2) << ns << std::setw(14) << (uint64_t)rate
+            << std::setw(14) << peak_rss_kb() << std::endl;
+}
+
+/**
+ * Allocate a region of `size` objects in the given shape, and return its
+ * entry point. Every object is reachable from the entry point.
+ */
+template<RegionType region_type, size_t N>
+Object*
+build(Alloc* alloc, Shape shape, size_t size, xoroshiro::p128r32& rng)
+{
+  using T = Node<region_type, N>;
+
+  std::vector<T*> nodes;
+  nodes.reserve(size);
+  T* root = new (alloc) T;
+  nodes.push_back(root);
+  for (size_t i = 1; i < size; i++)
+    nodes.push_back(new (alloc, root) T);
+
+  switch (shape)
+  {
+    case Shape::List:
+      for (size_t i = 1; i < size; i++)
+        nodes[i - 1]->fields[0] = nodes[i];
+      break;
+
+    case Shape::Tree:
+    case Shape::Fanout:
+      // Trees are built with as many children per object as it has fields.
+      for (size_t i = 1; i < size; i++)
+        nodes[(i - 1) / N]->fields[(i - 1) % N] = nodes[i];
+      break;
+
+    case Shape::Cycles:
+      for (size_t i = 0; i < size; i++)
+      {
+        nodes[i]->fields[0] = nodes[(i + 1) % size];
+        nodes[i]->fields[1] = nodes[rng.next() % size];
+      }
+      break;
+  }
+
+  return root;
+}
+
+template<RegionType region_type, size_t N>
+void bench(Shape shape, size_t size, size_t repeats, xoroshiro::p128r32& rng)
+{
+  auto* alloc = ThreadAlloc::get();
+  const char* region = region_type == RegionType::Trace ? "trace" : "arena";
+
+  timer::duration alloc_time{};
+  timer::duration gc_live_time{};
+  timer::duration release_time{};
+  for (size_t r = 0; r < repeats; r++)
+  {
+    auto start = timer::now();
+    Object* root = build<region_type, N>(alloc, shape, size, rng);
+    alloc_time += timer::now() - start;
+
+    if constexpr (region_type == RegionType::Trace)
+    {
+      start = timer::now();
+      RegionTrace::gc(alloc, root);
+      gc_live_time += timer::now() - start;
+    }
+
+    start = timer::now();
+    Region::release(alloc, root);
+    release_time += timer::now() - start;
+  }
+
+  report("alloc", region, shape, size, repeats, alloc_time);
+  report("release", region, shape, size, repeats, release_time);
+
+  if constexpr (region_type == RegionType::Trace)
+  {
+    report("gc live", region, shape, size, repeats, gc_live_time);
+
+    timer::duration gc_dead_time{};
+    timer::duration freeze_time{};
+    timer::duration immutable_release_time{};
+    for (size_t r = 0; r < repeats; r++)
+    {
+      Object* root = build<region_type, N>(alloc, shape, size, rng);
+      // Make everything but the entry point unreachable.
+      static_cast<Node<region_type, N>*>(root)->fields.fill(nullptr);
+      auto start = timer::now();
+      RegionTrace::gc(alloc, root);
+      gc_dead_time += timer::now() - start;
+      Region::release(alloc, root);
+
+      root = build<region_type, N>(alloc, shape, size, rng);
+      start = timer::now();
+      Freeze::apply(alloc, root);
+      freeze_time += timer::now() - start;
+
+      start = timer::now();
+      Immutable::release(alloc, root);
+      immutable_release_time += timer::now() - start;
+    }
+
+    report("gc dead", region, shape, size, repeats, gc_dead_time);
+    report("freeze", region, shape, size, repeats, freeze_time);
+    report(
+      "immutable release",
+      region,
+      shape,
+      size,
+      repeats,
+      immutable_release_time);
+  }
+}
+
+template<size_t N>
+void bench_regions(
+  Shape shape, size_t size, size_t repeats, xoroshiro::p128r32& rng)
+{
+  bench<RegionType::Trace, N>(shape, size, repeats, rng);
+  bench<RegionType::Arena, N>(shape, size, repeats, rng);
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+  const auto seed = opt.is<size_t>("--seed", 5489);
+  const auto min_size = opt.is<size_t>("--min_size", 1'000);
+  const auto max_size = opt.is<size_t>("--max_size", 100'000);
+  const auto repeats = opt.is<size_t>("--repeats", 3);
+  csv = opt.has("--csv");
+  assert(min_size > 0);
+  assert(repeats > 0);
+
+  xoroshiro::p128r32 rng(seed);
+
+  print_header();
+  for (auto shape : {Shape::List, Shape::Tree, Shape::Cycles, Shape::Fanout})
+  {
+    for (size_t size = min_size; size <= max_size; size *= 10)
+    {
+      if (shape == Shape::Fanout)
+        bench_regions<64>(shape, size, repeats, rng);
+      else
+        bench_regions<2>(shape, size, repeats, rng);
+    }
+  }
+
+  snmalloc::current_alloc_pool()->debug_check_empty();
+  return 0;
+}
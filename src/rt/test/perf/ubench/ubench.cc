@@ -14,6 +14,20 @@
  * may randomly choose to include itself in the forwarded `Ping` multi-message
  * along with the selected recipient. By default 5% of `Ping` messages will
  * become these multi-messages.
+ *
+ * Each run of `--report_count` intervals is a trial, and `--trials` runs are
+ * made for every configuration. With `--sweep`, the configurations are every
+ * power of two number of cores up to `--cores`, combined with every power of
+ * two number of pingers from `--min_pingers` to `--pingers`. The mean and
+ * standard deviation of the message rate are reported for each trial, over
+ * its intervals, and for each configuration, over its trials.
+ *
+ * With `--latency`, every `Ping` records the time from being sent to being
+ * run, and the 50th, 99th and 99.9th percentiles are reported. This adds two
+ * clock reads to every message, so it lowers the message rate.
+ *
+ * Results are printed as text by default, or as CSV with `--csv` or JSON with
+ * `--json`, which print one record per trial and configuration.
  */
 
 #include "test/log.h"
@@ -22,6 +36,7 @@
 #include "verona.h"
 
 #include <chrono>
+#include <cmath>
 
 namespace sn = snmalloc;
 namespace rt = verona::rt;
@@ -29,6 +44,149 @@ namespace rt = verona::rt;
 static rt::Cown** all_cowns = nullptr;
 static size_t all_cowns_count = 0;
 
+static bool record_latency = false;
+
+enum class Format
+{
+  Text,
+  CSV,
+  JSON,
+};
+
+static Format format = Format::Text;
+
+static uint64_t now_ns()
+{
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+/**
+ * A histogram of latencies in nanoseconds. Each power of two range is split
+ * into `sub_buckets` buckets, so a value is known to within 1/`sub_buckets`
+ * of itself, however large it is.
+ */
+class LatencyHistogram
+{
+  static constexpr size_t sub_bucket_bits = 4;
+  static constexpr size_t sub_buckets = (size_t)1 << sub_bucket_bits;
+  static constexpr size_t buckets = (64 - sub_bucket_bits + 1) * sub_buckets;
+
+  std::array<uint64_t, buckets> counts{};
+  uint64_t total = 0;
+
+  static size_t index(uint64_t value)
+  {
+    if (value < sub_buckets)
+      return (size_t)value;
+
+    size_t top_bit = 63 - (size_t)__builtin_clzll(value);
+    size_t shift = top_bit - sub_bucket_bits;
+    return ((shift + 1) << sub_bucket_bits) +
+      (size_t)((value >> shift) & (sub_buckets - 1));
+  }
+
+  /**
+   * The smallest value in bucket `i`.
+   */
+  static uint64_t lower_bound(size_t i)
+  {
+    size_t group = i >> sub_bucket_bits;
+    uint64_t sub = i & (sub_buckets - 1);
+    if (group == 0)
+      return sub;
+    return (sub_buckets + sub) << (group - 1);
+  }
+
+public:
+  void add(uint64_t value)
+  {
+    counts[index(value)]++;
+    total++;
+  }
+
+  void merge(const LatencyHistogram& other)
+  {
+    for (size_t i = 0; i < buckets; i++)
+      counts[i] += other.counts[i];
+    total += other.total;
+  }
+
+  void clear()
+  {
+    counts.fill(0);
+    total = 0;
+  }
+
+  uint64_t count() const
+  {
+    return total;
+  }
+
+  /**
+   * The largest value in the bucket holding the value that `fraction` of all
+   * values are less than or equal to.
+   */
+  uint64_t percentile(double fraction) const
+  {
+    if (total == 0)
+      return 0;
+
+    uint64_t target = (uint64_t)std::ceil(fraction * (double)total);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets; i++)
+    {
+      seen += counts[i];
+      if (seen >= target)
+        return (i + 1 < buckets) ? lower_bound(i + 1) - 1 : UINT64_MAX;
+    }
+    return UINT64_MAX;
+  }
+};
+
+/**
+ * Mean and standard deviation of a set of samples.
+ */
+struct Summary
+{
+  double mean = 0;
+  double stddev = 0;
+
+  Summary(const std::vector<double>& samples)
+  {
+    if (samples.empty())
+      return;
+
+    for (auto sample : samples)
+      mean += sample;
+    mean /= (double)samples.size();
+
+    if (samples.size() < 2)
+      return;
+
+    double sum_squares = 0;
+    for (auto sample : samples)
+      sum_squares += (sample - mean) * (sample - mean);
+    stddev = std::sqrt(sum_squares / (double)(samples.size() - 1));
+  }
+};
+
+struct Trial
+{
+  /**
+   * The message rate of each interval, in messages per second.
+   */
+  std::vector<double> rates;
+  LatencyHistogram latency;
+};
+
+/**
+ * The trial that is running. Only `Report` writes to it while the scheduler
+ * runs, and it has acquired every cown when it does.
+ */
+static Trial* current_trial = nullptr;
+
 struct Pinger : public rt::VCown<Pinger>
 {
   vector<Pinger*>& pingers;
@@ -36,6 +194,7 @@ struct Pinger : public rt::VCown<Pinger>
   size_t select_mod = 0;
   bool running = false;
   size_t count = 0;
+  LatencyHistogram latency;
 
   Pinger(vector<Pinger*>& pingers_, size_t seed, size_t percent_multimessage)
   : pingers(pingers_), rng(seed)
@@ -76,8 +235,13 @@ struct Ping : public rt::VBehaviour<Ping>
 {
   Pinger* pinger;
   std::array<Pinger*, 2> recipients;
+  uint64_t sent = 0;
 
-  Ping(Pinger* pinger_) : pinger(pinger_) {}
+  Ping(Pinger* pinger_) : pinger(pinger_)
+  {
+    if (record_latency)
+      sent = now_ns();
+  }
 
   void f()
   {
@@ -85,6 +249,8 @@ struct Ping : public rt::VBehaviour<Ping>
       return;
 
     pinger->count++;
+    if (record_latency)
+      pinger->latency.add(now_ns() - sent);
 
     size_t cowns = 1;
     recipients[1] = pinger;
@@ -134,6 +300,7 @@ struct Start : public rt::VBehaviour<Start>
     for (auto* p : monitor->pingers)
     {
       p->count = 0;
+      p->latency.clear();
       p->running = true;
       for (size_t i = 0; i < monitor->initial_pings; i++)
         rt::Cown::schedule<Ping>(p, p);
@@ -213,10 +380,147 @@ struct Report : public rt::VBehaviour<Report>
       sum += p->count;
 
     uint64_t rate = (sum * 1'000'000'000) / t;
-    logger::cout() << t << " ns, " << rate << " msgs/s" << std::endl;
+    current_trial->rates.push_back((double)rate);
+
+    LatencyHistogram latency;
+    for (auto* p : monitor->pingers)
+      latency.merge(p->latency);
+    current_trial->latency.merge(latency);
+
+    if (format != Format::Text)
+      return;
+
+    if (record_latency)
+    {
+      logger::cout() << t << " ns, " << rate << " msgs/s, latency p50 "
+                     << latency.percentile(0.5) << " ns, p99 "
+                     << latency.percentile(0.99) << " ns, p99.9 "
+                     << latency.percentile(0.999) << " ns" << std::endl;
+    }
+    else
+    {
+      logger::cout() << t << " ns, " << rate << " msgs/s" << std::endl;
+    }
   }
 };
 
+struct Config
+{
+  size_t seed;
+  size_t cores;
+  size_t pingers;
+  std::chrono::seconds report_interval;
+  size_t report_count;
+  size_t initial_pings;
+  size_t percent_multimessage;
+};
+
+static Trial run_trial(const Config& config)
+{
+  Trial trial;
+  current_trial = &trial;
+
+  auto* alloc = sn::ThreadAlloc::get();
+  auto& sched = rt::Scheduler::get();
+  sched.set_fair(true);
+  sched.init(config.cores);
+
+  vector<Pinger*> pinger_set;
+  for (size_t p = 0; p < config.pingers; p++)
+    pinger_set.push_back(new (alloc) Pinger(
+      pinger_set, config.seed + p, config.percent_multimessage));
+
+  auto* monitor = new (alloc) Monitor(
+    pinger_set,
+    config.initial_pings,
+    config.report_interval,
+    config.report_count);
+
+  all_cowns_count = config.pingers + 1;
+  all_cowns = (rt::Cown**)alloc->alloc(all_cowns_count * sizeof(rt::Cown*));
+  memcpy(all_cowns, pinger_set.data(), pinger_set.size() * sizeof(rt::Cown*));
+  all_cowns[pinger_set.size()] = monitor;
+
+  rt::Cown::schedule<Start>(all_cowns_count, all_cowns, monitor);
+
+  sched.run();
+  alloc->dealloc(all_cowns, all_cowns_count * sizeof(rt::Cown*));
+  current_trial = nullptr;
+  return trial;
+}
+
+/**
+ * Powers of two from `from` up to `to`, and `to` itself if it isn't one.
+ */
+static std::vector<size_t> doubling(size_t from, size_t to)
+{
+  std::vector<size_t> result;
+  for (size_t n = std::max<size_t>(from, 1); n < to; n *= 2)
+    result.push_back(n);
+  result.push_back(to);
+  return result;
+}
+
+static const char* csv_header =
+  "cores,pingers,initial_pings,percent_multimessage,trial,msgs_per_s,"
+  "msgs_per_s_stddev,latency_samples,p50_ns,p99_ns,p99_9_ns";
+
+/**
+ * Print the result of a trial, or of all trials of a configuration if
+ * `trial` is empty. `rates` are the samples that the rate is summarised
+ * over: the intervals of a trial, or the trials of a configuration.
+ */
+static void print_record(
+  const Config& config,
+  const std::string& trial,
+  const std::vector<double>& rates,
+  const LatencyHistogram& latency,
+  bool last)
+{
+  Summary rate(rates);
+  std::stringstream ss;
+  switch (format)
+  {
+    case Format::Text:
+      ss << (trial.empty() ? "summary" : "trial " + trial) << ": "
+         << (uint64_t)rate.mean << " msgs/s, stddev "
+         << (uint64_t)rate.stddev << " msgs/s";
+      if (latency.count() != 0)
+      {
+        ss << ", latency p50 " << latency.percentile(0.5) << " ns, p99 "
+           << latency.percentile(0.99) << " ns, p99.9 "
+           << latency.percentile(0.999) << " ns";
+      }
+      break;
+
+    case Format::CSV:
+      ss << config.cores << "," << config.pingers << ","
+         << config.initial_pings << "," << config.percent_multimessage << ","
+         << (trial.empty() ? "all" : trial) << "," << rate.mean << ","
+         << rate.stddev << "," << latency.count() << ","
+         << latency.percentile(0.5) << "," << latency.percentile(0.99) << ","
+         << latency.percentile(0.999);
+      break;
+
+    case Format::JSON:
+      ss << "  {\"cores\": " << config.cores
+         << ", \"pingers\": " << config.pingers
+         << ", \"initial_pings\": " << config.initial_pings
+         << ", \"percent_multimessage\": " << config.percent_multimessage
+         << ", \"trial\": "
+         << (trial.empty() ? "\"all\"" : trial)
+         << ", \"msgs_per_s\": " << rate.mean
+         << ", \"msgs_per_s_stddev\": " << rate.stddev
+         << ", \"latency_ns\": {\"samples\": " << latency.count()
+         << ", \"p50\": " << latency.percentile(0.5)
+         << ", \"p99\": " << latency.percentile(0.99)
+         << ", \"p99.9\": " << latency.percentile(0.999) << "}}"
+         << (last ? "" : ",");
+      break;
+  }
+  logger::cout() << ss.str() << std::endl;
+}
+
 int main(int argc, char** argv)
 {
   opt::Opt opt(argc, argv);
@@ -228,41 +532,73 @@ int main(int argc, char** argv)
   const auto report_count = opt.is<size_t>("--report_count", 10);
   const auto initial_pings = opt.is<size_t>("--initial_pings", 5);
   const auto percent_multimessage = opt.is<size_t>("--percent_multimessage", 5);
+  const auto trials = opt.is<size_t>("--trials", 1);
+  const auto sweep = opt.has("--sweep");
+  const auto min_pingers = opt.is<size_t>("--min_pingers", 1);
   assert(percent_multimessage <= 100);
+  assert(trials > 0);
 
-  logger::cout() << "cores: " << cores << ", pingers: " << pingers
-                 << ", report_interval: " << report_interval.count()
-                 << ", initial_pings: " << initial_pings
-                 << ", percent_mutlimessage: " << percent_multimessage
-                 << std::endl;
+  record_latency = opt.has("--latency");
+  if (opt.has("--csv"))
+    format = Format::CSV;
+  else if (opt.has("--json"))
+    format = Format::JSON;
 
-  auto* alloc = sn::ThreadAlloc::get();
 #ifdef USE_SYSTEMATIC_TESTING
   Systematic::enable_logging();
   Systematic::set_seed(seed);
-#else
-  UNUSED(seed);
 #endif
-  auto& sched = rt::Scheduler::get();
-  sched.set_fair(true);
-  sched.init(cores);
 
-  static vector<Pinger*> pinger_set;
-  for (size_t p = 0; p < pingers; p++)
-    pinger_set.push_back(new (alloc)
-                           Pinger(pinger_set, seed + p, percent_multimessage));
+  std::vector<Config> configs;
+  for (auto c : sweep ? doubling(1, cores) : std::vector<size_t>{cores})
+  {
+    for (auto p :
+         sweep ? doubling(min_pingers, pingers) : std::vector<size_t>{pingers})
+    {
+      configs.push_back({seed,
+                         c,
+                         p,
+                         report_interval,
+                         report_count,
+                         initial_pings,
+                         percent_multimessage});
+    }
+  }
 
-  auto* monitor = new (alloc)
-    Monitor(pinger_set, initial_pings, report_interval, report_count);
+  if (format == Format::CSV)
+    logger::cout() << csv_header << std::endl;
+  else if (format == Format::JSON)
+    logger::cout() << "[" << std::endl;
 
-  all_cowns_count = pingers + 1;
-  all_cowns = (rt::Cown**)alloc->alloc(all_cowns_count * sizeof(rt::Cown*));
-  memcpy(all_cowns, pinger_set.data(), pinger_set.size() * sizeof(rt::Cown*));
-  all_cowns[pinger_set.size()] = monitor;
+  for (size_t i = 0; i < configs.size(); i++)
+  {
+    const auto& config = configs[i];
+    if (format == Format::Text)
+    {
+      logger::cout() << "cores: " << config.cores
+                     << ", pingers: " << config.pingers
+                     << ", report_interval: " << report_interval.count()
+                     << ", initial_pings: " << initial_pings
+                     << ", percent_mutlimessage: " << percent_multimessage
+                     << std::endl;
+    }
 
-  rt::Cown::schedule<Start>(all_cowns_count, all_cowns, monitor);
+    std::vector<double> trial_rates;
+    LatencyHistogram latency;
+    for (size_t t = 0; t < trials; t++)
+    {
+      Trial trial = run_trial(config);
+      trial_rates.push_back(Summary(trial.rates).mean);
+      latency.merge(trial.latency);
+      if ((format != Format::Text) || (trials > 1))
+        print_record(
+          config, std::to_string(t), trial.rates, trial.latency, false);
+    }
+    print_record(config, "", trial_rates, latency, i + 1 == configs.size());
+  }
+
+  if (format == Format::JSON)
+    logger::cout() << "]" << std::endl;
 
-  sched.run();
-  alloc->dealloc(all_cowns, all_cowns_count * sizeof(rt::Cown*));
   return 0;
 }
@@ -7,8 +7,12 @@
 #  define SNMALLOC_USE_THREAD_DESTRUCTOR 1
 #endif
 
+#include "cpp/coroutine.h"
+#include "cpp/gather.h"
+#include "cpp/promise.h"
 #include "cpp/vbehaviour.h"
 #include "cpp/vobject.h"
+#include "object/heapprofiler.h"
 #include "object/object.h"
 #include "region/externalreference.h"
 #include "region/freeze.h"
@@ -16,6 +20,7 @@
 #include "region/region.h"
 #include "sched/cown.h"
 #include "sched/epoch.h"
+#include "sched/memorystats.h"
 #include "sched/multimessage.h"
 #include "sched/noticeboard.h"
 #include "sched/schedulerthread.h"
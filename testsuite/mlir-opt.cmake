@@ -0,0 +1,10 @@
+include(${CMAKE_CURRENT_LIST_DIR}/common.cmake)
+
+PrepareTest(VERONAM_FLAGS EXPECTED_DUMP ACTUAL_DUMP)
+
+CheckStatus(
+  COMMAND ${MLIRGEN} -O1 ${TEST_FILE} -o -
+  EXPECTED_STATUS 0
+  OUTPUT_FILE ${CMAKE_CURRENT_BINARY_DIR}/${TEST_NAME}.mlir)
+
+FileCheck(${TEST_FILE} ${CMAKE_CURRENT_BINARY_DIR}/${TEST_NAME}.mlir)
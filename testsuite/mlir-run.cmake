@@ -0,0 +1,10 @@
+include(${CMAKE_CURRENT_LIST_DIR}/common.cmake)
+
+PrepareTest(VERONAM_FLAGS EXPECTED_DUMP ACTUAL_DUMP)
+
+CheckStatus(
+  COMMAND ${MLIRGEN} --run ${TEST_FILE}
+  EXPECTED_STATUS 0
+  OUTPUT_FILE ${CMAKE_CURRENT_BINARY_DIR}/${TEST_NAME}.out)
+
+FileCheck(${TEST_FILE} ${CMAKE_CURRENT_BINARY_DIR}/${TEST_NAME}.out)
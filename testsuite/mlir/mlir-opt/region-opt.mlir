@@ -0,0 +1,127 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+// Checks that the Verona optimisations reuse the values of fields that cannot
+// have changed, and remove allocations that are only dropped.
+
+module {
+  verona.class @C {
+    verona.field "f" : !verona.imm
+    verona.field "g" : !verona.iso
+  }
+
+  func @unknown()
+
+  // Reads through a view of the same reference are redundant.
+  // CHECK-L: func @read_twice
+  // CHECK-L: %1 = verona.field_read %arg0["f"] : !verona.mut -> !verona.mut
+  // CHECK-NOT-L: verona.field_read
+  // CHECK-L: return %1, %1 : !verona.mut, !verona.mut
+  func @read_twice(%o: !verona.mut) -> (!verona.mut, !verona.mut) {
+    %v = verona.view %o : !verona.mut -> !verona.mut
+    %a = verona.field_read %o["f"] : !verona.mut -> !verona.mut
+    %b = verona.field_read %v["f"] : !verona.mut -> !verona.mut
+    return %a, %b : !verona.mut, !verona.mut
+  }
+
+  // Two mutable references may refer to the same object.
+  // CHECK-L: func @write_may_alias
+  // CHECK-L: %0 = verona.field_read %arg0["f"] : !verona.mut -> !verona.mut
+  // CHECK-L: %2 = verona.field_read %arg0["f"] : !verona.mut -> !verona.mut
+  // CHECK-L: return %0, %2 : !verona.mut, !verona.mut
+  func @write_may_alias(%a: !verona.mut, %b: !verona.mut, %x: !verona.mut) -> (!verona.mut, !verona.mut) {
+    %0 = verona.field_read %a["f"] : !verona.mut -> !verona.mut
+    %1 = verona.field_write %b["f"], %x : !verona.mut -> !verona.mut -> !verona.mut
+    %2 = verona.field_read %a["f"] : !verona.mut -> !verona.mut
+    return %0, %2 : !verona.mut, !verona.mut
+  }
+
+  // Objects in different regions never alias.
+  // CHECK-L: func @write_other_region
+  // CHECK-L: %0 = verona.field_read %arg0["f"] : !verona.iso -> !verona.mut
+  // CHECK-NOT-L: verona.field_read
+  // CHECK-L: return %0, %0 : !verona.mut, !verona.mut
+  func @write_other_region(%a: !verona.iso, %b: !verona.iso, %x: !verona.mut) -> (!verona.mut, !verona.mut) {
+    %0 = verona.field_read %a["f"] : !verona.iso -> !verona.mut
+    %1 = verona.field_write %b["f"], %x : !verona.iso -> !verona.mut -> !verona.mut
+    %2 = verona.field_read %a["f"] : !verona.iso -> !verona.mut
+    return %0, %2 : !verona.mut, !verona.mut
+  }
+
+  // An `iso` field refers to a region of its own, not the region of the object
+  // holding it. Here the field holds the region written through `%r`, so the
+  // second read of `f` must be kept.
+  // CHECK-L: func @iso_field
+  // CHECK-L: %2 = verona.field_read %arg0["g"] : !verona.iso -> !verona.mut
+  // CHECK-L: %3 = verona.field_read %2["f"] : !verona.mut -> !verona.mut
+  // CHECK-L: %4 = verona.field_write %0["f"], %arg1 : !verona.iso -> !verona.mut -> !verona.mut
+  // CHECK-L: %5 = verona.field_read %2["f"] : !verona.mut -> !verona.mut
+  // CHECK-L: return %3, %5 : !verona.mut, !verona.mut
+  func @iso_field(%a: !verona.iso, %x: !verona.mut) -> (!verona.mut, !verona.mut) {
+    %r = verona.new_region @C [ ] : !verona.iso
+    %0 = verona.field_write %a["g"], %r : !verona.iso -> !verona.iso -> !verona.iso
+    call @unknown() : () -> ()
+    %1 = verona.field_read %a["g"] : !verona.iso -> !verona.mut
+    %2 = verona.field_read %1["f"] : !verona.mut -> !verona.mut
+    %3 = verona.field_write %r["f"], %x : !verona.iso -> !verona.mut -> !verona.mut
+    %4 = verona.field_read %1["f"] : !verona.mut -> !verona.mut
+    return %2, %4 : !verona.mut, !verona.mut
+  }
+
+  // Reading a field that was just written gives back the written value, viewed
+  // with the type of the read.
+  // CHECK-L: func @read_after_write
+  // CHECK-L: %1 = verona.view %arg1 : !verona.iso -> !verona.mut
+  // CHECK-NOT-L: verona.field_read
+  // CHECK-L: return %1 : !verona.mut
+  func @read_after_write(%a: !verona.mut, %x: !verona.iso) -> !verona.mut {
+    %0 = verona.field_write %a["f"], %x : !verona.mut -> !verona.iso -> !verona.mut
+    %1 = verona.field_read %a["f"] : !verona.mut -> !verona.mut
+    return %1 : !verona.mut
+  }
+
+  // Fields read through an immutable reference never change, but other fields
+  // may change during a call.
+  // CHECK-L: func @immutable
+  // CHECK-L: %0 = verona.field_read %arg0["f"] : !verona.imm -> !verona.imm
+  // CHECK-L: %1 = verona.field_read %arg1["f"] : !verona.mut -> !verona.mut
+  // CHECK-L: call @unknown() : () -> ()
+  // CHECK-L: %2 = verona.field_read %arg1["f"] : !verona.mut -> !verona.mut
+  // CHECK-L: return %0, %1, %2 : !verona.imm, !verona.mut, !verona.mut
+  func @immutable(%i: !verona.imm, %m: !verona.mut) -> (!verona.imm, !verona.mut, !verona.mut) {
+    %0 = verona.field_read %i["f"] : !verona.imm -> !verona.imm
+    %1 = verona.field_read %m["f"] : !verona.mut -> !verona.mut
+    call @unknown() : () -> ()
+    %2 = verona.field_read %i["f"] : !verona.imm -> !verona.imm
+    %3 = verona.field_read %m["f"] : !verona.mut -> !verona.mut
+    return %2, %1, %3 : !verona.imm, !verona.mut, !verona.mut
+  }
+
+  // Allocations that are only dropped are removed, including the region
+  // that the object was allocated in.
+  // CHECK-L: func @dead_allocations
+  // CHECK-NOT-L: verona.new_
+  // CHECK-NOT-L: verona.drop
+  // CHECK-L: return
+  func @dead_allocations(%x: !verona.imm) {
+    %r = verona.new_region @C [ "f" ] (%x : !verona.imm) : !verona.iso
+    %o = verona.new_object @C [ "f" ] (%x : !verona.imm) in (%r : !verona.iso) : !verona.mut
+    %v = verona.view %o : !verona.mut -> !verona.mut
+    verona.drop %v : !verona.mut
+    verona.drop %r : !verona.iso
+    return
+  }
+
+  // Dropping an object that owns a region releases that region too, so the
+  // allocations are kept.
+  // CHECK-L: func @owning_allocation
+  // CHECK-L: %0 = verona.new_region @C [] : !verona.iso
+  // CHECK-L: %1 = verona.new_region @C ["f"](%0 : !verona.iso) : !verona.iso
+  // CHECK-L: verona.drop %1 : !verona.iso
+  func @owning_allocation() {
+    %inner = verona.new_region @C [ ] : !verona.iso
+    %outer = verona.new_region @C [ "f" ] (%inner : !verona.iso) : !verona.iso
+    verona.drop %outer : !verona.iso
+    return
+  }
+}
@@ -0,0 +1,24 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+// This test checks subtyping judgements that are repeated, within a function
+// and across functions. After the first time, these are answered by the
+// typechecker's subtyping cache, which must give the same answers. Some of the
+// judgements need sub-judgements that fail before one succeeds.
+
+module {
+  func @first(%a: !verona.meet<U64, join<iso, mut>>) {
+    %b = verona.copy %a : !verona.meet<U64, join<iso, mut>> -> !verona.join<meet<U64, iso>, meet<U64, mut>>
+    %c = verona.copy %a : !verona.meet<U64, join<iso, mut>> -> !verona.join<meet<U64, iso>, meet<U64, mut>>
+    %d = verona.copy %b : !verona.join<meet<U64, iso>, meet<U64, mut>> -> !verona.join<S64, U32, U64>
+    %e = verona.copy %c : !verona.join<meet<U64, iso>, meet<U64, mut>> -> !verona.join<S64, U32, U64>
+    return
+  }
+
+  func @second(%a: !verona.meet<U64, join<iso, mut>>) {
+    %b = verona.copy %a : !verona.meet<U64, join<iso, mut>> -> !verona.join<meet<U64, iso>, meet<U64, mut>>
+    %c = verona.copy %b : !verona.join<meet<U64, iso>, meet<U64, mut>> -> !verona.join<S64, U32, U64>
+    %d = verona.copy %c : !verona.join<S64, U32, U64> -> !verona.join<U64, S64, U32>
+    return
+  }
+}
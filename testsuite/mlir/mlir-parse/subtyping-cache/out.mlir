@@ -0,0 +1,17 @@
+
+
+module {
+  func @first(%arg0: !verona.meet<U64, join<iso, mut>>) {
+    %0 = verona.copy %arg0 : !verona.meet<U64, join<iso, mut>> -> !verona.join<meet<U64, iso>, meet<U64, mut>>
+    %1 = verona.copy %arg0 : !verona.meet<U64, join<iso, mut>> -> !verona.join<meet<U64, iso>, meet<U64, mut>>
+    %2 = verona.copy %0 : !verona.join<meet<U64, iso>, meet<U64, mut>> -> !verona.join<S64, U32, U64>
+    %3 = verona.copy %1 : !verona.join<meet<U64, iso>, meet<U64, mut>> -> !verona.join<S64, U32, U64>
+    return
+  }
+  func @second(%arg0: !verona.meet<U64, join<iso, mut>>) {
+    %0 = verona.copy %arg0 : !verona.meet<U64, join<iso, mut>> -> !verona.join<meet<U64, iso>, meet<U64, mut>>
+    %1 = verona.copy %0 : !verona.join<meet<U64, iso>, meet<U64, mut>> -> !verona.join<S64, U32, U64>
+    %2 = verona.copy %1 : !verona.join<S64, U32, U64> -> !verona.join<U64, S64, U32>
+    return
+  }
+}
\ No newline at end of file
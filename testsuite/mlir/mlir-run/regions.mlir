@@ -0,0 +1,84 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+// Allocates, links, collects and releases a region on every iteration of a
+// loop, and exits the loop through each of `loop_exit`, `break` and
+// `loop_return`.
+
+// CHECK-L: 1500
+
+module {
+  verona.class @Node {
+    verona.field "next" : !verona.mut
+  }
+
+  verona.class @Holder {
+    verona.field "owned" : !verona.iso
+    verona.field "next" : !verona.mut
+  }
+
+  // Returns `n`, using `loop_return` to leave the loop.
+  func @count(%n: i64) -> i64 {
+    %zero = constant 0 : i64
+    %one = constant 1 : i64
+    %counter = alloca() : memref<i64>
+    store %zero, %counter[] : memref<i64>
+    verona.while {
+      %i = load %counter[] : memref<i64>
+      %done = cmpi "eq", %i, %n : i64
+      cond_br %done, ^bb1, ^bb2
+
+    ^bb1:
+      verona.loop_return %i : i64
+
+    ^bb2:
+      %next = addi %i, %one : i64
+      store %next, %counter[] : memref<i64>
+      verona.continue
+    }
+    return %zero : i64
+  }
+
+  func @main() -> i64 {
+    %zero = constant 0 : i64
+    %one = constant 1 : i64
+    %limit = constant 1000 : i64
+    %stop = constant 500 : i64
+    %counter = alloca() : memref<i64>
+    store %zero, %counter[] : memref<i64>
+
+    verona.while {
+      %i = load %counter[] : memref<i64>
+      %cond = cmpi "slt", %i, %limit : i64
+      verona.loop_exit %cond : i1
+
+      %r = verona.new_region @Node [ ] : !verona.iso
+      %a = verona.new_object @Node [ ] in (%r : !verona.iso) : !verona.mut
+      %b = verona.new_object @Node [ "next" ] (%a : !verona.mut) in (%a : !verona.mut) : !verona.mut
+      %old = verona.field_write %r["next"], %b : !verona.iso -> !verona.mut -> !verona.mut
+      %c = verona.field_read %r["next"] : !verona.iso -> !verona.mut
+      verona.tidy %r : !verona.iso
+
+      // The region is now owned by an object in another region, and is
+      // released along with it.
+      %h = verona.new_region @Holder [ "owned" ] (%r : !verona.iso) : !verona.iso
+      verona.drop %h : !verona.iso
+
+      %next = addi %i, %one : i64
+      store %next, %counter[] : memref<i64>
+      %done = cmpi "eq", %next, %stop : i64
+      cond_br %done, ^bb1, ^bb2
+
+    ^bb1:
+      verona.break
+
+    ^bb2:
+      verona.continue
+    }
+
+    %loops = load %counter[] : memref<i64>
+    %extra = call @count(%limit) : (i64) -> i64
+    %result = addi %loops, %extra : i64
+    return %result : i64
+  }
+}